@@ -0,0 +1,359 @@
+/* STM32F1 SMPS Adaptive Acquisition
+
+The ADC normally scans at the slow timer 2 base rate, which suffices for the
+regulator and telemetry but cannot resolve a transient. While armed, each
+base rate scan is checked for a transient, and on finding one the ADC is
+switched to back to back scans at its full rate for a set window, recorded
+into a capture buffer by DMA, and then returned to the base rate.
+
+A transient is either of:
+
+- A change of the selected input between two base rate scans of at least
+  the derivative threshold.
+- The regulated output current differing from the setpoint by at least the
+  deviation threshold, as on a setpoint step or a load dump.
+
+The last base rate scans before the trigger are kept in a ring and placed
+ahead of the window, so the capture holds two segments at different rates.
+When the capture is sent each segment is preceded by its scan interval, so
+that the host can place every scan in time. Scans are sent in calibrated
+units a few lines at a time, leaving room in the transmit buffer for the
+telemetry and acknowledgements.
+
+Checking is called from the ADC ISR and the end of the burst is marked from
+the DMA ISR. Everything else runs in the main loop.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/cm3/cortex.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "acquisition.h"
+#include "calibration.h"
+#include "commslib.h"
+#include "ramfunc.h"
+#include "buck-pmos-data-capture.h"
+
+/*--------------------------------------------------------------------------*/
+/* Capture buffer, base rate scans ahead of the full rate window */
+
+static uint16_t buffer[ACQUISITION_SCANS][NUM_CHANNEL];
+static uint16_t baseScans;
+static uint16_t burstScans;
+
+/* Ring of the latest base rate scans */
+static uint16_t history[ACQUISITION_PRETRIGGER][NUM_CHANNEL];
+static uint8_t historyNext;
+static uint8_t historyCount;
+
+/* Trigger settings */
+static uint8_t input;
+static int32_t derivativeThreshold;
+static int32_t deviationThreshold;
+static uint16_t window;
+static bool rearm;
+
+static volatile uint8_t state;
+static int32_t previous;
+static bool previousValid;
+static uint8_t cause;
+static int32_t excursion;
+static bool reported;
+
+/* Position in sending, the scan and the line of it */
+static uint16_t sendScan;
+static uint8_t sendLine;
+
+static void acquisitionWatch(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise with triggering off
+
+The derivative is watched on the output current.
+*/
+
+void acquisitionInit(void)
+{
+    state = ACQUISITION_OFF;
+    rearm = false;
+    input = OUTPUT_CURRENT;
+    derivativeThreshold = 0;
+    deviationThreshold = 0;
+    window = ACQUISITION_WINDOW;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Trigger settings
+
+A zero threshold disables that trigger.
+
+@param[in] uint8_t channel: index into the data array of the input watched.
+@param[in] int32_t threshold: in mV or mA, or mV or mA per base rate scan.
+@param[in] uint16_t scans: full rate scans in the window.
+*/
+
+void acquisitionSetInput(uint8_t channel)
+{
+    if (channel < NUM_CHANNEL) input = channel;
+    previousValid = false;
+}
+
+void acquisitionSetDerivative(int32_t threshold)
+{
+    derivativeThreshold = threshold;
+}
+
+void acquisitionSetDeviation(int32_t threshold)
+{
+    deviationThreshold = threshold;
+}
+
+void acquisitionSetWindow(uint16_t scans)
+{
+    if ((scans > 0) && (scans <= ACQUISITION_WINDOW_MAX)) window = scans;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Arm or disarm triggering
+
+While armed triggering resumes after each capture is sent. Arming discards
+a capture not yet sent. Disarming leaves a capture in progress to finish.
+
+@param[in] bool arm: true to arm.
+*/
+
+void acquisitionArm(bool arm)
+{
+    rearm = arm;
+    cm_disable_interrupts();
+    if (! arm && (state == ACQUISITION_ARMED)) state = ACQUISITION_OFF;
+    else if (arm && ((state == ACQUISITION_OFF) ||
+                     (state == ACQUISITION_HELD)))
+        acquisitionWatch();
+    cm_enable_interrupts();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check a base rate scan for a transient
+
+Called from the ADC ISR with each calibrated scan. The raw scan is kept in
+the ring. On a trigger the ring is moved to the start of the capture buffer,
+and the caller is to start the burst into the rest of it.
+
+@param[in] uint32_t raw[]: ADC counts.
+@param[in] int32_t value[]: calibrated scan.
+@param[in] int32_t setpoint: of the regulated output current, zero if none.
+@returns bool: true to start a burst.
+*/
+
+RAMFUNC
+bool acquisitionScan(volatile uint32_t raw[], volatile int32_t value[],
+                     int32_t setpoint)
+{
+    if (state != ACQUISITION_ARMED) return false;
+    uint8_t i;
+    for (i = 0; i < NUM_CHANNEL; i++) history[historyNext][i] = raw[i];
+    historyNext = (historyNext + 1) % ACQUISITION_PRETRIGGER;
+    if (historyCount < ACQUISITION_PRETRIGGER) historyCount++;
+
+    uint8_t found = 0;
+    int32_t change = value[input] - previous;
+    if (previousValid && (derivativeThreshold > 0) &&
+        ((change >= derivativeThreshold) || (-change >= derivativeThreshold)))
+    {
+        found = ACQUISITION_DERIVATIVE;
+        excursion = change;
+    }
+    int32_t error = value[OUTPUT_CURRENT] - setpoint;
+    if (! found && (deviationThreshold > 0) && (setpoint > 0) &&
+        ((error >= deviationThreshold) || (-error >= deviationThreshold)))
+    {
+        found = ACQUISITION_DEVIATION;
+        excursion = error;
+    }
+    previous = value[input];
+    previousValid = true;
+    if (! found) return false;
+
+/* Oldest scan first, ending with the one that triggered */
+    uint8_t index = (historyNext + ACQUISITION_PRETRIGGER - historyCount) %
+                    ACQUISITION_PRETRIGGER;
+    uint16_t scan;
+    for (scan = 0; scan < historyCount; scan++)
+    {
+        for (i = 0; i < NUM_CHANNEL; i++) buffer[scan][i] = history[index][i];
+        index = (index + 1) % ACQUISITION_PRETRIGGER;
+    }
+    baseScans = historyCount;
+    burstScans = window;
+    cause = found;
+    state = ACQUISITION_BURST;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Where the burst is to be recorded
+
+@returns uint16_t*: the scans following the base rate scans, each channel in
+         turn as in the ADC sequence.
+*/
+
+RAMFUNC
+uint16_t* acquisitionBurstBuffer(void)
+{
+    return &buffer[baseScans][0];
+}
+
+RAMFUNC
+uint16_t acquisitionBurstScans(void)
+{
+    return burstScans;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Mark the end of the burst
+
+Called from the DMA ISR when the window is complete. The ADC is still to be
+returned to base rate scans, after which acquisitionRestored is called.
+*/
+
+void acquisitionBurstEnd(void)
+{
+    state = ACQUISITION_DRAIN;
+}
+
+void acquisitionRestored(void)
+{
+    if (state != ACQUISITION_DRAIN) return;
+    state = ACQUISITION_HELD;
+    reported = false;
+}
+
+/*--------------------------------------------------------------------------*/
+
+uint8_t acquisitionState(void)
+{
+    return state;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Report a new capture once
+
+@param[out] uint8_t* triggerCause: ACQUISITION_DERIVATIVE or
+            ACQUISITION_DEVIATION.
+@param[out] int32_t* size: change or deviation that triggered.
+@returns bool: true the first time a capture is seen held.
+*/
+
+bool acquisitionReport(uint8_t* triggerCause, int32_t* size)
+{
+    if ((state != ACQUISITION_HELD) || reported) return false;
+    reported = true;
+    *triggerCause = cause;
+    *size = excursion;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start sending the capture
+
+@returns bool: false if no capture is held.
+*/
+
+bool acquisitionSend(void)
+{
+    if (state != ACQUISITION_HELD) return false;
+    sendScan = 0;
+    sendLine = 0;
+    state = ACQUISITION_SENDING;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send the next lines of the capture
+
+Called on each pass of the main loop. Each segment begins with
+"ri, <interval ns>, <scans>" and each scan is sent as
+"ra, <output voltage>, <output current>" and
+"rb, <input voltage>, <input current>". The capture ends with
+"re, <scans>, <cause>".
+*/
+
+void acquisitionSendStep(void)
+{
+    if (state != ACQUISITION_SENDING) return;
+    uint16_t total = baseScans + burstScans;
+    while (commsTransmitSpace() > ACQUISITION_HEADROOM)
+    {
+        if (sendScan >= total)
+        {
+            if (! dataMessageSend("re", total, cause)) return;
+            state = ACQUISITION_OFF;
+            if (rearm) acquisitionArm(true);
+            return;
+        }
+/* Segment header ahead of the first scan of each segment */
+        if (sendLine == 0)
+        {
+            if (sendScan == 0)
+            {
+                if (! dataMessageSend("ri", ACQUISITION_BASE_INTERVAL,
+                                      baseScans)) return;
+            }
+            else if (sendScan == baseScans)
+            {
+                if (! dataMessageSend("ri", ACQUISITION_FULL_INTERVAL,
+                                      burstScans)) return;
+            }
+            sendLine = 1;
+            continue;
+        }
+        uint8_t channel = (sendLine == 1) ? OUTPUT_VOLTAGE : INPUT_VOLTAGE;
+        if (! dataMessageSend((sendLine == 1) ? "ra" : "rb",
+                              calibrate(channel, buffer[sendScan][channel]),
+                              calibrate(channel + 1,
+                                        buffer[sendScan][channel + 1])))
+            return;
+        if (sendLine == 1) sendLine = 2;
+        else
+        {
+            sendLine = 0;
+            sendScan++;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the ring and watch for a trigger
+
+*/
+
+static void acquisitionWatch(void)
+{
+    historyNext = 0;
+    historyCount = 0;
+    previousValid = false;
+    state = ACQUISITION_ARMED;
+}
+
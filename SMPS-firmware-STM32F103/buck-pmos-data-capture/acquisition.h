@@ -0,0 +1,79 @@
+/* STM32F1 SMPS Adaptive Acquisition
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACQUISITION_H_
+#define ACQUISITION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buck-pmos-data-capture.h"
+
+/* Capture buffer in scans, and the base rate scans kept ahead of a trigger */
+#define ACQUISITION_SCANS       256
+#define ACQUISITION_PRETRIGGER  32
+#define ACQUISITION_WINDOW_MAX  (ACQUISITION_SCANS - ACQUISITION_PRETRIGGER)
+#define ACQUISITION_WINDOW      128
+
+/* Scan intervals in ns. The base rate is the timer 2 period of 65536
+counts, and the full rate back to back scans of 164 ADC clocks at 9 MHz. */
+#define ACQUISITION_BASE_INTERVAL 910222
+#define ACQUISITION_FULL_INTERVAL 18222
+
+/* Transmit buffer space kept free for telemetry and acknowledgements while
+a capture is sent */
+#define ACQUISITION_HEADROOM    128
+
+/* States */
+#define ACQUISITION_OFF         0
+#define ACQUISITION_ARMED       1   /* Watching base rate scans */
+#define ACQUISITION_BURST       2   /* ADC scanning at full rate */
+#define ACQUISITION_DRAIN       3   /* Burst ended, ADC to be set up again */
+#define ACQUISITION_HELD        4   /* Capture waiting to be sent */
+#define ACQUISITION_SENDING     5
+
+/* Trigger causes */
+#define ACQUISITION_DERIVATIVE  1   /* Change of the input over a scan */
+#define ACQUISITION_DEVIATION   2   /* Regulated value from the setpoint */
+
+void acquisitionInit(void);
+void acquisitionSetInput(uint8_t channel);
+void acquisitionSetDerivative(int32_t threshold);
+void acquisitionSetDeviation(int32_t threshold);
+void acquisitionSetWindow(uint16_t scans);
+void acquisitionArm(bool arm);
+bool acquisitionScan(volatile uint32_t raw[], volatile int32_t value[],
+                     int32_t setpoint);
+uint16_t* acquisitionBurstBuffer(void);
+uint16_t acquisitionBurstScans(void);
+void acquisitionBurstEnd(void);
+uint8_t acquisitionState(void);
+void acquisitionRestored(void);
+bool acquisitionReport(uint8_t* cause, int32_t* excursion);
+bool acquisitionSend(void);
+void acquisitionSendStep(void);
+
+#endif
+
@@ -0,0 +1,216 @@
+/* STM32F1 SMPS Relay Feedback Auto-Tune
+
+The Astrom-Hagglund relay method identifies the plant at an operating point.
+The regulator is replaced by a relay that switches the buck duty cycle
+between the starting value plus and minus an amplitude d, according to the
+sign of the error. The loop then settles into a limit cycle at the ultimate
+period Tu of the plant, with an amplitude a of the regulated value. By the
+describing function of the relay the ultimate gain is Ku = 4d/(pi*a).
+
+The plant gain is taken as the ratio of the average regulated value to the
+average duty cycle over the measured cycles.
+
+PI gains follow the Ziegler-Nichols rules, Kp = 0.45*Ku and Ti = Tu/1.2.
+On a first order plant with the one period measurement delay of the
+regulator this settles a step in a third or less of the time of the default
+integrator, with some overshoot. The more damped Tyreus-Luyben rules were
+slower than the default integrator.
+
+The tune is stepped once per regulator period and does not access the
+hardware; the caller applies the duty cycle returned.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "autotune.h"
+#include "fixmath.h"
+
+/* 4/pi in Q16 */
+#define FOUR_OVER_PI        83443
+
+/*--------------------------------------------------------------------------*/
+/* Tune state */
+
+static bool running;
+static int16_t bias;                /* Duty cycle about which the relay acts */
+static int16_t amplitude;
+static bool relayHigh;
+static int32_t periodCount;         /* Regulator periods since the start */
+static int32_t lastRise;            /* Period of the last relay switch up */
+static uint8_t cycles;              /* Complete cycles, including settling */
+static int32_t valueMaximum;        /* Extremes in the current cycle */
+static int32_t valueMinimum;
+static int32_t periodSum;           /* Sums over the measured cycles */
+static int32_t amplitudeSum;
+static int64_t valueSum;
+static int64_t dutySum;
+static AutotuneResult tuned;
+static bool resultAvailable;
+
+static void computeResult(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start an auto-tune
+
+The regulated value should be near the setpoint at the given duty cycle.
+
+@param[in] int16_t dutyCycle: operating point in promille.
+*/
+
+void autotuneStart(int16_t dutyCycle)
+{
+    bias = clamp(dutyCycle, AUTOTUNE_AMPLITUDE, 1000 - AUTOTUNE_AMPLITUDE);
+    amplitude = AUTOTUNE_AMPLITUDE;
+    relayHigh = true;
+    periodCount = 0;
+    lastRise = 0;
+    cycles = 0;
+    valueMaximum = INT32_MIN;
+    valueMinimum = INT32_MAX;
+    periodSum = 0;
+    amplitudeSum = 0;
+    valueSum = 0;
+    dutySum = 0;
+    resultAvailable = false;
+    running = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Abandon an auto-tune
+
+The caller should restore the regulator.
+*/
+
+void autotuneStop(void)
+{
+    running = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check if an auto-tune is in progress
+
+*/
+
+bool autotuneRunning(void)
+{
+    return running;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Step the relay
+
+Called once per regulator period in place of the regulator. When the tune
+ends, successfully or not, the starting duty cycle is returned.
+
+@param[in] int32_t setValue: setpoint of the regulated value.
+@param[in] int32_t isValue: measured regulated value.
+@returns int16_t: duty cycle to apply in promille.
+*/
+
+int16_t autotuneUpdate(int32_t setValue, int32_t isValue)
+{
+    if (! running) return bias;
+    periodCount++;
+    if (periodCount > AUTOTUNE_TIMEOUT)
+    {
+        running = false;
+        return bias;
+    }
+    if (isValue > valueMaximum) valueMaximum = isValue;
+    if (isValue < valueMinimum) valueMinimum = isValue;
+
+    if (relayHigh && (isValue > setValue + AUTOTUNE_HYSTERESIS))
+        relayHigh = false;
+    else if (! relayHigh && (isValue < setValue - AUTOTUNE_HYSTERESIS))
+    {
+        relayHigh = true;
+/* A cycle is complete at each switch up after the first */
+        if (lastRise > 0)
+        {
+            cycles++;
+            if (cycles > AUTOTUNE_SETTLE)
+            {
+                periodSum += periodCount - lastRise;
+                amplitudeSum += (valueMaximum - valueMinimum)/2;
+            }
+            if (cycles >= AUTOTUNE_SETTLE + AUTOTUNE_CYCLES)
+            {
+                computeResult();
+                running = false;
+                return bias;
+            }
+        }
+        lastRise = periodCount;
+        valueMaximum = isValue;
+        valueMinimum = isValue;
+    }
+
+    int16_t dutyCycle = relayHigh ? bias + amplitude : bias - amplitude;
+    if (cycles >= AUTOTUNE_SETTLE)
+    {
+        valueSum += isValue;
+        dutySum += dutyCycle;
+    }
+    return dutyCycle;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Result of the last completed tune
+
+@param[out] AutotuneResult* result: identified plant and PI gains.
+@returns true if a new result is available. This is cleared on reading.
+*/
+
+bool autotuneResult(AutotuneResult* result)
+{
+    if (! resultAvailable) return false;
+    *result = tuned;
+    resultAvailable = false;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Compute the plant parameters and PI gains
+
+*/
+
+static void computeResult(void)
+{
+    int32_t oscillation = amplitudeSum/AUTOTUNE_CYCLES;
+    if (oscillation < 1) oscillation = 1;
+    tuned.period = (periodSum << 8)/AUTOTUNE_CYCLES;
+    tuned.ultimateGain = saturate32(((int64_t)amplitude*FOUR_OVER_PI)/
+                                    oscillation);
+    tuned.plantGain = 0;
+    if (dutySum > 0)
+        tuned.plantGain = saturate32((valueSum*65536)/dutySum);
+/* Kp = 0.45*Ku, Ki = Kp/Ti with Ti = Tu/1.2 */
+    tuned.proportionalGain = ((int64_t)tuned.ultimateGain*45)/100;
+    tuned.integralGain = saturate32(((int64_t)tuned.ultimateGain*54*256)/
+                                    ((int64_t)100*tuned.period));
+    tuned.dutyCycle = bias;
+    resultAvailable = true;
+}
+
@@ -0,0 +1,61 @@
+/* STM32F1 SMPS Relay Feedback Auto-Tune
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUTOTUNE_H_
+#define AUTOTUNE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Relay amplitude about the starting duty cycle, in promille */
+#define AUTOTUNE_AMPLITUDE  50
+/* Relay hysteresis about the setpoint, in units of the regulated value */
+#define AUTOTUNE_HYSTERESIS 10
+/* Oscillation cycles discarded while the limit cycle builds up, then
+measured */
+#define AUTOTUNE_SETTLE     2
+#define AUTOTUNE_CYCLES     4
+/* Regulator periods after which the tune is abandoned */
+#define AUTOTUNE_TIMEOUT    3000
+
+/* Identified plant and the PI gains derived from it */
+typedef struct {
+    int32_t period;             /* Ultimate period, regulator periods Q8 */
+    int32_t ultimateGain;       /* Promille per unit error, Q16 */
+    int32_t plantGain;          /* Regulated units per promille, Q16 */
+    int32_t proportionalGain;   /* Promille per unit error, Q16 */
+    int32_t integralGain;       /* Promille per unit error per period, Q16 */
+    int16_t dutyCycle;          /* Operating point of the tune */
+} AutotuneResult;
+
+void autotuneStart(int16_t dutyCycle);
+void autotuneStop(void);
+bool autotuneRunning(void);
+int16_t autotuneUpdate(int32_t setValue, int32_t isValue);
+bool autotuneResult(AutotuneResult* result);
+
+#endif
+
@@ -0,0 +1,105 @@
+/* STM32F1 SMPS Perceptual Brightness
+
+Brightness levels from 0 to 65535 are mapped to the channel 1 setpoint or the
+channel 2 duty cycle through a perceptual curve, so that equal steps of level
+look like equal steps of brightness. Without this, low levels are coarse as
+the eye responds roughly to the cube root of luminance.
+
+The curves are tables of the fraction of full scale in Q16, generated on the
+host at build time by table-gen. Between table entries the fraction is
+interpolated linearly, so no floating point is needed on the device. Each
+channel has its own curve and full scale.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "brightness.h"
+
+/*--------------------------------------------------------------------------*/
+/* Channel settings */
+
+static uint8_t curve[BRIGHTNESS_CHANNELS];
+static int32_t fullScale[BRIGHTNESS_CHANNELS];
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the brightness channels
+
+Both channels use the CIE curve. The setpoint full scale is
+BRIGHTNESS_FULL_SCALE and the duty cycle full scale 1000 promille.
+*/
+
+void brightnessInit(void)
+{
+    curve[BRIGHTNESS_SETPOINT] = BRIGHTNESS_CIE;
+    curve[BRIGHTNESS_DUTY2] = BRIGHTNESS_CIE;
+    fullScale[BRIGHTNESS_SETPOINT] = BRIGHTNESS_FULL_SCALE;
+    fullScale[BRIGHTNESS_DUTY2] = 1000;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the curve and full scale of a channel
+
+@param[in] uint8_t channel: BRIGHTNESS_SETPOINT or BRIGHTNESS_DUTY2.
+@param[in] uint8_t curveSelect: BRIGHTNESS_LINEAR, BRIGHTNESS_GAMMA or
+           BRIGHTNESS_CIE.
+@param[in] int32_t scale: output at the highest level.
+*/
+
+void brightnessSetCurve(uint8_t channel, uint8_t curveSelect)
+{
+    if ((channel < BRIGHTNESS_CHANNELS) && (curveSelect < BRIGHTNESS_CURVES))
+        curve[channel] = curveSelect;
+}
+
+void brightnessSetFullScale(uint8_t channel, int32_t scale)
+{
+    if (channel < BRIGHTNESS_CHANNELS) fullScale[channel] = scale;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Map a brightness level to the output of a channel
+
+@param[in] uint8_t channel: BRIGHTNESS_SETPOINT or BRIGHTNESS_DUTY2.
+@param[in] uint16_t level: perceptual level, 65535 is full brightness.
+@returns int32_t: setpoint or duty cycle, rounded to nearest.
+*/
+
+int32_t brightnessMap(uint8_t channel, uint16_t level)
+{
+    if (channel >= BRIGHTNESS_CHANNELS) return 0;
+    uint32_t fraction = level;
+    if ((curve[channel] != BRIGHTNESS_LINEAR) && (level < 0xFFFF))
+    {
+        const uint16_t* table = brightnessTable[curve[channel] - 1];
+        uint16_t index = level >> (16 - BRIGHTNESS_TABLE_BITS);
+        uint32_t position = level & ((1 << (16 - BRIGHTNESS_TABLE_BITS)) - 1);
+        fraction = ((uint32_t)table[index]*
+                    ((1 << (16 - BRIGHTNESS_TABLE_BITS)) - position) +
+                    (uint32_t)table[index + 1]*position) >>
+                   (16 - BRIGHTNESS_TABLE_BITS);
+    }
+    return ((int64_t)fraction*fullScale[channel] + 0x7FFF)/0xFFFF;
+}
+
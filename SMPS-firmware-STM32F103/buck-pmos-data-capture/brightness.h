@@ -0,0 +1,63 @@
+/* STM32F1 SMPS Perceptual Brightness
+
+This header file contains defines and prototypes. It is also included by the
+host table generator.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BRIGHTNESS_H_
+#define BRIGHTNESS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Brightness channels */
+#define BRIGHTNESS_SETPOINT 0   /* Channel 1 regulator setpoint */
+#define BRIGHTNESS_DUTY2    1   /* Channel 2 duty cycle, in buck mode */
+#define BRIGHTNESS_CHANNELS 2
+
+/* Curves from perceptual level to output. All but the linear curve are
+tables generated at build time. */
+#define BRIGHTNESS_LINEAR   0
+#define BRIGHTNESS_GAMMA    1   /* Power law, gamma 2.2 */
+#define BRIGHTNESS_CIE      2   /* CIE 1976 L* lightness */
+#define BRIGHTNESS_CURVES   3
+
+/* Tables are indexed by the top bits of the level and interpolated */
+#define BRIGHTNESS_TABLE_BITS 8
+#define BRIGHTNESS_TABLE_SIZE ((1 << BRIGHTNESS_TABLE_BITS) + 1)
+
+/* Default full scale of the setpoint channel, in mA */
+#define BRIGHTNESS_FULL_SCALE 1000
+
+/* Output fraction of full scale in Q16, from tables.c */
+extern const uint16_t brightnessTable[BRIGHTNESS_CURVES - 1]
+                                     [BRIGHTNESS_TABLE_SIZE];
+
+void brightnessInit(void);
+void brightnessSetCurve(uint8_t channel, uint8_t curve);
+void brightnessSetFullScale(uint8_t channel, int32_t fullScale);
+int32_t brightnessMap(uint8_t channel, uint16_t level);
+
+#endif
+
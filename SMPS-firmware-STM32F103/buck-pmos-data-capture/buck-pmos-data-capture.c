@@ -3,18 +3,128 @@
 An ASCII based command-response interface is provided to control a SMPS
 and to retrieve data captured during a run.
 
-Data capture is via the ADC input channels 4 to 7 on PA4-7.
+Data capture is via the ADC input channels 4 to 7 on PA4-7. PA4 and PA5 are
+the output voltage and current, PA6 and PA7 the input voltage and current.
 PWM is from timer 1: CH2 on PA9, CH3 on PA10, CH2N on PB14, CH3N on PB15.
-CH1(N) is the buck synchronous PWM and CH2(N) is the boost synchronous PWM.
+CH2(N) is the buck synchronous PWM and CH3(N) is the boost synchronous PWM.
 USART2 is the serial communications peripheral (USART1 clashes with timer 1
 and the alternative advanced timer 8 doesn't exist).
 
-- 'aE' Send back identifier string
+- 'ai' Send back identifier string
 - 'ac+' 'ac-' turn on/off data capture.
-- set parameters for capture frequency, PWM duty cycle
-- turn on/off power
+- 'pf' 'pp' 'pq' 'ps' 'pg' set PWM frequency, duty cycles, setpoint and gain
+  divisor. Setting the gain divisor discards any tuned gains.
+- 'at' relay auto-tune of the buck regulator at the present operating point,
+  reported as "tu, <ultimate period Q8>, <ultimate gain Q16>",
+  "tk, <duty cycle>, <plant gain Q16>" and "pi, <Kp Q16>, <Ki Q16>".
+  'ph+' 'ph-' turn on/off scheduling of the tuned gains over duty cycle.
+- 'pe' 'pk' 'pl' set feed-forward mode (0 off, 1 from the measured output
+  voltage, 2 LED model) and LED model knee and slope. 'pe2' is refused until
+  'pk' and 'pl' have been set.
+- 'pm' set control mode, 0 buck, 1 buck-boost or 2 MPPT with the setpoint
+  as an output limit
+- 'ma' 'ms' 'mr' set MPPT algorithm (0 P&O, 1 incremental conductance), duty
+  cycle step and tracking interval in regulator periods. The telemetry line
+  "mppt, <power>, <efficiency>" gives the tracked power and the tracking
+  efficiency in promille.
+- 'pn+' 'pn-' turn on/off synchronous rectification, 'pd' set dead time
+- 'pt' set the light load threshold in mA (0 disables), 'pv' the lowest
+  light load frequency in kHz. Below the threshold the PWM frequency is
+  reduced with the load, and at a quarter of it periods are skipped in
+  bursts. The telemetry line "ll, <frequency>, <skipped>" is sent while in
+  light load.
+- 'qc' select a profile channel, 0 the setpoint or 1 the channel 2 duty
+  cycle in buck mode. 'qz' clears its keyframes, 'qt' gives the time of the
+  next keyframe in regulator periods and 'qv' its value, adding it. 'qi' sets
+  interpolation 0 step, 1 linear or 2 eased, and 'ql+' 'ql-' looping. 'qs'
+  starts the channels in a bit mask together and 'qx' stops all. A running
+  setpoint profile overrides 'ps', and a finished one leaves its last value
+  as the setpoint. The telemetry line "qp, <running mask>, <time>" is sent
+  while a profile runs.
+- 'bc' select a brightness channel, 0 the setpoint or 1 the channel 2 duty
+  cycle in buck mode. 'bk' sets its curve, 0 linear, 1 gamma 2.2 or 2 CIE L*,
+  and 'bf' its full scale. 'bl' sets a perceptual level 0-65535, mapped
+  through the curve to the channel.
+- 'wz' clears the waveform upload table, 'wa' gives the buck and 'wb' the
+  boost duty cycle of the next entry, adding it. 'wr' sets the PWM periods
+  each entry is held and 'wn' the number of plays, 0 for continuous. 'wp'
+  plays the upload table, or during playback switches to it at the end of
+  the current table, and 'wx' stops. The regulator is suspended during
+  playback.
+- 'ad' sweep the dead time for the lowest input power, reported as "dt"
+- 'cc' select an ADC input 4-7 for calibration, then 'cg' 'co' 'cq' set gain,
+  offset and second order term, or 'cl' 'ch' give the true value at a low and
+  high reference. 'cw' saves to FLASH, 'cd' restores defaults.
+- 'dp' send the energy (J) and charge (C) through the input and output as
+  "ei" and "eo", and the accounted time (s) and efficiency (promille) as
+  "et". 'dz' restarts the accounting.
+- 'dr' send raw ADC counts
+- 'as' analyse the switching ripple on an ADC input 4-7. The input is
+  sampled in equivalent time over the PWM period, and the amplitude and
+  phase of each harmonic of the switching frequency found on the device.
+  "sf, <frequency Hz>, <steps>" gives the switching frequency and the
+  sample steps in its period, then "s1" to "s8" give each harmonic's
+  amplitude in uV or uA and phase in tenths of a degree from the middle of
+  the off time. Harmonics from half the steps are not resolved and not sent.
+  Light load bursts, waveform playback and a burst capture must be off.
+- 'rc' select an ADC input 4-7 watched for transients, 'rd' set the change
+  between scans that triggers a capture and 'rs' the deviation of the output
+  current from the setpoint, 0 disabling either. 'rw' sets the full rate
+  scans in the window. 'ra+' 'ra-' arm or disarm triggering. A trigger
+  switches the ADC to full rate scans for the window, and is reported as
+  "rt, <cause>, <excursion>" with cause 1 the change or 2 the deviation.
+  'rr' sends the capture as "ri, <interval ns>, <scans>" ahead of the base
+  rate scans before the trigger and again ahead of the window, each scan as
+  "ra, <output voltage>, <output current>" and
+  "rb, <input voltage>, <input current>", then "re, <scans>, <cause>".
+  Triggering resumes afterwards while armed.
+- 'jd' set the regulator deadline in us after the timer 2 compare, 'js' the
+  consecutive misses at which telemetry is shed and 'jf' those at which the
+  PWM is held off, 0 never. A lost compare is also a miss. Changes of level
+  are reported as "je, <level>, <misses>" with level 0 normal, 1 shedding or
+  2 safe. 'jx' returns to normal. 'jr' sends the counts, lateness and jitter
+  histograms in processor cycles and restarts them, as "jn, <activations>,
+  <misses>", "jc, <longest run>, <level>", "jm, <longest lateness>,
+  <deadline>", "jp, <shortest>, <longest period>", then "jl" for lateness
+  and "jj" for the period from nominal, each "<bin start>, <count>".
+- 'ub' propose a serial link rate, answered "ub, <rate>, <trial ms>" at the
+  present rate before changing to it. 'ut' sends a test pattern generated
+  from the seed given as "ut,<pattern>", and 'uc' confirms the new rate,
+  without which it reverts after the trial time, as it does on a receive
+  error in that time. Repeated receive errors at a negotiated rate return to
+  the compiled rate, reported at it as "uf, <rate>, <errors>". 'ul' sends
+  "ul, <rate>, <errors>" with the errors counted since reset.
+- 'ks' send "ks, <free records>, <pending changes>" of the parameter store,
+  and 'kz' remove all saved parameters so that the defaults are used after
+  the next reset. The PWM frequency and duty cycles, setpoint, gain divisor,
+  gain scheduling, control and feed-forward modes, LED model, synchronous
+  mode, dead time, light load threshold and frequency, MPPT settings,
+  brightness curves and full scales, and the gains of each auto-tune and
+  the dead time of each sweep are saved in FLASH as they are set and
+  restored at reset. If the FLASH can no longer take the changes this
+  is reported once as "kf, <pending changes>, <free records>".
+- 'db' fixed point arithmetic cycle benchmark
+- 'dl' send processor cycle times and restart their measurement. "tl" gives
+  the shortest and longest time from starting an ADC scan to entering its
+  ISR, and "ta" "tc" "tr" the shortest and longest execution of the ADC ISR,
+  the USART ISR and the regulator update. The difference is the jitter.
+  "tm" gives 1 if the hot paths run from RAM, 0 if built with RAMFUNC=0, and
+  the number of ADC scans measured.
 - retrieve next data set
 
+Measurements, setpoints and telemetry are in calibrated units (mV or mA).
+The telemetry line "pw, <input>, <output>" gives the average power in mW
+over the telemetry interval, and "ef, <efficiency>" the efficiency in
+promille since the accounting was last restarted.
+
+Commands are interpreted by the table in commands.c. Several may be sent on
+one line, or in a binary frame, and are then applied together.
+
+Every command line is answered with "ack, <sequence>, <status>" where the
+sequence id counts received lines from reset and status 0 is success. Status
+6 is a command refused in the present state, such as a waveform entry that
+does not fit; the commands after it on the line are then not acted on.
+
 5 December 2015
 */
 
@@ -45,15 +155,37 @@ and the alternative advanced timer 8 doesn't exist).
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/cortex.h>
 #include "buffer.h"
 #include "stringlib.h"
 #include "commslib.h"
+#include "commands.h"
+#include "control.h"
+#include "calibration.h"
+#include "fixmath.h"
+#include "deadtime.h"
+#include "mppt.h"
+#include "lightload.h"
+#include "energy.h"
+#include "autotune.h"
+#include "profile.h"
+#include "waveform.h"
+#include "brightness.h"
+#include "ramfunc.h"
+#include "latency.h"
+#include "acquisition.h"
+#include "deadline.h"
+#include "link.h"
+#include "store.h"
+#include "mainloop.h"
 #include "buck-pmos-data-capture.h"
 
 /*--------------------------------------------------------------------------*/
 /* Global Variables */
 uint32_t v[NUM_CHANNEL];    /* Captured data array, one scan */
 uint32_t data[NUM_CHANNEL]; /* Captured data array for the run */
+volatile int32_t measured[NUM_CHANNEL]; /* Calibrated scan in mV or mA */
 uint8_t adceoc;             /* A/D end of conversion flag */
 /* Settable Parameters */
 uint16_t dataBlockSize;
@@ -61,21 +193,23 @@ uint8_t capture;         /* Activate and stop data capture */
 uint16_t frequency;         /* PWM frequency in kHz */
 int16_t ch1DutyCycle;   /* Duty cycle % for buck converter */
 int16_t ch2DutyCycle; /* Duty cycle % for boost converter */
-int32_t modifier = 0, isValue = 0, setValue = 0;
+int32_t isValue = 0, setValue = 0;
+bool synchronous;       /* Synchronous rectification with CH2N/CH3N */
+uint8_t deadtime;       /* TIM1 dead time in BDTR DTG counts */
+/* Burst operation, shared with the timer 1 update ISR */
+static volatile uint8_t burstOffPeriods; /* PWM periods skipped, 0 if off */
+static volatile bool burstSwitching;     /* In the switched phase */
+static uint32_t pwmPeriod;              /* TIM1 period in counts */
 
 /*--------------------------------------------------------------------------*/
 
 int main(void) {
   uint8_t i = 0;     /* Channel counter */
-  uint8_t index = 0; /* index into storage array */
 
   uint8_t channelArray[NUM_CHANNEL];
-  uint8_t characterPosition = 0;
-  uint8_t line[LINE_SIZE];
-  capture = false;
-  dataBlockSize = DATA_BLOCK_SIZE;
-  uint16_t comDelay = 0;
-  uint16_t regDelay = 0;
+
+  /* RAM resident code must be in place before any interrupt */
+  ramfuncCopy();
 
   /* Initialize peripherals */
   clockSetup();
@@ -83,173 +217,40 @@ int main(void) {
   usartSetup();
   dmaAdcSetup();
   adcSetup();
-  timer2Setup(0x8FFF);
+  timer2Setup(SCAN_COMPARE);
   timer1SetupPWM();
-  commsInit();
-
-  /* Set initial PWM to safe values. */
-  frequency = FREQUENCY;
-  ch1DutyCycle = 0;
-  ch2DutyCycle = 0;
-  timer1PWMsettings(frequency, ch1DutyCycle, ch2DutyCycle);
-
-  /* Setup array of selected channels for conversion and clear the data array
-  for
-  the first pass */
-  for (i = 0; i < NUM_CHANNEL; i++) {
+
+  /* Setup array of selected channels for conversion */
+  for (i = 0; i < NUM_CHANNEL; i++)
     channelArray[i] = i + 4;
-    v[i] = 0;
-  }
   adc_set_regular_sequence(ADC1, NUM_CHANNEL, channelArray);
-  commsPrintString("\nAll meow!\n");
+
+  /* Initialise the modules and restore the saved parameters */
+  mainLoopInit(BAUDRATE);
   gpio_clear(GPIOC, GPIO13); //debug LED
   while (1) {
-
-    /* Build a command line string before actioning. */
-    uint16_t character = commsNextCharacter();
-    if (character < 0x100) /* returns 0x100 if no character received */
-    {
-      if ((character == 0x0D) || (character == 0x0A) ||
-          (characterPosition > LINE_SIZE - 2)) {
-        line[characterPosition] = 0;
-        characterPosition = 0;
-        parseCommand(line);
-      } else
-        line[characterPosition++] = character;
-    }
+    mainLoopPass();
 
     /* Activate the ADC conversions after the preset time in timer 2 has
     elapsed.
     Without timer 2 prescaler this has a maximum of 2 ms period. */
     if (timer_get_flag(TIM2, TIM_SR_CC1IF) && capture) {
+      /* Timer 2 counts processor cycles since the compare that is due */
+      uint16_t lateness = timer_get_counter(TIM2) - SCAN_COMPARE;
       timer_clear_flag(TIM2, TIM_SR_CC1IF);
 
-      if (regDelay++ > 10) {//every 10ms
-        isValue = v[1];
-        modifier = setValue - isValue;
-        modifier = (int)(modifier / 50);
-
-        if (modifier == 0 && setValue < isValue - 10) {
-          modifier = -1;
-        }
-
-        if (modifier == 0 && setValue > isValue + 10) {
-          modifier = 1;
-        }
-
-        ch1DutyCycle += modifier;
-
-        if (ch1DutyCycle > 1000) {
-          ch1DutyCycle = 1000;
-        }
-
-        if (ch1DutyCycle < 0) {
-          ch1DutyCycle = 0;
-        }
-
-        timer1PWMsettings(frequency, ch1DutyCycle, ch2DutyCycle);
-        regDelay = 0;
-      }
-      /* Delay a bit more to slow down comms to once per second */
-      if (comDelay++ > 200) {
-        /* Store previous conversion results, which should be well in by now. */
-        sendResponse("Channel 1: ", v[1]);
-        sendResponse("Channel 2: ", v[0]);
-
-        sendResponse("isValue: ", isValue);
-        sendResponse("setValue: ", setValue);
-
-        sendResponse("modifier: ", modifier);
-        sendResponse("PWM: ", ch1DutyCycle);
-
-        comDelay = 0;
+      /* Regulator and telemetry, then reset timer and initiate next data
+      capture */
+      if (mainLoopScan(lateness)) {
+        latencyMark(LATENCY_ADC);
+        adc_start_conversion_regular(ADC1);
       }
-      /* Reset timer and initiate next data capture */
-      adc_start_conversion_regular(ADC1);
     }
   }
 
   return 0;
 }
 
-/*--------------------------------------------------------------------------*/
-/** @brief Parse a command line and act on it.
-
-Commands begin with a lower case letter a, d, p or f followed by an upper case
-command letter. The line is terminated by a 0. If the line does not form a
-recognizable command it is ignored. Any characters following a recognized
-command are also ignored.
-
-Unrecognizable messages should just be discarded.
-
-@param[in] char *line: the command line in ASCII
-*/
-
-void parseCommand(uint8_t *line) {
-  /* Action commands */
-  if (line[0] == 'a') {
-    switch (line[1]) {
-    /* Start capture 'ac+' stop capture 'ac-' */
-    case 'c': {
-      capture = (line[2] == '+');
-      break;
-    }
-    /* Send ident response */
-    case 'i': {
-
-      // char ident[35] = "SMPS, Firmware: ";
-      // strcat(ident, FIRMWARE_VERSION);
-      // sendString("dE",ident);
-      commsPrintString("\nEntropia e.V. LED control\n");
-      // commsPrintString(ident);
-      // gpio_set(GPIOC, GPIO13);
-      break;
-    }
-    }
-  }
-  /* Parameter setting commands */
-  else if (line[0] == 'p') {
-    /* Set the timer 2 count to set data sampling intervals, only if non zero.*/
-    switch (line[1]) {
-    case 'f': {
-      uint16_t tempFrequency = asciiToInt((char *)line + 2);
-      if (tempFrequency > 0 && tempFrequency < 1000) {
-        frequency = tempFrequency;
-        timer1PWMsettings(frequency, ch1DutyCycle, ch2DutyCycle);
-      }
-      sendResponse("Changing PWM frequncy interval to (kHz): ", frequency);
-      break;
-    }
-    }
-    /* Set the timer 1 PWM .*/
-    switch (line[1]) {
-    case 'p': {
-      uint16_t ch1DutyCycle = asciiToInt((char *)line + 2);
-      if (ch1DutyCycle <= 1000)
-        timer1PWMsettings(frequency, ch1DutyCycle, ch2DutyCycle);
-      sendResponse("Changeing Channel 1 PWM duty cycle to: ", ch1DutyCycle);
-      break;
-    }
-    }
-
-    /* Change setPoint .*/
-    switch (line[1]) {
-    case 's': {
-      uint16_t tempSetValue = asciiToInt((char *)line + 2);
-      if (tempSetValue <= 4095 && tempSetValue >= 0) {
-        setValue = tempSetValue;
-        sendResponse("Changeing setpoint of Channel 1 to: ", setValue);
-      }
-
-      break;
-    }
-    }
-  }
-  /* Send a single line of results */
-  else if (line[0] == 'd') {
-  }
-}
-
 /*--------------------------------------------------------------------------*/
 /** @brief Clock Setup
 
@@ -282,8 +283,8 @@ void gpioSetup(void) {
   /* Set ports PA9 (TIM1_CH2), PA10 (TIM1_CH3), PB14 (TIM1_CH2N), PB15
   (TIM1_CH3N)
   for PWM, to 'alternate function output push-pull'. */
-  gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_PUSHPULL,
-                GPIO9 | GPIO10);
+  gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ,
+                GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO9 | GPIO10);
   //gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_PUSHPULL,
                 //GPIO14 | GPIO15);
 
@@ -325,13 +326,32 @@ void usartSetup(void) {
   usart_enable(USART2);
 }
 
+/*--------------------------------------------------------------------------*/
+/** @brief USART Rate Change
+
+Wait for the last character to leave the transmitter, then change the baud
+rate. The wait is limited in case the transmitter is disabled.
+
+@param[in] uint32_t baud: new rate.
+*/
+
+void usartSetRate(uint32_t baud) {
+  dwt_enable_cycle_counter();
+  uint32_t wait = dwt_read_cycle_counter();
+  while (!usart_get_flag(USART2, USART_SR_TC) &&
+         (dwt_read_cycle_counter() - wait < USART_DRAIN_CYCLES))
+    ;
+  usart_set_baudrate(USART2, baud);
+}
+
 /*--------------------------------------------------------------------------*/
 /** @brief DMA Setup
 
 Enable DMA 1 Channel 1 to take conversion data from ADC 1, and also ADC 2 when
 the ADC is used in dual mode. The ADC will dump a burst of data to memory each
-time, and we need to grab it before the next conversions start. This must be
-called after each transfer to reset the memory buffer to the beginning.
+time, and we need to grab it before the next conversions start. The ADC ISR
+reloads the count after each transfer to reset the memory buffer to the
+beginning.
 */
 
 void dmaAdcSetup(void) {
@@ -367,6 +387,7 @@ void adcSetup(void) {
   /* ADC clock should be maximum 14MHz, so divide by 8 from 72MHz. */
   rcc_set_adcpre(RCC_CFGR_ADCPRE_PCLK2_DIV8);
   nvic_enable_irq(NVIC_ADC1_2_IRQ);
+  nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
   /* Make sure the ADC doesn't run during config. */
   adc_power_off(ADC1);
   /* Configure ADC1 for multiple conversion. */
@@ -425,46 +446,395 @@ void timer1SetupPWM(void) {
   //timer_enable_oc_output(TIM1, TIM_OC3N);
   timer_enable_oc_output(TIM1, TIM_OC3);
   timer_enable_break_main_output(TIM1);
-  /* Set the polarity of OC1N to be low to match that of the OC1, for switching
-  the low side MOSFET through an inverting level shifter */
-  //timer_set_oc_polarity_low(TIM1, TIM_OC2N);
-  /* Set the deadtime for OC1N. All deadtimes are set to this.
-  Set to default as there is no need to change this on the fly. */
-  //timer_set_deadtime(TIM1, DEADTIME);
+  /* Set the polarity of OC2N and OC3N to be low to match that of OC2 and OC3,
+  for switching the low side MOSFETs through inverting level shifters */
+  timer_set_oc_polarity_low(TIM1, TIM_OC2N);
+  timer_set_oc_polarity_low(TIM1, TIM_OC3N);
+  /* Set the deadtime for OC2N and OC3N. All deadtimes are set to this. The
+  complementary outputs are only enabled in synchronous mode. */
+  timer_set_deadtime(TIM1, DEADTIME);
+  /* Only counter overflow and underflow raise the update interrupt, used
+  for burst operation. */
+  timer_update_on_overflow(TIM1);
+  nvic_enable_irq(NVIC_TIM1_UP_IRQ);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Synchronous Rectification
+
+Enable or disable the complementary outputs CH2N on PB14 and CH3N on PB15.
+When disabled the pins are left floating so that the synchronous switches
+stay off and the converter runs asynchronously on the diodes.
+
+@param[in] bool enable: true for synchronous operation.
+*/
+
+void timer1SetSynchronous(bool enable) {
+  if (enable) {
+    timer_enable_oc_output(TIM1, TIM_OC2N);
+    timer_enable_oc_output(TIM1, TIM_OC3N);
+    gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
+                  GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO14 | GPIO15);
+  } else {
+    gpio_set_mode(GPIOB, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
+                  GPIO14 | GPIO15);
+    timer_disable_oc_output(TIM1, TIM_OC2N);
+    timer_disable_oc_output(TIM1, TIM_OC3N);
+  }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Dead Time
+
+The DTG field is cleared before the new setting goes in, as
+timer_set_deadtime() ORs it onto the old one, which could only lengthen the
+dead time.
+
+@param[in] uint8_t deadtimeSetting: BDTR DTG setting.
+*/
+
+void timer1SetDeadtime(uint8_t deadtimeSetting) {
+  TIM_BDTR(TIM1) = (TIM_BDTR(TIM1) & ~TIM_BDTR_DTG_MASK) | deadtimeSetting;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Burst Operation
+
+In burst operation BURST_ON_PERIODS PWM periods are switched and then a
+number of periods skipped with the outputs forced inactive. The repetition
+counter marks the end of each phase with an update interrupt, where the
+outputs are changed and the length of the following phase is loaded. In
+centre aligned mode there are two updates per PWM period.
+
+@param[in] uint8_t offPeriods: periods skipped, zero for continuous switching.
+*/
+
+void timer1SetBurst(uint8_t offPeriods) {
+  if (offPeriods == burstOffPeriods) return;
+  if (offPeriods == 0) {
+    timer_disable_irq(TIM1, TIM_DIER_UIE);
+    burstOffPeriods = 0;
+    timer_set_repetition_counter(TIM1, 0);
+    timer_set_oc_mode(TIM1, TIM_OC2, TIM_OCM_PWM2);
+    timer_set_oc_mode(TIM1, TIM_OC3, TIM_OCM_PWM2);
+    return;
+  }
+  /* Starting, the current switching phase ends at the next update. */
+  if (burstOffPeriods == 0) {
+    burstSwitching = true;
+    timer_set_repetition_counter(TIM1, 2 * offPeriods - 1);
+    timer_clear_flag(TIM1, TIM_SR_UIF);
+    timer_enable_irq(TIM1, TIM_DIER_UIE);
+  }
+  burstOffPeriods = offPeriods;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Power from voltage and current
+
+@param[in] int32_t voltage: in mV.
+@param[in] int32_t current: in mA.
+@returns int32_t: power in mW.
+*/
+
+int32_t power(int32_t voltage, int32_t current) {
+  return mulSaturate(voltage, current, 0) / 1000;
 }
 
 /*--------------------------------------------------------------------------*/
 /** @brief Timer 1 Set PWM Parameters
 
-@param[in] uint16_t frequncy in kHz.
-@param[in] uint16_t ch1DutyCycle: promille duty cycle
-@param[in] uint16_t ch2DutyCycle.: promille duty cycle
+The period is only looked up when the frequency changes. Duty cycles are
+clamped to the valid range.
+
+@param[in] uint16_t pwmFrequency: frequency in kHz.
+@param[in] int16_t buckDutyCycle: promille duty cycle
+@param[in] int16_t boostDutyCycle: promille duty cycle
 */
 
-void timer1PWMsettings(uint16_t frequency, int16_t ch1DutyCycle,
-                       int16_t ch2DutyCycle) {
-  /* The ARR (auto-preload register) sets the PWM period to frequency (in kHz) from the
-  72 MHz clock.*/
+void timer1PWMsettings(uint16_t pwmFrequency, int16_t buckDutyCycle,
+                       int16_t boostDutyCycle) {
+  static uint16_t lastFrequency = 0;
+  /* The ARR (auto-preload register) sets the PWM period to frequency (in kHz)
+  from the 72 MHz clock, looked up to avoid a division.*/
+  if (pwmFrequency != lastFrequency) {
+    pwmPeriod = pwmPeriodTable[clamp(pwmFrequency, 1, PWM_FREQUENCY_MAX)];
+    lastFrequency = pwmFrequency;
+    waveformConvert(pwmPeriod);
+  }
   timer_enable_preload(TIM1);
-  uint16_t period = 72000 / frequency;
-  timer_set_period(TIM1, period);
-
-  ch1DutyCycle = 1000 - ch1DutyCycle;
-  ch2DutyCycle = 1000 - ch2DutyCycle;
+  timer_set_period(TIM1, pwmPeriod);
+  /* During waveform playback the compare values come from the table. */
+  if (waveformRunning())
+    return;
+  /* The update event would restart a burst phase, the preloaded values are
+  taken up at the end of the phase anyway. */
+  bool burst = (burstOffPeriods != 0);
+
+  /* Outputs are in PWM mode 2, so the compare value sets the off time. */
+  uint32_t buckOff = 1000 - clamp(buckDutyCycle, 0, 1000);
+  uint32_t boostOff = 1000 - clamp(boostDutyCycle, 0, 1000);
 
   /* The CCR1 (capture/compare register 1) sets PWM duty cycle to default 50% */
   timer_enable_oc_preload(TIM1, TIM_OC2);
-  timer_set_oc_value(TIM1, TIM_OC2, (period * ch1DutyCycle) / 1000);
+  timer_set_oc_value(TIM1, TIM_OC2, (pwmPeriod * buckOff) / 1000);
   timer_enable_oc_preload(TIM1, TIM_OC3);
-  timer_set_oc_value(TIM1, TIM_OC3, (period * ch2DutyCycle) / 1000);
+  timer_set_oc_value(TIM1, TIM_OC3, (pwmPeriod * boostOff) / 1000);
 
   /* Force an update to load the shadow registers */
-  timer_generate_event(TIM1, TIM_EGR_UG);
+  if (!burst)
+    timer_generate_event(TIM1, TIM_EGR_UG);
 
   /* Start the Counter. */
   timer_enable_counter(TIM1);
 }
 
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Update ISR
+
+Alternate between the switched and skipped phases of a burst. The repetition
+counter has already taken up the length of the phase now starting, so the
+length of the one after is loaded.
+*/
+
+void tim1_up_isr(void) {
+  timer_clear_flag(TIM1, TIM_SR_UIF);
+  burstSwitching = !burstSwitching;
+  if (burstSwitching) {
+    timer_set_oc_mode(TIM1, TIM_OC2, TIM_OCM_PWM2);
+    timer_set_oc_mode(TIM1, TIM_OC3, TIM_OCM_PWM2);
+    timer_set_repetition_counter(TIM1, 2 * burstOffPeriods - 1);
+  } else {
+    timer_set_oc_mode(TIM1, TIM_OC2, TIM_OCM_FORCE_LOW);
+    timer_set_oc_mode(TIM1, TIM_OC3, TIM_OCM_FORCE_LOW);
+    timer_set_repetition_counter(TIM1, 2 * BURST_ON_PERIODS - 1);
+  }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Waveform Playback
+
+Play the waveform upload table, or switch to it at the end of the table
+being played.
+
+At each update event the TIM1 DMA burst has DMA1 channel 5 write two
+halfwords through DMAR, starting at CCR2, so that CCR2 and CCR3 are loaded
+from the next table entry. Being preloaded, they take effect at the
+following update. The repetition counter holds each entry for the set
+number of PWM periods, and the DMA is circular so that the table repeats
+with no CPU involvement. Burst operation is stopped as it also uses the
+repetition counter.
+
+@returns bool: false if there is nothing to play.
+*/
+
+bool timer1WaveformPlay(void) {
+  bool playing = waveformRunning();
+  if (!waveformPlay(pwmPeriod))
+    return false;
+  if (playing)
+    return true;
+  timer1SetBurst(0);
+  dma_channel_reset(DMA1, DMA_CHANNEL5);
+  dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_HIGH);
+  dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_16BIT);
+  dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_16BIT);
+  dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+  dma_set_read_from_memory(DMA1, DMA_CHANNEL5);
+  dma_enable_circular_mode(DMA1, DMA_CHANNEL5);
+  dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t)&TIM_DMAR(TIM1));
+  dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t)waveformTable());
+  dma_set_number_of_data(DMA1, DMA_CHANNEL5, waveformTransfers());
+  dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
+  nvic_enable_irq(NVIC_DMA1_CHANNEL5_IRQ);
+  dma_enable_channel(DMA1, DMA_CHANNEL5);
+  /* DMA burst base address in words from TIM1_CR1, and length less one */
+  TIM_DCR(TIM1) = ((WAVEFORM_CHANNELS - 1) << 8) |
+                  (((uint32_t)&TIM_CCR2(TIM1) - TIM1) / 4);
+  timer_set_repetition_counter(TIM1, 2 * waveformRepeat() - 1);
+  timer_enable_irq(TIM1, TIM_DIER_UDE);
+  return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Waveform Stop
+
+The compare values of the last entry remain until the regulator next sets
+the PWM.
+*/
+
+void timer1WaveformStop(void) {
+  waveformStop();
+  timer_disable_irq(TIM1, TIM_DIER_UDE);
+  dma_disable_channel(DMA1, DMA_CHANNEL5);
+  timer_set_repetition_counter(TIM1, 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Period
+
+@returns uint32_t: PWM period register. In centre aligned mode the PWM
+period is twice this in timer counts.
+*/
+
+uint32_t timer1Period(void) { return pwmPeriod; }
+
+/*--------------------------------------------------------------------------*/
+/** @brief ADC Block Capture
+
+Take a block of samples of one ADC input, converted at each update of timer
+3 and transferred by DMA, for spectrum analysis. Timer 3 runs from the same
+clock as timer 1 so that the samples keep their place in the PWM period.
+
+The scan started by the main loop is left to finish with its ISR disabled,
+and is lost. Afterwards the ADC and DMA are set up again for the scans.
+
+@param[in] uint8_t channel: ADC input 4-7.
+@param[out] uint16_t* block: ADC counts.
+@param[in] uint16_t count: samples to take.
+@param[in] uint16_t samplePeriod: timer counts between samples, at least
+           SPECTRUM_SAMPLE_MIN.
+@param[out] uint32_t* start: timer counts from the PWM counter at zero to
+            the first sample, to within a few counts.
+@returns bool: false if the block did not complete.
+*/
+
+bool adcCaptureBlock(uint8_t channel, uint16_t *block, uint16_t count,
+                     uint16_t samplePeriod, uint32_t *start) {
+  adc_disable_eoc_interrupt(ADC1);
+  dwt_enable_cycle_counter();
+  uint32_t wait = dwt_read_cycle_counter();
+  while (dwt_read_cycle_counter() - wait < ADC_SCAN_CYCLES)
+    ;
+
+  /* One conversion of the input on each timer 3 update */
+  adc_disable_scan_mode(ADC1);
+  adc_set_regular_sequence(ADC1, 1, &channel);
+  adc_set_sample_time(ADC1, channel, ADC_SMPR_SMP_7DOT5CYC);
+  adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM3_TRGO);
+  dma_disable_channel(DMA1, DMA_CHANNEL1);
+  dma_set_memory_size(DMA1, DMA_CHANNEL1, DMA_CCR_MSIZE_16BIT);
+  dma_set_peripheral_size(DMA1, DMA_CHANNEL1, DMA_CCR_PSIZE_16BIT);
+  dma_set_memory_address(DMA1, DMA_CHANNEL1, (uint32_t)block);
+  dma_set_number_of_data(DMA1, DMA_CHANNEL1, count);
+  dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+  dma_enable_channel(DMA1, DMA_CHANNEL1);
+
+  rcc_periph_clock_enable(RCC_TIM3);
+  timer_reset(TIM3);
+  timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+  timer_set_prescaler(TIM3, 0);
+  timer_set_period(TIM3, samplePeriod - 1);
+  timer_set_master_mode(TIM3, TIM_CR2_MMS_UPDATE);
+
+  /* Note the place in the PWM period as sampling starts. Timer 1 counts up
+  then down, so the period is twice the period register. */
+  cm_disable_interrupts();
+  uint32_t counter = timer_get_counter(TIM1);
+  bool down = (TIM_CR1(TIM1) & TIM_CR1_DIR_DOWN) != 0;
+  timer_enable_counter(TIM3);
+  cm_enable_interrupts();
+  uint32_t cycle = 2 * pwmPeriod;
+  if (down)
+    counter = cycle - counter;
+  *start = (counter + samplePeriod) % cycle;
+
+  uint32_t limit = (uint32_t)count * samplePeriod + ADC_SCAN_CYCLES;
+  wait = dwt_read_cycle_counter();
+  bool complete;
+  while (!(complete = dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) &&
+         (dwt_read_cycle_counter() - wait < limit))
+    ;
+  timer_disable_counter(TIM3);
+  dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+
+  /* Back to software started scans of all inputs */
+  uint8_t channelArray[NUM_CHANNEL];
+  uint8_t i;
+  for (i = 0; i < NUM_CHANNEL; i++)
+    channelArray[i] = i + 4;
+  adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_SWSTART);
+  adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_28DOT5CYC);
+  adc_enable_scan_mode(ADC1);
+  adc_set_regular_sequence(ADC1, NUM_CHANNEL, channelArray);
+  dmaAdcSetup();
+  adc_enable_eoc_interrupt(ADC1);
+  return complete;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief ADC Burst Start
+
+Switch the ADC from the scan just completed to continuous scans of all
+inputs at its full rate, transferred by DMA into the capture buffer until
+the window is filled. Called from the ADC ISR on a trigger.
+
+The registers are written directly, as the libopencm3 functions would be
+called in FLASH from here in RAM.
+*/
+
+RAMFUNC
+static void adcBurstStart(void) {
+  ADC_CR1(ADC1) &= ~ADC_CR1_EOCIE;
+  DMA_CCR(DMA1, DMA_CHANNEL1) &= ~DMA_CCR_EN;
+  DMA_CCR(DMA1, DMA_CHANNEL1) =
+      (DMA_CCR(DMA1, DMA_CHANNEL1) &
+       ~(DMA_CCR_MSIZE_MASK | DMA_CCR_PSIZE_MASK)) |
+      DMA_CCR_MSIZE_16BIT | DMA_CCR_PSIZE_16BIT;
+  DMA_CMAR(DMA1, DMA_CHANNEL1) = (uint32_t)acquisitionBurstBuffer();
+  DMA_CNDTR(DMA1, DMA_CHANNEL1) = acquisitionBurstScans() * NUM_CHANNEL;
+  DMA_IFCR(DMA1) = DMA_TCIF << DMA_FLAG_OFFSET(DMA_CHANNEL1);
+  DMA_CCR(DMA1, DMA_CHANNEL1) |= DMA_CCR_TCIE;
+  DMA_CCR(DMA1, DMA_CHANNEL1) |= DMA_CCR_EN;
+  ADC_CR2(ADC1) |= ADC_CR2_CONT;
+  ADC_CR2(ADC1) |= ADC_CR2_SWSTART;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief ADC Burst Restore
+
+After a burst the ADC finishes the scan in progress with no DMA to take it.
+Wait for that, then set up the DMA for base rate scans again and discard the
+end of conversion left by the extra scan.
+*/
+
+void adcBurstRestore(void) {
+  dwt_enable_cycle_counter();
+  uint32_t wait = dwt_read_cycle_counter();
+  while (dwt_read_cycle_counter() - wait < ADC_SCAN_CYCLES)
+    ;
+  dmaAdcSetup();
+  ADC_SR(ADC1) &= ~ADC_SR_EOC;
+  adc_enable_eoc_interrupt(ADC1);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Fixed point arithmetic cycle benchmark
+
+Time the control loop divisions with the hardware divider and with the
+reciprocal multiply, using the DWT cycle counter. The loop overhead is
+included in both figures.
+*/
+
+void cycleBenchmark(void) {
+  volatile int32_t result = 0;
+  int32_t i;
+  Reciprocal reciprocal;
+  volatile uint32_t divisor = GAIN_DIVISOR;
+  reciprocalInit(&reciprocal, divisor);
+  dwt_enable_cycle_counter();
+  uint32_t start = dwt_read_cycle_counter();
+  for (i = -BENCHMARK_COUNT / 2; i < BENCHMARK_COUNT / 2; i++)
+    result = (i * 1031) / (int32_t)divisor;
+  uint32_t divideCycles = dwt_read_cycle_counter() - start;
+  start = dwt_read_cycle_counter();
+  for (i = -BENCHMARK_COUNT / 2; i < BENCHMARK_COUNT / 2; i++)
+    result = reciprocalDivideSigned(&reciprocal, i * 1031);
+  uint32_t reciprocalCycles = dwt_read_cycle_counter() - start;
+  (void)result;
+  dataMessageSend("db", divideCycles, reciprocalCycles);
+}
+
 /*--------------------------------------------------------------------------*/
 /** @brief Timer 2 Setup
 
@@ -503,13 +873,74 @@ Respond to ADC EOC at end of scan and send data block.
 Print the result in decimal and separate with an ASCII dash.
 
 The EOC status is lost when DMA reads the data register, so use a global
-variable.
+variable. The scan is calibrated here so that the application only sees
+engineering units, and power and energy are accounted at the full rate.
+
+This runs from RAM along with the calibration and accounting it calls.
+
+While a capture is armed the scan is checked for a transient, and on finding
+one a full rate burst is started in place of the next base rate scan. The
+setpoint deviation is not checked in MPPT mode, where it is only a limit.
 */
 
+RAMFUNC
 void adc1_2_isr(void) {
+  uint32_t entry = latencyEnter(LATENCY_ADC);
   adceoc = 1;
-  /* Clear DMA to restart at beginning of data array */
-  dmaAdcSetup();
+  calibrateScan(v, measured);
+  energyAccumulate(measured[INPUT_VOLTAGE], measured[INPUT_CURRENT],
+                   measured[OUTPUT_VOLTAGE], measured[OUTPUT_CURRENT]);
+  int32_t setpoint = (controlGetMode() == CONTROL_MPPT) ? 0 : setValue;
+  if (acquisitionScan(v, measured, setpoint))
+    adcBurstStart();
+  else {
+    /* Reload the DMA count to restart at the beginning of the data array.
+    The addresses are kept from dmaAdcSetup. */
+    DMA_CCR(DMA1, DMA_CHANNEL1) &= ~DMA_CCR_EN;
+    DMA_CNDTR(DMA1, DMA_CHANNEL1) = NUM_CHANNEL;
+    DMA_CCR(DMA1, DMA_CHANNEL1) |= DMA_CCR_EN;
+  }
+  latencyExit(LATENCY_ADC, entry);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief DMA1 Channel 1 ISR
+
+The burst capture window is full. The ADC is stopped at the end of the scan
+in progress, and the last scan of the window is taken as the measurement
+until base rate scans resume.
+*/
+
+void dma1_channel1_isr(void) {
+  dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+  dma_disable_transfer_complete_interrupt(DMA1, DMA_CHANNEL1);
+  adc_set_single_conversion_mode(ADC1);
+  uint16_t *last = acquisitionBurstBuffer() +
+                   (acquisitionBurstScans() - 1) * NUM_CHANNEL;
+  uint8_t i;
+  for (i = 0; i < NUM_CHANNEL; i++)
+    v[i] = last[i];
+  calibrateScan(v, measured);
+  acquisitionBurstEnd();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief DMA1 Channel 5 ISR
+
+At the end of a waveform table either rearm the DMA with the other table,
+which must be done before the next update event, or stop playback.
+*/
+
+void dma1_channel5_isr(void) {
+  dma_clear_interrupt_flags(DMA1, DMA_CHANNEL5, DMA_TCIF);
+  uint8_t action = waveformTableEnd();
+  if (action == WAVEFORM_SWITCH) {
+    dma_disable_channel(DMA1, DMA_CHANNEL5);
+    dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t)waveformTable());
+    dma_set_number_of_data(DMA1, DMA_CHANNEL5, waveformTransfers());
+    dma_enable_channel(DMA1, DMA_CHANNEL5);
+  } else if (action == WAVEFORM_STOP)
+    timer1WaveformStop();
 }
 
 /*-----------------------------------------------------------*/
@@ -32,12 +32,31 @@ Initial 7 December 2015
 
 #define FIRMWARE_VERSION    "0.0"
 
-#define LINE_SIZE           80
-#define NUM_CHANNEL         2
+#define NUM_CHANNEL         4
 #define BAUDRATE            230400
 #define FREQUENCY           100
+/* Highest PWM frequency in kHz */
+#define PWM_FREQUENCY_MAX   1000
 #define DEADTIME            30
+#define GAIN_DIVISOR        50
+#define BENCHMARK_COUNT     1000
 #define DATA_BLOCK_SIZE     1024
+/* Timer 2 count at which each scan is due */
+#define SCAN_COMPARE        0x8FFF
+/* Processor cycles for a four channel ADC scan to end, 164 ADC clocks of 8 */
+#define ADC_SCAN_CYCLES     1400
+/* Processor cycles allowed for the last character to go before a rate
+change, two characters at 9600 baud */
+#define USART_DRAIN_CYCLES  150000
+
+/* Index of each measurement in the converted data array (ADC channels 4-7) */
+#define OUTPUT_VOLTAGE      0   /* PA4 Channel 2 */
+#define OUTPUT_CURRENT      1   /* PA5 Channel 1, the regulated value */
+#define INPUT_VOLTAGE       2   /* PA6 Channel 3 */
+#define INPUT_CURRENT       3   /* PA7 Channel 4 */
+
+/* Timer 1 period for each PWM frequency in kHz, from tables.c */
+extern const uint16_t pwmPeriodTable[PWM_FREQUENCY_MAX + 1];
 
 /*--------------------------------------------------------------------------*/
 /* Prototypes */
@@ -48,10 +67,20 @@ void adcSetup(void);
 void dmaAdcSetup(void);
 void gpioSetup(void);
 void usartSetup(void);
+void usartSetRate(uint32_t baud);
 void clockSetup(void);
-void timer1PWMsettings(uint16_t period, int16_t buckDutyCycle,
-                  int16_t boostDutyCycle);
-
-void parseCommand(uint8_t* line);
+void timer1PWMsettings(uint16_t pwmFrequency, int16_t buckDutyCycle,
+                       int16_t boostDutyCycle);
+void timer1SetSynchronous(bool enable);
+void timer1SetDeadtime(uint8_t deadtimeSetting);
+void timer1SetBurst(uint8_t offPeriods);
+bool timer1WaveformPlay(void);
+void timer1WaveformStop(void);
+uint32_t timer1Period(void);
+void adcBurstRestore(void);
+bool adcCaptureBlock(uint8_t channel, uint16_t* block, uint16_t count,
+                     uint16_t samplePeriod, uint32_t* start);
+int32_t power(int32_t voltage, int32_t current);
+void cycleBenchmark(void);
 
 #endif
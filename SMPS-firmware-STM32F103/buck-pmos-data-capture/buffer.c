@@ -13,6 +13,7 @@ Buffer tail points to the place behind the next item to be taken.
 */
 
 #include "buffer.h"
+#include "ramfunc.h"
 
 /*--------------------------------------------------------------------------*/
 /* Initialize the buffer to empty, defining the size */
@@ -26,6 +27,7 @@ void buffer_init(uint8_t buffer[], uint8_t size)
 /*--------------------------------------------------------------------------*/
 /* Get a byte from the buffer. Returns a byte in the lower 8 bits,
 or 0x100 if the buffer has no data. */
+RAMFUNC
 uint16_t buffer_get(uint8_t buffer[])
 {
     if ( buffer[1] == buffer[2] ) return 0x100;   	/* no data available */
@@ -0,0 +1,201 @@
+/* STM32F1 SMPS Measurement Calibration
+
+Raw 12 bit ADC counts are converted to engineering units (mV or mA) with a
+per channel gain, offset and optional second order term. The arithmetic is
+multiply and shift fixed point, so no floating point is needed per sample.
+
+The constants are held in RAM and can be written to the configuration block
+in FLASH (see .configSection in the linker script) from where they are
+loaded at reset. An erased or invalid block gives unity gain, so the
+measurements are then the raw counts.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "calibration.h"
+#include "fixmath.h"
+#include "flashprog.h"
+#include "ramfunc.h"
+
+/*--------------------------------------------------------------------------*/
+/* Calibration constants in use */
+static CalibrationBlock calibration;
+
+/* Calibration constants saved in FLASH. This occupies its own page, and is
+volatile as it is changed by FLASH programming. */
+__attribute__ ((section(".configBlock")))
+const volatile CalibrationBlock calibrationStore = { .key = 0 };
+
+/*--------------------------------------------------------------------------*/
+/** @brief Load the calibration constants
+
+The saved constants are used if valid, otherwise the defaults.
+*/
+
+void calibrationInit(void)
+{
+    if (calibrationStore.key != CALIBRATION_KEY)
+    {
+        calibrationDefaults();
+        return;
+    }
+    uint32_t* data = (uint32_t*)&calibration;
+    const volatile uint32_t* stored =
+        (const volatile uint32_t*)&calibrationStore;
+    uint16_t i;
+    for (i = 0; i < sizeof(CalibrationBlock)/4; i++) data[i] = stored[i];
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the calibration constants to unity gain and zero offset
+
+*/
+
+void calibrationDefaults(void)
+{
+    uint8_t i;
+    calibration.key = CALIBRATION_KEY;
+    for (i = 0; i < NUM_CHANNEL; i++)
+    {
+        calibration.gain[i] = CALIBRATION_UNITY;
+        calibration.offset[i] = 0;
+        calibration.quadratic[i] = 0;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Calibrate a complete scan
+
+Called from the ADC ISR at the end of each scan.
+
+@param[in] uint32_t raw[]: raw ADC counts for each channel.
+@param[out] int32_t value[]: calibrated values for each channel.
+*/
+
+RAMFUNC
+void calibrateScan(volatile uint32_t raw[], volatile int32_t value[])
+{
+    uint8_t i;
+    for (i = 0; i < NUM_CHANNEL; i++) value[i] = calibrate(i, raw[i]);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Calibrate a single measurement
+
+@param[in] uint8_t channel: index into the data array.
+@param[in] int32_t raw: raw ADC count.
+@returns int32_t: calibrated value in engineering units.
+*/
+
+RAMFUNC
+int32_t calibrate(uint8_t channel, int32_t raw)
+{
+    int64_t scaled = (int64_t)calibration.gain[channel]*raw;
+    if (calibration.quadratic[channel] != 0)
+        scaled += ((int64_t)calibration.quadratic[channel]*raw*raw) >> 16;
+    return addSaturate(calibration.offset[channel], saturate32(scaled >> 16));
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Get a channel calibration gain
+
+@param[in] uint8_t channel: index into the data array.
+@returns int32_t: Q16 gain.
+*/
+
+int32_t calibrationGetGain(uint8_t channel)
+{
+    return calibration.gain[channel];
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set channel calibration constants
+
+@param[in] uint8_t channel: index into the data array.
+@param[in] int32_t gain, offset, quadratic: see CalibrationBlock.
+*/
+
+void calibrationSetGain(uint8_t channel, int32_t gain)
+{
+    calibration.gain[channel] = gain;
+}
+
+void calibrationSetOffset(uint8_t channel, int32_t offset)
+{
+    calibration.offset[channel] = offset;
+}
+
+void calibrationSetQuadratic(uint8_t channel, int32_t quadratic)
+{
+    calibration.quadratic[channel] = quadratic;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Compute a linear calibration from two reference points
+
+The second order term is cleared.
+
+@param[in] uint8_t channel: index into the data array.
+@param[in] int32_t raw1, value1: raw count at the first reference.
+@param[in] int32_t raw2, value2: raw count at the second reference.
+@returns true if the points are far enough apart to be used.
+*/
+
+bool calibrationTwoPoint(uint8_t channel, int32_t raw1, int32_t value1,
+                         int32_t raw2, int32_t value2)
+{
+    if ((raw2 - raw1 < 16) && (raw1 - raw2 < 16)) return false;
+    int32_t gain = (int32_t)((((int64_t)(value2 - value1)) << 16)/
+                             (raw2 - raw1));
+    calibration.gain[channel] = gain;
+    calibration.quadratic[channel] = 0;
+    calibration.offset[channel] = value1 -
+                                  (int32_t)(((int64_t)gain*raw1) >> 16);
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write the calibration constants to FLASH
+
+The configuration page is erased and rewritten from RAM (see flashprog.c),
+so that the interrupts are still taken over the 20ms or so of the erase.
+
+@returns true if the FLASH contents verify.
+*/
+
+bool calibrationWrite(void)
+{
+    const volatile uint32_t* stored =
+        (const volatile uint32_t*)&calibrationStore;
+    uint32_t* data = (uint32_t*)&calibration;
+    uint16_t i;
+    flashErasePage(stored);
+    for (i = 0; i < sizeof(CalibrationBlock)/4; i++)
+        flashProgramWord(&stored[i], data[i]);
+    for (i = 0; i < sizeof(CalibrationBlock)/4; i++)
+        if (stored[i] != data[i]) return false;
+    return true;
+}
+
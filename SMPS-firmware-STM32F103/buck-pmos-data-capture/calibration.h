@@ -0,0 +1,63 @@
+/* STM32F1 SMPS Measurement Calibration
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CALIBRATION_H_
+#define CALIBRATION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buck-pmos-data-capture.h"
+
+/* Identifies a valid calibration block in FLASH */
+#define CALIBRATION_KEY     0x43414C31
+
+/* Gain of one in the Q16 fixed point gain */
+#define CALIBRATION_UNITY   65536
+
+/* Calibration constants. For each channel:
+value = offset + (gain*raw + (quadratic*raw*raw >> 16)) >> 16
+so that gain is in Q16 and quadratic in Q32 engineering units per count. */
+typedef struct {
+    uint32_t key;
+    int32_t gain[NUM_CHANNEL];
+    int32_t offset[NUM_CHANNEL];
+    int32_t quadratic[NUM_CHANNEL];
+} CalibrationBlock;
+
+void calibrationInit(void);
+void calibrateScan(volatile uint32_t raw[], volatile int32_t value[]);
+int32_t calibrate(uint8_t channel, int32_t raw);
+int32_t calibrationGetGain(uint8_t channel);
+void calibrationSetGain(uint8_t channel, int32_t gain);
+void calibrationSetOffset(uint8_t channel, int32_t offset);
+void calibrationSetQuadratic(uint8_t channel, int32_t quadratic);
+bool calibrationTwoPoint(uint8_t channel, int32_t raw1, int32_t value1,
+                         int32_t raw2, int32_t value2);
+void calibrationDefaults(void);
+bool calibrationWrite(void);
+
+#endif
+
@@ -0,0 +1,1303 @@
+/* STM32F1 SMPS Command Interpreter
+
+Commands are described by a table giving the two command letters, the type
+and valid range of the argument and the function that acts on it.
+
+An ASCII line may carry several commands separated by spaces, commas or
+semicolons. Each command is two letters with an optional argument that
+follows directly or as the next token, for example "pf100 pp 500;ac+".
+
+A binary frame carries a sequence of fixed size commands each made of the two
+command letters and a 32 bit argument, least significant byte first.
+
+All commands in a line or frame are validated before any is acted on, so
+that a host can change a complete operating point in one transaction. The PWM
+is updated once at the end.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "stringlib.h"
+#include "commslib.h"
+#include "commands.h"
+#include "control.h"
+#include "fixmath.h"
+#include "calibration.h"
+#include "deadtime.h"
+#include "mppt.h"
+#include "lightload.h"
+#include "energy.h"
+#include "autotune.h"
+#include "profile.h"
+#include "waveform.h"
+#include "brightness.h"
+#include "ramfunc.h"
+#include "latency.h"
+#include "spectrum.h"
+#include "acquisition.h"
+#include "deadline.h"
+#include "link.h"
+#include "store.h"
+#include "buck-pmos-data-capture.h"
+
+/*--------------------------------------------------------------------------*/
+/* Globals defined in the main program */
+extern uint8_t capture;
+extern uint16_t frequency;
+extern int16_t ch1DutyCycle;
+extern int16_t ch2DutyCycle;
+extern int32_t setValue;
+extern bool synchronous;
+extern uint8_t deadtime;
+extern uint32_t v[NUM_CHANNEL];
+
+/* Channel selected for calibration, and the low reference point */
+static uint8_t calibrationChannel;
+static int32_t calibrationLowRaw;
+static int32_t calibrationLowValue;
+
+/* Profile channel selected for keyframe upload, and the next keyframe time */
+static uint8_t profileChannel;
+static int32_t profileKeyTime;
+/* Brightness channel selected */
+static uint8_t brightnessChannel;
+/* Buck duty cycle of the next waveform entry */
+static int16_t waveformBuck;
+
+/* Samples of the input being analysed */
+static uint16_t spectrumSamples[SPECTRUM_BLOCK_SIZE];
+
+/* Set by actions that change the PWM, so that it is updated once per batch */
+static bool pwmChanged;
+
+/*--------------------------------------------------------------------------*/
+/* Command actions */
+
+static uint8_t actionCapture(int32_t argument);
+static uint8_t actionIdentify(int32_t argument);
+static uint8_t actionAutotune(int32_t argument);
+static uint8_t actionSpectrum(int32_t argument);
+static uint8_t parameterFrequency(int32_t argument);
+static uint8_t parameterDutyCycle1(int32_t argument);
+static uint8_t parameterDutyCycle2(int32_t argument);
+static uint8_t parameterSetpoint(int32_t argument);
+static uint8_t parameterGain(int32_t argument);
+static uint8_t parameterSchedule(int32_t argument);
+static uint8_t parameterFeedForward(int32_t argument);
+static uint8_t parameterControlMode(int32_t argument);
+static uint8_t parameterSynchronous(int32_t argument);
+static uint8_t parameterDeadtime(int32_t argument);
+static uint8_t actionDeadtimeOptimise(int32_t argument);
+static uint8_t parameterLedKnee(int32_t argument);
+static uint8_t parameterLedSlope(int32_t argument);
+static uint8_t parameterLightLoad(int32_t argument);
+static uint8_t parameterLightLoadFrequency(int32_t argument);
+static uint8_t calibrationSelect(int32_t argument);
+static uint8_t calibrationGain(int32_t argument);
+static uint8_t calibrationOffset(int32_t argument);
+static uint8_t calibrationQuadratic(int32_t argument);
+static uint8_t calibrationLow(int32_t argument);
+static uint8_t calibrationHigh(int32_t argument);
+static uint8_t calibrationSave(int32_t argument);
+static uint8_t calibrationReset(int32_t argument);
+static uint8_t trackerAlgorithm(int32_t argument);
+static uint8_t trackerStep(int32_t argument);
+static uint8_t trackerRate(int32_t argument);
+static uint8_t profileSelect(int32_t argument);
+static uint8_t profileErase(int32_t argument);
+static uint8_t profileKeyframeTime(int32_t argument);
+static uint8_t profileKeyframeValue(int32_t argument);
+static uint8_t profileInterpolation(int32_t argument);
+static uint8_t profileLoop(int32_t argument);
+static uint8_t profileStartChannels(int32_t argument);
+static uint8_t profileStopAll(int32_t argument);
+static uint8_t brightnessSelect(int32_t argument);
+static uint8_t brightnessCurve(int32_t argument);
+static uint8_t brightnessFullScale(int32_t argument);
+static uint8_t brightnessLevel(int32_t argument);
+static uint8_t waveformErase(int32_t argument);
+static uint8_t waveformEntryBuck(int32_t argument);
+static uint8_t waveformEntryBoost(int32_t argument);
+static uint8_t waveformRepetition(int32_t argument);
+static uint8_t waveformPlays(int32_t argument);
+static uint8_t waveformStart(int32_t argument);
+static uint8_t waveformHalt(int32_t argument);
+static uint8_t acquisitionInput(int32_t argument);
+static uint8_t acquisitionDerivative(int32_t argument);
+static uint8_t acquisitionDeviation(int32_t argument);
+static uint8_t acquisitionWindow(int32_t argument);
+static uint8_t acquisitionTrigger(int32_t argument);
+static uint8_t acquisitionRead(int32_t argument);
+static uint8_t deadlineLimit(int32_t argument);
+static uint8_t deadlineShed(int32_t argument);
+static uint8_t deadlineSafe(int32_t argument);
+static uint8_t deadlineNormal(int32_t argument);
+static uint8_t deadlineRead(int32_t argument);
+static uint8_t linkRatePropose(int32_t argument);
+static uint8_t linkTest(int32_t argument);
+static uint8_t linkRateConfirm(int32_t argument);
+static uint8_t linkStatus(int32_t argument);
+static uint8_t storeStatus(int32_t argument);
+static uint8_t storeClear(int32_t argument);
+static uint8_t dataRaw(int32_t argument);
+static uint8_t dataEnergy(int32_t argument);
+static uint8_t dataEnergyReset(int32_t argument);
+static uint8_t dataBenchmark(int32_t argument);
+static uint8_t dataLatency(int32_t argument);
+
+static const CommandEntry commandTable[] = {
+/* Start capture 'ac+' stop capture 'ac-' */
+    {'a', 'c', ARGUMENT_SWITCH, 0, 1, actionCapture},
+/* Start a dead time sweep */
+    {'a', 'd', ARGUMENT_NONE, 0, 0, actionDeadtimeOptimise},
+/* Send ident response */
+    {'a', 'i', ARGUMENT_NONE, 0, 0, actionIdentify},
+/* Relay auto-tune of the regulator */
+    {'a', 't', ARGUMENT_NONE, 0, 0, actionAutotune},
+/* Switching ripple spectrum of an ADC input */
+    {'a', 's', ARGUMENT_INTEGER, 4, 3 + NUM_CHANNEL, actionSpectrum},
+/* PWM frequency in kHz */
+    {'p', 'f', ARGUMENT_INTEGER, 1, 999, parameterFrequency},
+/* Channel 1 (buck) and channel 2 (boost) PWM duty cycle in promille */
+    {'p', 'p', ARGUMENT_INTEGER, 0, 1000, parameterDutyCycle1},
+    {'p', 'q', ARGUMENT_INTEGER, 0, 1000, parameterDutyCycle2},
+/* Channel 1 setpoint in mV or mA */
+    {'p', 's', ARGUMENT_INTEGER, 0, 65535, parameterSetpoint},
+/* Regulator gain as a divisor of the error */
+    {'p', 'g', ARGUMENT_INTEGER, 1, 1000, parameterGain},
+/* Gain scheduling of tuned gains on 'ph+' off 'ph-' */
+    {'p', 'h', ARGUMENT_SWITCH, 0, 1, parameterSchedule},
+/* Control mode, buck, buck-boost or MPPT */
+    {'p', 'm', ARGUMENT_INTEGER, CONTROL_BUCK, CONTROL_MPPT,
+        parameterControlMode},
+/* Synchronous rectification on 'pn+' or off 'pn-', and dead time */
+    {'p', 'n', ARGUMENT_SWITCH, 0, 1, parameterSynchronous},
+    {'p', 'd', ARGUMENT_INTEGER, DEADTIME_MIN, 255, parameterDeadtime},
+/* Feed-forward mode, LED model knee voltage and slope per 1000 current */
+    {'p', 'e', ARGUMENT_INTEGER, FEEDFORWARD_OFF, FEEDFORWARD_LED,
+        parameterFeedForward},
+    {'p', 'k', ARGUMENT_INTEGER, 0, 65535, parameterLedKnee},
+    {'p', 'l', ARGUMENT_INTEGER, 0, 100000, parameterLedSlope},
+/* Light load threshold in mA, zero disables, and lowest frequency in kHz */
+    {'p', 't', ARGUMENT_INTEGER, 0, 65535, parameterLightLoad},
+    {'p', 'v', ARGUMENT_INTEGER, 1, 999, parameterLightLoadFrequency},
+/* Calibration of the selected ADC input */
+    {'c', 'c', ARGUMENT_INTEGER, 4, 3 + NUM_CHANNEL, calibrationSelect},
+    {'c', 'g', ARGUMENT_INTEGER, -0x1000000, 0x1000000, calibrationGain},
+    {'c', 'o', ARGUMENT_INTEGER, -65535, 65535, calibrationOffset},
+    {'c', 'q', ARGUMENT_INTEGER, -0x1000000, 0x1000000, calibrationQuadratic},
+    {'c', 'l', ARGUMENT_INTEGER, -65535, 65535, calibrationLow},
+    {'c', 'h', ARGUMENT_INTEGER, -65535, 65535, calibrationHigh},
+    {'c', 'w', ARGUMENT_NONE, 0, 0, calibrationSave},
+    {'c', 'd', ARGUMENT_NONE, 0, 0, calibrationReset},
+/* Maximum power point tracking algorithm, step and interval */
+    {'m', 'a', ARGUMENT_INTEGER, MPPT_PERTURB_OBSERVE,
+        MPPT_INCREMENTAL_CONDUCTANCE, trackerAlgorithm},
+    {'m', 's', ARGUMENT_INTEGER, 1, 100, trackerStep},
+    {'m', 'r', ARGUMENT_INTEGER, 1, MPPT_RATE_MAX, trackerRate},
+/* Setpoint profiles. Select a channel, clear it, then give keyframe times
+and values in turn. */
+    {'q', 'c', ARGUMENT_INTEGER, 0, PROFILE_CHANNELS - 1, profileSelect},
+    {'q', 'z', ARGUMENT_NONE, 0, 0, profileErase},
+    {'q', 't', ARGUMENT_INTEGER, 0, PROFILE_TIME_MAX, profileKeyframeTime},
+    {'q', 'v', ARGUMENT_INTEGER, 0, 65535, profileKeyframeValue},
+    {'q', 'i', ARGUMENT_INTEGER, PROFILE_STEP, PROFILE_EASED,
+                profileInterpolation},
+    {'q', 'l', ARGUMENT_SWITCH, 0, 1, profileLoop},
+/* Start channels in a bit mask together, stop all */
+    {'q', 's', ARGUMENT_INTEGER, 1, (1 << PROFILE_CHANNELS) - 1,
+                profileStartChannels},
+    {'q', 'x', ARGUMENT_NONE, 0, 0, profileStopAll},
+/* Perceptual brightness. Select a channel, set its curve and full scale,
+then give levels. */
+    {'b', 'c', ARGUMENT_INTEGER, 0, BRIGHTNESS_CHANNELS - 1, brightnessSelect},
+    {'b', 'k', ARGUMENT_INTEGER, BRIGHTNESS_LINEAR, BRIGHTNESS_CURVES - 1,
+                brightnessCurve},
+    {'b', 'f', ARGUMENT_INTEGER, 0, 65535, brightnessFullScale},
+    {'b', 'l', ARGUMENT_INTEGER, 0, 65535, brightnessLevel},
+/* PWM waveform tables. Clear the upload table, then give buck and boost
+duty cycles of each entry in turn. */
+    {'w', 'z', ARGUMENT_NONE, 0, 0, waveformErase},
+    {'w', 'a', ARGUMENT_INTEGER, 0, 1000, waveformEntryBuck},
+    {'w', 'b', ARGUMENT_INTEGER, 0, 1000, waveformEntryBoost},
+    {'w', 'r', ARGUMENT_INTEGER, 1, WAVEFORM_REPEAT_MAX, waveformRepetition},
+    {'w', 'n', ARGUMENT_INTEGER, 0, 65535, waveformPlays},
+/* Play or switch to the upload table, stop */
+    {'w', 'p', ARGUMENT_NONE, 0, 0, waveformStart},
+    {'w', 'x', ARGUMENT_NONE, 0, 0, waveformHalt},
+/* Triggered capture. Select the input watched, set the change and setpoint
+deviation that trigger and the full rate window, then arm. */
+    {'r', 'c', ARGUMENT_INTEGER, 4, 3 + NUM_CHANNEL, acquisitionInput},
+    {'r', 'd', ARGUMENT_INTEGER, 0, 65535, acquisitionDerivative},
+    {'r', 's', ARGUMENT_INTEGER, 0, 65535, acquisitionDeviation},
+    {'r', 'w', ARGUMENT_INTEGER, 1, ACQUISITION_WINDOW_MAX, acquisitionWindow},
+    {'r', 'a', ARGUMENT_SWITCH, 0, 1, acquisitionTrigger},
+/* Send the capture held */
+    {'r', 'r', ARGUMENT_NONE, 0, 0, acquisitionRead},
+/* Regulator deadline in us, and the consecutive misses that shed telemetry
+or hold the PWM off */
+    {'j', 'd', ARGUMENT_INTEGER, 1, 900, deadlineLimit},
+    {'j', 's', ARGUMENT_INTEGER, 0, 255, deadlineShed},
+    {'j', 'f', ARGUMENT_INTEGER, 0, 255, deadlineSafe},
+/* Return to normal, send the records and restart them */
+    {'j', 'x', ARGUMENT_NONE, 0, 0, deadlineNormal},
+    {'j', 'r', ARGUMENT_NONE, 0, 0, deadlineRead},
+/* Serial link rate. Propose, send the test pattern from a seed, confirm, and
+the rate and receive errors */
+    {'u', 'b', ARGUMENT_INTEGER, LINK_RATE_MIN, LINK_RATE_MAX, linkRatePropose},
+    {'u', 't', ARGUMENT_INTEGER, 0, 65535, linkTest},
+    {'u', 'c', ARGUMENT_NONE, 0, 0, linkRateConfirm},
+    {'u', 'l', ARGUMENT_NONE, 0, 0, linkStatus},
+/* Parameter store. Free records and changes not yet written, and removal
+of all saved parameters */
+    {'k', 's', ARGUMENT_NONE, 0, 0, storeStatus},
+    {'k', 'z', ARGUMENT_NONE, 0, 0, storeClear},
+/* Raw ADC counts */
+    {'d', 'r', ARGUMENT_NONE, 0, 0, dataRaw},
+/* Energy accounting readout and restart */
+    {'d', 'p', ARGUMENT_NONE, 0, 0, dataEnergy},
+    {'d', 'z', ARGUMENT_NONE, 0, 0, dataEnergyReset},
+/* Fixed point arithmetic cycle benchmark */
+    {'d', 'b', ARGUMENT_NONE, 0, 0, dataBenchmark},
+/* ISR latency and execution times */
+    {'d', 'l', ARGUMENT_NONE, 0, 0, dataLatency},
+};
+
+#define NUM_COMMANDS (sizeof(commandTable)/sizeof(CommandEntry))
+
+/* A validated command waiting to be acted on */
+typedef struct {
+    const CommandEntry* entry;
+    int32_t argument;
+} BatchEntry;
+
+static const CommandEntry* findCommand(char group, char command);
+static bool restoreGet(uint8_t key, char group, char command,
+                       int32_t* value);
+static void restoreTuning(uint8_t point);
+static bool parseInteger(char* text, int32_t* value);
+static uint8_t parseAscii(CommandRecord* command, BatchEntry* batch,
+                          uint8_t* batchSize);
+static uint8_t parseBinary(CommandRecord* command, BatchEntry* batch,
+                           uint8_t* batchSize);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Parse a command line or frame and act on it.
+
+Commands begin with a lower case group letter a, b, c, d, j, k, m, p, q, r,
+u or w followed by a lower case command letter.
+
+If any command is not recognised or has an invalid argument, none of the
+commands are acted on. If a command is refused in the present state, those
+following it in the batch are not acted on.
+
+@param[in] CommandRecord *command: the tokenised command line or binary frame
+@returns uint8_t: COMMAND_OK if actioned, COMMAND_INVALID if not valid, or
+COMMAND_REJECTED if a command was refused.
+*/
+
+uint8_t parseCommand(CommandRecord* command)
+{
+    BatchEntry batch[MAX_BATCH];
+    uint8_t batchSize = 0;
+    uint8_t status;
+    if (command->format == COMMAND_BINARY)
+        status = parseBinary(command, batch, &batchSize);
+    else status = parseAscii(command, batch, &batchSize);
+    if ((status != COMMAND_OK) || (batchSize == 0)) return COMMAND_INVALID;
+
+    pwmChanged = false;
+    uint8_t i;
+    for (i = 0; (i < batchSize) && (status == COMMAND_OK); i++)
+        status = batch[i].entry->action(batch[i].argument);
+    if (pwmChanged)
+        timer1PWMsettings(lightLoadFrequency(frequency), ch1DutyCycle,
+                          ch2DutyCycle);
+    return status;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Apply the saved parameters
+
+Called once at startup, after the defaults are set and before capture can
+start. Each parameter is checked against the limits of its command, and
+applied as by the command but without a response. The gain divisor discards
+tuned gains, so the tunes of each schedule point are applied after it, the
+last tune last so that its gains are used.
+*/
+
+void commandsRestore(void)
+{
+    int32_t value;
+    if (restoreGet(STORE_FREQUENCY, 'p', 'f', &value)) frequency = value;
+    if (restoreGet(STORE_DUTY_CYCLE_1, 'p', 'p', &value))
+        ch1DutyCycle = value;
+    if (restoreGet(STORE_DUTY_CYCLE_2, 'p', 'q', &value))
+        ch2DutyCycle = value;
+    if (restoreGet(STORE_SETPOINT, 'p', 's', &value)) setValue = value;
+    if (restoreGet(STORE_CONTROL_MODE, 'p', 'm', &value))
+        controlSetMode(value);
+    if (restoreGet(STORE_LED_KNEE, 'p', 'k', &value))
+        controlSetLedKnee(value);
+    if (restoreGet(STORE_LED_SLOPE, 'p', 'l', &value))
+        controlSetLedSlope(value);
+    if (restoreGet(STORE_FEEDFORWARD, 'p', 'e', &value))
+        controlSetFeedForward(value);
+    if (restoreGet(STORE_SCHEDULE, 'p', 'h', &value))
+        controlSetSchedule(value != 0);
+    if (restoreGet(STORE_GAIN_DIVISOR, 'p', 'g', &value))
+        controlSetGain(value);
+    int32_t last = SCHEDULE_POINTS;
+    storeGet(STORE_TUNE_LAST, &last);
+    uint8_t point;
+    for (point = 0; point < SCHEDULE_POINTS; point++)
+        if (point != last) restoreTuning(point);
+    if ((last >= 0) && (last < SCHEDULE_POINTS)) restoreTuning(last);
+    if (restoreGet(STORE_SYNCHRONOUS, 'p', 'n', &value))
+    {
+        synchronous = (value != 0);
+        timer1SetSynchronous(synchronous);
+    }
+    if (restoreGet(STORE_DEADTIME, 'p', 'd', &value))
+    {
+        deadtime = value;
+        timer1SetDeadtime(deadtime);
+    }
+    if (restoreGet(STORE_LIGHTLOAD, 'p', 't', &value))
+        lightLoadSetThreshold(value);
+    if (restoreGet(STORE_LIGHTLOAD_FREQUENCY, 'p', 'v', &value))
+        lightLoadSetMinimumFrequency(value);
+    if (restoreGet(STORE_MPPT_ALGORITHM, 'm', 'a', &value))
+        mpptSetAlgorithm(value);
+    if (restoreGet(STORE_MPPT_STEP, 'm', 's', &value)) mpptSetStep(value);
+    if (restoreGet(STORE_MPPT_RATE, 'm', 'r', &value)) mpptSetRate(value);
+    uint8_t channel;
+    for (channel = 0; channel < BRIGHTNESS_CHANNELS; channel++)
+    {
+        if (restoreGet(STORE_BRIGHTNESS_CURVE(channel), 'b', 'k', &value))
+            brightnessSetCurve(channel, value);
+        if (restoreGet(STORE_BRIGHTNESS_SCALE(channel), 'b', 'f', &value))
+            brightnessSetFullScale(channel, value);
+    }
+    timer1PWMsettings(lightLoadFrequency(frequency), ch1DutyCycle,
+                      ch2DutyCycle);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Look up a saved parameter and check it as its command would
+
+A value outside the limits of the command, as saved by firmware with other
+limits, is not used and the default stays.
+
+@param[in] uint8_t key: store key.
+@param[in] char group, command: letters of the command setting it.
+@param[out] int32_t* value: value, unchanged if not used.
+@returns bool: true if the key has a value within the limits.
+*/
+
+static bool restoreGet(uint8_t key, char group, char command, int32_t* value)
+{
+    int32_t saved;
+    if (! storeGet(key, &saved)) return false;
+    const CommandEntry* entry = findCommand(group, command);
+    if ((entry == NULL) || (saved < entry->minimum) ||
+        (saved > entry->maximum)) return false;
+    *value = saved;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Apply the saved tune of a schedule point, if any
+
+@param[in] uint8_t point: schedule point.
+*/
+
+static void restoreTuning(uint8_t point)
+{
+    int32_t dutyCycle, proportional, integral;
+    if (storeGet(STORE_TUNE_DUTY(point), &dutyCycle) &&
+        storeGet(STORE_TUNE_PROPORTIONAL(point), &proportional) &&
+        storeGet(STORE_TUNE_INTEGRAL(point), &integral))
+        controlSetTuning(dutyCycle, proportional, integral);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Save the gains of an auto-tune
+
+They are kept for the schedule point nearest the duty cycle of the tune, as
+in the regulator.
+
+@param[in] int16_t dutyCycle: buck duty cycle of the tune in promille.
+@param[in] int32_t proportional: Q16 promille per unit error.
+@param[in] int32_t integral: Q16 promille per unit error per period.
+*/
+
+void commandsSaveTuning(int16_t dutyCycle, int32_t proportional,
+                        int32_t integral)
+{
+    uint8_t point = clamp(dutyCycle*SCHEDULE_POINTS/1000, 0,
+                          SCHEDULE_POINTS - 1);
+    storeSet(STORE_TUNE_DUTY(point), dutyCycle);
+    storeSet(STORE_TUNE_PROPORTIONAL(point), proportional);
+    storeSet(STORE_TUNE_INTEGRAL(point), integral);
+    storeSet(STORE_TUNE_LAST, point);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Parse and validate the commands in an ASCII line
+
+@param[in] CommandRecord *command: the tokenised command line.
+@param[out] BatchEntry *batch: validated commands.
+@param[out] uint8_t *batchSize: number of validated commands.
+@returns uint8_t: COMMAND_OK if all commands are valid.
+*/
+
+static uint8_t parseAscii(CommandRecord* command, BatchEntry* batch,
+                          uint8_t* batchSize)
+{
+    uint8_t tokenIndex = 0;
+    while (tokenIndex < command->numTokens)
+    {
+        char* token = (char*)command->line + command->token[tokenIndex++];
+        if (*batchSize >= MAX_BATCH) return COMMAND_INVALID;
+        const CommandEntry* entry = findCommand(token[0], token[1]);
+        if (entry == NULL) return COMMAND_INVALID;
+        char* argumentText = token + 2;
+        int32_t argument = 0;
+        if ((entry->argumentType != ARGUMENT_NONE) && (*argumentText == 0))
+        {
+            if (tokenIndex >= command->numTokens) return COMMAND_INVALID;
+            argumentText = (char*)command->line +
+                            command->token[tokenIndex++];
+        }
+        if (entry->argumentType == ARGUMENT_SWITCH)
+        {
+            if ((argumentText[0] != '+') && (argumentText[0] != '-'))
+                return COMMAND_INVALID;
+            if (argumentText[1] != 0) return COMMAND_INVALID;
+            argument = (argumentText[0] == '+');
+        }
+        else if (entry->argumentType == ARGUMENT_INTEGER)
+        {
+            if (! parseInteger(argumentText, &argument)) return COMMAND_INVALID;
+            if ((argument < entry->minimum) || (argument > entry->maximum))
+                return COMMAND_INVALID;
+        }
+        else if (*argumentText != 0) return COMMAND_INVALID;
+        batch[*batchSize].entry = entry;
+        batch[*batchSize].argument = argument;
+        (*batchSize)++;
+    }
+    return COMMAND_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Parse and validate the commands in a binary frame
+
+@param[in] CommandRecord *command: the binary frame.
+@param[out] BatchEntry *batch: validated commands.
+@param[out] uint8_t *batchSize: number of validated commands.
+@returns uint8_t: COMMAND_OK if all commands are valid.
+*/
+
+static uint8_t parseBinary(CommandRecord* command, BatchEntry* batch,
+                           uint8_t* batchSize)
+{
+    if ((command->length % BINARY_COMMAND_SIZE) != 0) return COMMAND_INVALID;
+    uint8_t index;
+    for (index = 0; index < command->length; index += BINARY_COMMAND_SIZE)
+    {
+        uint8_t* field = command->line + index;
+        if (*batchSize >= MAX_BATCH) return COMMAND_INVALID;
+        const CommandEntry* entry = findCommand(field[0], field[1]);
+        if (entry == NULL) return COMMAND_INVALID;
+        int32_t argument = (int32_t)((uint32_t)field[2] |
+                                     ((uint32_t)field[3] << 8) |
+                                     ((uint32_t)field[4] << 16) |
+                                     ((uint32_t)field[5] << 24));
+        if (entry->argumentType == ARGUMENT_SWITCH)
+        {
+            if ((argument != 0) && (argument != 1)) return COMMAND_INVALID;
+        }
+        else if (entry->argumentType == ARGUMENT_INTEGER)
+        {
+            if ((argument < entry->minimum) || (argument > entry->maximum))
+                return COMMAND_INVALID;
+        }
+        batch[*batchSize].entry = entry;
+        batch[*batchSize].argument = argument;
+        (*batchSize)++;
+    }
+    return COMMAND_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Find a command in the table
+
+@param[in] char group: first command letter.
+@param[in] char command: second command letter.
+@returns CommandEntry*: table entry or NULL if not recognised.
+*/
+
+static const CommandEntry* findCommand(char group, char command)
+{
+    uint8_t i;
+    for (i = 0; i < NUM_COMMANDS; i++)
+    {
+        if ((commandTable[i].group == group) &&
+            (commandTable[i].command == command))
+            return &commandTable[i];
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Convert a signed ASCII decimal string to an integer
+
+Unlike asciiToInt the whole string must be numeric.
+
+@param[in] char* text: string to convert.
+@param[out] int32_t* value: converted value.
+@returns true if the string is a valid 32 bit integer.
+*/
+
+static bool parseInteger(char* text, int32_t* value)
+{
+    bool negative = (*text == '-');
+    if (negative) text++;
+    if (*text == 0) return false;
+    int32_t number = 0;
+    while (*text != 0)
+    {
+        if ((*text < '0') || (*text > '9')) return false;
+        if (number > (INT32_MAX - (*text - '0'))/10) return false;
+        number = number*10 + (*text - '0');
+        text++;
+    }
+    *value = negative ? -number : number;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Actions. These are only called with validated arguments. */
+
+static uint8_t actionCapture(int32_t argument)
+{
+    capture = (argument != 0);
+    deadlineRestart();
+    return COMMAND_OK;
+}
+
+static uint8_t actionIdentify(int32_t argument)
+{
+    (void)argument;
+    commsPrintString("\nEntropia e.V. LED control\n");
+    return COMMAND_OK;
+}
+
+static uint8_t parameterFrequency(int32_t argument)
+{
+    frequency = argument;
+    pwmChanged = true;
+    storeSet(STORE_FREQUENCY, frequency);
+    sendResponse("Changing PWM frequncy interval to (kHz): ", frequency);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterDutyCycle1(int32_t argument)
+{
+    ch1DutyCycle = argument;
+    pwmChanged = true;
+    storeSet(STORE_DUTY_CYCLE_1, ch1DutyCycle);
+    sendResponse("Changeing Channel 1 PWM duty cycle to: ", ch1DutyCycle);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterDutyCycle2(int32_t argument)
+{
+    ch2DutyCycle = argument;
+    pwmChanged = true;
+    storeSet(STORE_DUTY_CYCLE_2, ch2DutyCycle);
+    sendResponse("Changeing Channel 2 PWM duty cycle to: ", ch2DutyCycle);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterSetpoint(int32_t argument)
+{
+    setValue = argument;
+    storeSet(STORE_SETPOINT, setValue);
+    sendResponse("Changeing setpoint of Channel 1 to: ", setValue);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterGain(int32_t argument)
+{
+    if (autotuneRunning()) autotuneStop();
+    controlSetGain(argument);
+    storeSet(STORE_GAIN_DIVISOR, argument);
+    storeRemove(STORE_TUNE_LAST);
+    uint8_t point;
+    for (point = 0; point < SCHEDULE_POINTS; point++)
+    {
+        storeRemove(STORE_TUNE_DUTY(point));
+        storeRemove(STORE_TUNE_PROPORTIONAL(point));
+        storeRemove(STORE_TUNE_INTEGRAL(point));
+    }
+    sendResponse("Changeing regulator gain divisor to: ", argument);
+    return COMMAND_OK;
+}
+
+/* Leaving buck-boost mode turns the boost switch off. A tune is abandoned
+as it only identifies the buck regulator. */
+static uint8_t parameterControlMode(int32_t argument)
+{
+    if (autotuneRunning()) autotuneStop();
+    controlSetMode(argument);
+    storeSet(STORE_CONTROL_MODE, argument);
+    if (argument == CONTROL_BUCK)
+    {
+        ch2DutyCycle = 0;
+        pwmChanged = true;
+        storeSet(STORE_DUTY_CYCLE_2, ch2DutyCycle);
+    }
+    sendResponse("Changeing control mode to: ", argument);
+    return COMMAND_OK;
+}
+
+/* Turning synchronous mode off abandons a dead time sweep. */
+static uint8_t parameterSynchronous(int32_t argument)
+{
+    synchronous = (argument != 0);
+    if (! synchronous && deadtimeOptimiserRunning())
+    {
+        deadtimeOptimiserStop();
+        timer1SetDeadtime(deadtime);
+    }
+/* Skipped periods would leave the low side switch on until the next
+regulator update ends the burst. */
+    if (synchronous) timer1SetBurst(0);
+    timer1SetSynchronous(synchronous);
+    storeSet(STORE_SYNCHRONOUS, synchronous);
+    sendResponse("Changeing synchronous mode to: ", synchronous);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterDeadtime(int32_t argument)
+{
+    if (deadtimeOptimiserRunning()) deadtimeOptimiserStop();
+    deadtime = argument;
+    timer1SetDeadtime(deadtime);
+    storeSet(STORE_DEADTIME, deadtime);
+    sendResponse("Changeing dead time to: ", deadtime);
+    return COMMAND_OK;
+}
+
+/* The tune needs the buck regulator running near the setpoint. */
+static uint8_t actionAutotune(int32_t argument)
+{
+    (void)argument;
+    if ((controlGetMode() != CONTROL_BUCK) || ! capture || (setValue <= 0))
+    {
+        sendString("Autotune", "needs buck mode, capture and a setpoint");
+        return COMMAND_REJECTED;
+    }
+    autotuneStart(ch1DutyCycle);
+    sendString("Autotune", "started");
+    return COMMAND_OK;
+}
+
+/* The sweep needs the regulator running in synchronous mode. */
+static uint8_t actionDeadtimeOptimise(int32_t argument)
+{
+    (void)argument;
+    if (! synchronous || ! capture)
+    {
+        sendString("Dead time", "needs synchronous mode and capture");
+        return COMMAND_REJECTED;
+    }
+    deadtimeOptimiserStart(deadtime);
+    sendString("Dead time", "sweep started");
+    return COMMAND_OK;
+}
+
+/* The ripple only repeats every PWM period while all periods are switched.
+PWM changes earlier in the batch are made first. Amplitudes are scaled to uV
+or uA by the calibration gain. */
+static uint8_t actionSpectrum(int32_t argument)
+{
+    if (waveformRunning() || (lightLoadBurstOff() != 0))
+    {
+        sendString("Spectrum", "needs continuous switching");
+        return COMMAND_REJECTED;
+    }
+    uint8_t acquisition = acquisitionState();
+    if ((acquisition == ACQUISITION_BURST) ||
+        (acquisition == ACQUISITION_DRAIN))
+    {
+        sendString("Spectrum", "burst capture running");
+        return COMMAND_REJECTED;
+    }
+    if (pwmChanged)
+    {
+        timer1PWMsettings(lightLoadFrequency(frequency), ch1DutyCycle,
+                          ch2DutyCycle);
+        pwmChanged = false;
+    }
+    uint8_t channel = argument - 4;
+    SpectrumPlan plan;
+    spectrumPlan(2*timer1Period(), &plan);
+    uint32_t start;
+    if (! adcCaptureBlock(argument, spectrumSamples, plan.count,
+                          plan.samplePeriod, &start))
+    {
+        sendString("Spectrum", "capture failed");
+        return COMMAND_REJECTED;
+    }
+    dataMessageSend("sf", SPECTRUM_TIMER_CLOCK/plan.cycle, plan.points);
+    int32_t gain = calibrationGetGain(channel);
+    uint32_t inverted = 0;
+    if (gain < 0)
+    {
+        gain = -gain;
+        inverted = 0x80000000;
+    }
+    char ident[3] = "s0";
+    uint8_t harmonic;
+    for (harmonic = 1; harmonic <= spectrumHarmonics(&plan); harmonic++)
+    {
+        SpectrumBin bin;
+        spectrumBin(spectrumSamples, &plan, start, harmonic, &bin);
+        int32_t amplitude = (int32_t)(((uint64_t)bin.amplitude*gain*1000) >>
+                                      24);
+        int32_t phase = (int32_t)(((uint64_t)(bin.phase + inverted)*3600) >>
+                                  32);
+        ident[1] = '0' + harmonic;
+        dataMessageSend(ident, amplitude, phase);
+    }
+    return COMMAND_OK;
+}
+
+static uint8_t parameterSchedule(int32_t argument)
+{
+    controlSetSchedule(argument != 0);
+    storeSet(STORE_SCHEDULE, argument);
+    sendResponse("Changeing gain scheduling to: ", argument);
+    return COMMAND_OK;
+}
+
+/* The LED model needs its knee and slope first. */
+static uint8_t parameterFeedForward(int32_t argument)
+{
+    if (! controlSetFeedForward(argument))
+    {
+        sendString("Feed-forward", "needs pk and pl set first");
+        return COMMAND_REJECTED;
+    }
+    storeSet(STORE_FEEDFORWARD, argument);
+    sendResponse("Changeing feed-forward mode to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterLedKnee(int32_t argument)
+{
+    controlSetLedKnee(argument);
+    storeSet(STORE_LED_KNEE, argument);
+    sendResponse("Changeing LED knee voltage to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterLedSlope(int32_t argument)
+{
+    controlSetLedSlope(argument);
+    storeSet(STORE_LED_SLOPE, argument);
+    sendResponse("Changeing LED slope to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterLightLoad(int32_t argument)
+{
+    lightLoadSetThreshold(argument);
+    storeSet(STORE_LIGHTLOAD, argument);
+    sendResponse("Changeing light load threshold to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t parameterLightLoadFrequency(int32_t argument)
+{
+    lightLoadSetMinimumFrequency(argument);
+    storeSet(STORE_LIGHTLOAD_FREQUENCY, argument);
+    sendResponse("Changeing light load frequency to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t calibrationSelect(int32_t argument)
+{
+    calibrationChannel = argument - 4;
+    calibrationLowRaw = -1;
+    sendResponse("Calibrating ADC input: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t calibrationGain(int32_t argument)
+{
+    calibrationSetGain(calibrationChannel, argument);
+    sendResponse("Calibration gain: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t calibrationOffset(int32_t argument)
+{
+    calibrationSetOffset(calibrationChannel, argument);
+    sendResponse("Calibration offset: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t calibrationQuadratic(int32_t argument)
+{
+    calibrationSetQuadratic(calibrationChannel, argument);
+    sendResponse("Calibration quadratic: ", argument);
+    return COMMAND_OK;
+}
+
+/* The low reference is remembered until the high reference is given. */
+static uint8_t calibrationLow(int32_t argument)
+{
+    calibrationLowRaw = v[calibrationChannel];
+    calibrationLowValue = argument;
+    sendResponse("Calibration low raw: ", calibrationLowRaw);
+    return COMMAND_OK;
+}
+
+static uint8_t calibrationHigh(int32_t argument)
+{
+    int32_t raw = v[calibrationChannel];
+    sendResponse("Calibration high raw: ", raw);
+    if ((calibrationLowRaw < 0) ||
+        ! calibrationTwoPoint(calibrationChannel, calibrationLowRaw,
+                              calibrationLowValue, raw, argument))
+    {
+        sendString("Calibration", "failed");
+        return COMMAND_REJECTED;
+    }
+    calibrationLowRaw = -1;
+    sendResponse("Calibration gain: ", calibrationGetGain(calibrationChannel));
+    return COMMAND_OK;
+}
+
+static uint8_t calibrationSave(int32_t argument)
+{
+    (void)argument;
+    if (! calibrationWrite())
+    {
+        sendString("Calibration", "failed");
+        return COMMAND_REJECTED;
+    }
+    sendString("Calibration", "saved");
+    return COMMAND_OK;
+}
+
+static uint8_t calibrationReset(int32_t argument)
+{
+    (void)argument;
+    calibrationDefaults();
+    sendString("Calibration", "defaults");
+    return COMMAND_OK;
+}
+
+static uint8_t trackerAlgorithm(int32_t argument)
+{
+    mpptSetAlgorithm(argument);
+    storeSet(STORE_MPPT_ALGORITHM, argument);
+    sendResponse("Changeing MPPT algorithm to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t trackerStep(int32_t argument)
+{
+    mpptSetStep(argument);
+    storeSet(STORE_MPPT_STEP, argument);
+    sendResponse("Changeing MPPT step to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t trackerRate(int32_t argument)
+{
+    mpptSetRate(argument);
+    storeSet(STORE_MPPT_RATE, argument);
+    sendResponse("Changeing MPPT interval to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t profileSelect(int32_t argument)
+{
+    profileChannel = argument;
+    sendResponse("Profile channel: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t profileErase(int32_t argument)
+{
+    (void)argument;
+    profileClear(profileChannel);
+    sendString("Profile", "cleared");
+    return COMMAND_OK;
+}
+
+static uint8_t profileKeyframeTime(int32_t argument)
+{
+    profileKeyTime = argument;
+    return COMMAND_OK;
+}
+
+/* Keyframes are acknowledged only on failure, to keep uploads short. */
+static uint8_t profileKeyframeValue(int32_t argument)
+{
+    if (! profileAddKeyframe(profileChannel, profileKeyTime, argument))
+    {
+        sendResponse("Profile keyframe rejected at: ", profileKeyTime);
+        return COMMAND_REJECTED;
+    }
+    return COMMAND_OK;
+}
+
+static uint8_t profileInterpolation(int32_t argument)
+{
+    profileSetInterpolation(profileChannel, argument);
+    sendResponse("Changeing profile interpolation to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t profileLoop(int32_t argument)
+{
+    profileSetLoop(profileChannel, argument != 0);
+    sendResponse("Changeing profile looping to: ", argument);
+    return COMMAND_OK;
+}
+
+/* The profiles only advance while the regulator runs with capture on. */
+static uint8_t profileStartChannels(int32_t argument)
+{
+    if (! profileStart(argument))
+    {
+        sendString("Profile", "empty channel");
+        return COMMAND_REJECTED;
+    }
+    if (! capture) sendString("Profile", "waiting for capture");
+    else sendString("Profile", "started");
+    return COMMAND_OK;
+}
+
+static uint8_t profileStopAll(int32_t argument)
+{
+    (void)argument;
+    profileStop();
+    sendString("Profile", "stopped");
+    return COMMAND_OK;
+}
+
+static uint8_t brightnessSelect(int32_t argument)
+{
+    brightnessChannel = argument;
+    sendResponse("Brightness channel: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t brightnessCurve(int32_t argument)
+{
+    brightnessSetCurve(brightnessChannel, argument);
+    storeSet(STORE_BRIGHTNESS_CURVE(brightnessChannel), argument);
+    sendResponse("Changeing brightness curve to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t brightnessFullScale(int32_t argument)
+{
+    brightnessSetFullScale(brightnessChannel, argument);
+    storeSet(STORE_BRIGHTNESS_SCALE(brightnessChannel), argument);
+    sendResponse("Changeing brightness full scale to: ", argument);
+    return COMMAND_OK;
+}
+
+/* Levels are not echoed, so that fades can be sent quickly. The duty cycle
+channel only applies in buck mode, as the regulator sets it otherwise. */
+static uint8_t brightnessLevel(int32_t argument)
+{
+    int32_t value = brightnessMap(brightnessChannel, argument);
+    if (brightnessChannel == BRIGHTNESS_SETPOINT) setValue = value;
+    else if (controlGetMode() == CONTROL_BUCK)
+    {
+        ch2DutyCycle = clamp(value, 0, 1000);
+        pwmChanged = true;
+    }
+    return COMMAND_OK;
+}
+
+static uint8_t waveformErase(int32_t argument)
+{
+    (void)argument;
+    waveformClear();
+    sendString("Waveform", "cleared");
+    return COMMAND_OK;
+}
+
+static uint8_t waveformEntryBuck(int32_t argument)
+{
+    waveformBuck = argument;
+    return COMMAND_OK;
+}
+
+/* Entries are acknowledged only on failure, to keep uploads short. */
+static uint8_t waveformEntryBoost(int32_t argument)
+{
+    if (! waveformAdd(waveformBuck, argument))
+    {
+        sendString("Waveform", "entry rejected");
+        return COMMAND_REJECTED;
+    }
+    return COMMAND_OK;
+}
+
+static uint8_t waveformRepetition(int32_t argument)
+{
+    waveformSetRepeat(argument);
+    sendResponse("Changeing waveform repeat to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t waveformPlays(int32_t argument)
+{
+    waveformSetPlays(argument);
+    sendResponse("Changeing waveform plays to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t waveformStart(int32_t argument)
+{
+    (void)argument;
+    if (! timer1WaveformPlay())
+    {
+        sendString("Waveform", "nothing to play");
+        return COMMAND_REJECTED;
+    }
+    sendString("Waveform", "playing");
+    return COMMAND_OK;
+}
+
+static uint8_t waveformHalt(int32_t argument)
+{
+    (void)argument;
+    timer1WaveformStop();
+    sendString("Waveform", "stopped");
+    return COMMAND_OK;
+}
+
+/* A capture in progress keeps its settings */
+static uint8_t acquisitionInput(int32_t argument)
+{
+    acquisitionSetInput(argument - 4);
+    sendResponse("Changeing capture input to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t acquisitionDerivative(int32_t argument)
+{
+    acquisitionSetDerivative(argument);
+    sendResponse("Changeing capture change threshold to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t acquisitionDeviation(int32_t argument)
+{
+    acquisitionSetDeviation(argument);
+    sendResponse("Changeing capture deviation threshold to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t acquisitionWindow(int32_t argument)
+{
+    acquisitionSetWindow(argument);
+    sendResponse("Changeing capture window to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t acquisitionTrigger(int32_t argument)
+{
+    acquisitionArm(argument != 0);
+    if (argument != 0) sendString("Capture", "armed");
+    else sendString("Capture", "disarmed");
+    return COMMAND_OK;
+}
+
+static uint8_t acquisitionRead(int32_t argument)
+{
+    (void)argument;
+    if (! acquisitionSend())
+    {
+        sendString("Capture", "none held");
+        return COMMAND_REJECTED;
+    }
+    return COMMAND_OK;
+}
+
+static uint8_t deadlineLimit(int32_t argument)
+{
+    deadlineSetLimit(argument*DEADLINE_CLOCK_MHZ);
+    sendResponse("Changeing regulator deadline to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t deadlineShed(int32_t argument)
+{
+    deadlineSetShed(argument);
+    sendResponse("Changeing misses shedding telemetry to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t deadlineSafe(int32_t argument)
+{
+    deadlineSetSafe(argument);
+    sendResponse("Changeing misses holding PWM off to: ", argument);
+    return COMMAND_OK;
+}
+
+static uint8_t deadlineNormal(int32_t argument)
+{
+    (void)argument;
+    deadlineClear();
+    return COMMAND_OK;
+}
+
+static uint8_t deadlineRead(int32_t argument)
+{
+    (void)argument;
+    deadlineSend();
+    return COMMAND_OK;
+}
+
+static uint8_t linkRatePropose(int32_t argument)
+{
+    if (! linkPropose(argument))
+    {
+        sendString("Link", "rate rejected");
+        return COMMAND_REJECTED;
+    }
+    dataMessageSend("ub", argument, LINK_TRIAL_TIME);
+    return COMMAND_OK;
+}
+
+static uint8_t linkTest(int32_t argument)
+{
+    char pattern[LINK_PATTERN_SIZE+1];
+    linkPattern(argument, pattern);
+    sendString("ut", pattern);
+    return COMMAND_OK;
+}
+
+static uint8_t linkRateConfirm(int32_t argument)
+{
+    (void)argument;
+    if (! linkConfirm())
+    {
+        sendString("Link", "no rate on trial");
+        return COMMAND_REJECTED;
+    }
+    return COMMAND_OK;
+}
+
+static uint8_t linkStatus(int32_t argument)
+{
+    (void)argument;
+    dataMessageSend("ul", linkRate(), linkErrors());
+    return COMMAND_OK;
+}
+
+static uint8_t storeStatus(int32_t argument)
+{
+    (void)argument;
+    dataMessageSend("ks", storeFree(), storePending());
+    return COMMAND_OK;
+}
+
+static uint8_t storeClear(int32_t argument)
+{
+    (void)argument;
+    uint8_t key;
+    for (key = 0; key < STORE_KEYS; key++) storeRemove(key);
+    sendString("Store", "cleared");
+    return COMMAND_OK;
+}
+
+static uint8_t dataRaw(int32_t argument)
+{
+    (void)argument;
+    uint8_t i;
+    for (i = 0; i < NUM_CHANNEL; i++) dataMessageSend("dr", i + 4, v[i]);
+    return COMMAND_OK;
+}
+
+static uint8_t dataEnergy(int32_t argument)
+{
+    (void)argument;
+    int32_t energy, charge;
+    energyTotal(ENERGY_INPUT, &energy, &charge);
+    dataMessageSend("ei", energy, charge);
+    energyTotal(ENERGY_OUTPUT, &energy, &charge);
+    dataMessageSend("eo", energy, charge);
+    dataMessageSend("et", energySeconds(), energyEfficiency());
+    return COMMAND_OK;
+}
+
+static uint8_t dataEnergyReset(int32_t argument)
+{
+    (void)argument;
+    energyReset();
+    sendString("Energy", "reset");
+    return COMMAND_OK;
+}
+
+static uint8_t dataBenchmark(int32_t argument)
+{
+    (void)argument;
+    cycleBenchmark();
+    return COMMAND_OK;
+}
+
+static uint8_t dataLatency(int32_t argument)
+{
+    (void)argument;
+    LatencyRecord record;
+    latencyRead(LATENCY_ADC, &record);
+    dataMessageSend("tl", record.latencyMin, record.latencyMax);
+    dataMessageSend("ta", record.durationMin, record.durationMax);
+    dataMessageSend("tm", RAMFUNC_ENABLED, record.count);
+    latencyRead(LATENCY_COMMS, &record);
+    dataMessageSend("tc", record.durationMin, record.durationMax);
+    latencyRead(LATENCY_CONTROL, &record);
+    dataMessageSend("tr", record.durationMin, record.durationMax);
+    latencyReset();
+    return COMMAND_OK;
+}
+
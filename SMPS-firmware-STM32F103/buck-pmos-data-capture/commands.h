@@ -0,0 +1,60 @@
+/* STM32F1 SMPS Command Interpreter
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMANDS_H_
+#define COMMANDS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "commslib.h"
+
+/* Maximum number of commands in one line or binary frame */
+#define MAX_BATCH           16
+
+/* Size of one command in a binary frame: group, command, int32 LSB first */
+#define BINARY_COMMAND_SIZE 6
+
+/* Argument types */
+#define ARGUMENT_NONE       0
+#define ARGUMENT_SWITCH     1   /* '+' or '-' in ASCII, 1 or 0 in binary */
+#define ARGUMENT_INTEGER    2
+
+typedef struct {
+    char group;             /* 'a' action, 'p' parameter, 'd' data */
+    char command;
+    uint8_t argumentType;
+    int32_t minimum;        /* Inclusive range of an integer argument */
+    int32_t maximum;
+    uint8_t (*action)(int32_t argument);    /* COMMAND_OK or _REJECTED */
+} CommandEntry;
+
+uint8_t parseCommand(CommandRecord* command);
+void commandsRestore(void);
+void commandsSaveTuning(int16_t dutyCycle, int32_t proportional,
+                        int32_t integral);
+
+#endif
+
@@ -3,6 +3,10 @@
 The buffering of receive and send characters is handled here, as well as
 handling of buffer full and empty situations.
 
+Received characters are assembled into command lines in the ISR. Each
+completed line is tokenised, given a sequence id and placed on a small queue
+of command records, so the main loop only ever sees whole commands.
+
 Initial 11 December 2015
 */
 
@@ -24,6 +28,7 @@ Initial 11 December 2015
  */
 
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/dwt.h>
 #include <libopencm3/stm32/usart.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -32,12 +37,39 @@ Initial 11 December 2015
 #include "buffer.h"
 #include "stringlib.h"
 #include "commslib.h"
+#include "ramfunc.h"
+#include "latency.h"
+#include "link.h"
 
 /*--------------------------------------------------------------------------*/
 /* Receive and Transmit buffer globals */
 
 static uint8_t sendBuffer[BUFFER_SIZE+3];
-static uint8_t receiveBuffer[BUFFER_SIZE+3];
+
+/* Command queue. The ISR assembles into the record at the head, which is
+always free, and advances the head when the line is complete. The main loop
+consumes from the tail. */
+static CommandRecord commandQueue[COMMAND_QUEUE_SIZE];
+static volatile uint8_t commandHead;
+static volatile uint8_t commandTail;
+static uint16_t commandSequence;
+static volatile bool commandDropped;
+static volatile uint16_t droppedSequence;
+/* Binary frame reception state, used by the ISR only */
+#define BINARY_NONE         0
+#define BINARY_LENGTH       1
+#define BINARY_PAYLOAD      2
+#define BINARY_DISCARD      3       /* Rejected, ignored until the line idles */
+static uint8_t binaryState;
+static uint32_t binaryLastByte;     /* Cycle counter at the last byte */
+static uint8_t binaryLength;
+static uint8_t binaryCount;
+static uint8_t binaryChecksum;
+
+static void commsResetRecord(CommandRecord* record);
+static void commsReceiveCharacter(uint8_t character);
+static void commsReceiveBinary(CommandRecord* record, uint8_t character);
+static void commsQueueRecord(CommandRecord* record);
 
 /*--------------------------------------------------------------------------*/
 /** @brief Initialize Communications Buffers to Empty
@@ -47,18 +79,99 @@ static uint8_t receiveBuffer[BUFFER_SIZE+3];
 void commsInit(void)
 {
 	buffer_init(sendBuffer,BUFFER_SIZE);
-	buffer_init(receiveBuffer,BUFFER_SIZE);
+    commandHead = 0;
+    commandTail = 0;
+    commandSequence = 0;
+    commandDropped = false;
+    binaryState = BINARY_NONE;
+    commsResetRecord(&commandQueue[commandHead]);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Return the next complete command
+
+The record remains owned by the caller until commsReleaseCommand is called,
+so it can be parsed in place without copying.
+
+@returns CommandRecord*: oldest queued command or NULL if none is ready.
+*/
+
+CommandRecord* commsNextCommand(void)
+{
+    if (commandTail == commandHead) return NULL;
+    return &commandQueue[commandTail];
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Release the command obtained from commsNextCommand
+
+*/
+
+void commsReleaseCommand(void)
+{
+    if (commandTail == commandHead) return;
+    commandTail = (commandTail + 1) % COMMAND_QUEUE_SIZE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Report a command line discarded because the queue was full
+
+Only the most recent discarded sequence id is kept. The flag is cleared on
+reading.
+
+@param[out] uint16_t* sequence: sequence id of the discarded command.
+@returns true if a command was discarded since the last call.
+*/
+
+bool commsDroppedCommand(uint16_t* sequence)
+{
+    if (! commandDropped) return false;
+    usart_disable_rx_interrupt(USART2);
+    *sequence = droppedSequence;
+    commandDropped = false;
+    usart_enable_rx_interrupt(USART2);
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Acknowledge a command
+
+Sends "ack, sequence, status" so that the host can match the response to the
+command line it sent.
+
+@param[in] uint16_t sequence: sequence id from the command record.
+@param[in] uint8_t status: COMMAND_OK or an error code.
+*/
+
+void commsAcknowledge(uint16_t sequence, uint8_t status)
+{
+    dataMessageSend("ack", sequence, status);
 }
 
 /*--------------------------------------------------------------------------*/
-/** @brief Return next character from receive buffer
+/** @brief Space left in the transmit buffer
+
+Lets a long sequence of messages be paced so that it leaves room for others.
 
-The buffer_get function returns 0x100 if no character is present.
+@returns uint16_t: characters that can be buffered.
 */
 
-uint16_t commsNextCharacter(void)
+uint16_t commsTransmitSpace(void)
 {
-    return buffer_get(receiveBuffer);
+    return buffer_output_places(sendBuffer);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check that the transmit buffer has been emptied
+
+The last character may still be in the USART.
+
+@returns bool: true if nothing is buffered.
+*/
+
+bool commsTransmitEmpty(void)
+{
+    return ! buffer_input_available(sendBuffer);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -186,24 +299,203 @@ void commsPrintChar(char *ch)
 /*--------------------------------------------------------------------------*/
 /** @brief USART ISR
 
-Find out what interrupted and get or send data as appropriate */
+Find out what interrupted and get or send data as appropriate. This runs
+from RAM along with the command assembly it calls, and uses the USART
+registers directly rather than the libopencm3 functions in FLASH. */
 
+RAMFUNC
 void usart2_isr(void)
 {
 	static uint16_t data;
-
+	uint32_t entry = latencyEnter(LATENCY_COMMS);
+
+	/* Framing, noise and overrun errors are counted against the link rate.
+	They come with RXNE and are cleared by the status register read here
+	followed by the data register read. */
+	uint32_t status = USART_SR(USART2);
+	bool error = (status & (USART_SR_FE | USART_SR_NE | USART_SR_ORE)) != 0;
+	if (error) linkError();
 	/* Check if we were called because of RXNE. */
-	if (usart_get_flag(USART2,USART_SR_RXNE))
+	if (status & USART_SR_RXNE)
 	{
-		/* If buffer full we'll just drop it */
-		buffer_put(receiveBuffer, (uint8_t) usart_recv(USART2));
+		commsReceiveCharacter((uint8_t) USART_DR(USART2));
 	}
+	else if (error) (void) USART_DR(USART2);
 	/* Check if we were called because of TXE. */
-	if (usart_get_flag(USART2,USART_SR_TXE))
+	if (status & USART_SR_TXE)
 	{
 		/* If buffer empty, disable the tx interrupt */
 		data = buffer_get(sendBuffer);
-		if ((data & 0xFF00) > 0) usart_disable_tx_interrupt(USART2);
-		else usart_send(USART2, (data & 0xFF));
+		if ((data & 0xFF00) > 0) USART_CR1(USART2) &= ~USART_CR1_TXEIE;
+		else USART_DR(USART2) = data & 0xFF;
 	}
+	latencyExit(LATENCY_COMMS, entry);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Add a received character to the command being assembled
+
+Lines are terminated by CR or LF; blank lines are ignored. Spaces, commas and
+semicolons separate tokens and are replaced by 0 so that each token is a
+string. A line that is too long or has too many tokens is still queued, but
+marked so that it is rejected rather than being acted on partially.
+
+A binary frame start byte at the beginning of a line switches to binary
+reception for the rest of the frame. A frame is given up when the line is
+idle for BINARY_IDLE_CYCLES before it is complete, as when a byte is lost.
+It is then queued as incomplete, to be negatively acknowledged, and the byte
+after the gap starts afresh.
+
+Called from the ISR only.
+
+@param[in] uint8_t character: received character.
+*/
+
+RAMFUNC
+static void commsReceiveCharacter(uint8_t character)
+{
+    CommandRecord* record = &commandQueue[commandHead];
+    uint32_t now = DWT_CYCCNT;
+    bool idle = (now - binaryLastByte > BINARY_IDLE_CYCLES);
+    binaryLastByte = now;
+    if (idle)
+    {
+        if ((binaryState == BINARY_LENGTH) || (binaryState == BINARY_PAYLOAD))
+        {
+            if (record->status == COMMAND_OK)
+                record->status = COMMAND_INCOMPLETE;
+            commsQueueRecord(record);
+            record = &commandQueue[commandHead];
+        }
+        binaryState = BINARY_NONE;
+    }
+    if (binaryState == BINARY_DISCARD) return;
+    if (binaryState != BINARY_NONE)
+    {
+        commsReceiveBinary(record, character);
+        return;
+    }
+    if ((character == BINARY_FRAME_START) && (record->length == 0) &&
+        (record->status == COMMAND_OK))
+    {
+        record->format = COMMAND_BINARY;
+        binaryState = BINARY_LENGTH;
+        return;
+    }
+    if ((character == 0x0D) || (character == 0x0A))
+    {
+        if ((record->length == 0) && (record->status == COMMAND_OK)) return;
+        record->line[record->length] = 0;
+        commsQueueRecord(record);
+        return;
+    }
+    if (record->length >= COMMAND_LINE_SIZE - 1)
+    {
+        record->status = COMMAND_OVERLONG;
+        return;
+    }
+    bool tokenStart = (record->length == 0) ||
+                      (record->line[record->length - 1] == 0);
+    if ((character == ' ') || (character == ',') || (character == ';'))
+    {
+        if (! tokenStart) record->line[record->length++] = 0;
+        return;
+    }
+    if (tokenStart)
+    {
+        if (record->numTokens >= COMMAND_MAX_TOKENS)
+        {
+            record->status = COMMAND_OVERLONG;
+            return;
+        }
+        record->token[record->numTokens++] = record->length;
+    }
+    record->line[record->length++] = character;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Add a received byte to a binary frame being assembled
+
+The first byte is the payload length, then the payload, then the checksum.
+A length longer than the record, most likely a corrupted one, is rejected at
+once and the rest of the frame ignored until the line is idle, so that the
+bytes following are not taken as its payload.
+
+Called from the ISR only.
+
+@param[in] CommandRecord* record: record being assembled.
+@param[in] uint8_t character: received byte.
+*/
+
+RAMFUNC
+static void commsReceiveBinary(CommandRecord* record, uint8_t character)
+{
+    if (binaryState == BINARY_LENGTH)
+    {
+        binaryLength = character;
+        binaryCount = 0;
+        binaryChecksum = character;
+        binaryState = BINARY_PAYLOAD;
+        if (binaryLength > COMMAND_LINE_SIZE)
+        {
+            record->status = COMMAND_OVERLONG;
+            binaryState = BINARY_DISCARD;
+            commsQueueRecord(record);
+        }
+    }
+    else if (binaryCount < binaryLength)
+    {
+        record->line[record->length++] = character;
+        binaryChecksum += character;
+        binaryCount++;
+    }
+    else
+    {
+        binaryChecksum += character;
+        if ((binaryChecksum != 0) && (record->status == COMMAND_OK))
+            record->status = COMMAND_CHECKSUM;
+        binaryState = BINARY_NONE;
+        commsQueueRecord(record);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Queue a completed command record
+
+The record at the head is given the next sequence id. If the queue is full
+the record is discarded and its sequence id remembered for a negative
+acknowledgement.
+
+Called from the ISR only.
+
+@param[in] CommandRecord* record: completed record at the queue head.
+*/
+
+RAMFUNC
+static void commsQueueRecord(CommandRecord* record)
+{
+    record->sequence = commandSequence++;
+    uint8_t nextHead = (commandHead + 1) % COMMAND_QUEUE_SIZE;
+    if (nextHead == commandTail)
+    {
+        droppedSequence = record->sequence;
+        commandDropped = true;
+    }
+    else commandHead = nextHead;
+    commsResetRecord(&commandQueue[commandHead]);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear a command record ready for assembly
+
+@param[in] CommandRecord* record: record to clear.
+*/
+
+RAMFUNC
+static void commsResetRecord(CommandRecord* record)
+{
+    record->status = COMMAND_OK;
+    record->format = COMMAND_ASCII;
+    record->length = 0;
+    record->numTokens = 0;
 }
@@ -27,10 +27,53 @@ Initial 11 December 2015
 #include <stdbool.h>
 #include <stdlib.h>
 
-#define BUFFER_SIZE 128
+/* Transmit buffer size. The buffer indices are 8 bit so this is at most 255. */
+#define BUFFER_SIZE 255
+
+/* Command line assembly. Lines are framed and tokenised in the receive ISR
+and queued as complete command records for the main loop. */
+#define COMMAND_LINE_SIZE   80
+#define COMMAND_QUEUE_SIZE  8
+#define COMMAND_MAX_TOKENS  8
+
+/* Command record status, also returned in the acknowledgement. */
+#define COMMAND_OK          0
+#define COMMAND_INVALID     1
+#define COMMAND_OVERLONG    2
+#define COMMAND_DROPPED     3
+#define COMMAND_CHECKSUM    4
+#define COMMAND_INCOMPLETE  5   /* Binary frame given up on an idle gap */
+#define COMMAND_REJECTED    6   /* Refused in the present state */
+
+/* Command record format. A binary frame is introduced by the start byte
+(never sent in ASCII commands) followed by a payload length byte, the payload
+and a checksum byte chosen so that length, payload and checksum sum to 0. */
+#define COMMAND_ASCII       0
+#define COMMAND_BINARY      1
+#define BINARY_FRAME_START  0xA5
+
+/* Line idle time in processor cycles that gives up a binary frame part way,
+10ms, over ten characters at the slowest link rate. */
+#define BINARY_IDLE_CYCLES  720000
+
+typedef struct {
+    uint16_t sequence;      /* Sequence id assigned on reception */
+    uint8_t status;         /* COMMAND_OK unless framing failed */
+    uint8_t format;         /* COMMAND_ASCII or COMMAND_BINARY */
+    uint8_t length;         /* Characters in line, or binary payload bytes */
+    uint8_t numTokens;
+    uint8_t token[COMMAND_MAX_TOKENS];  /* Offsets of each token in line */
+    uint8_t line[COMMAND_LINE_SIZE];    /* Tokens each terminated by 0,
+                                           or binary payload */
+} CommandRecord;
 
 void commsInit(void);
-uint16_t commsNextCharacter(void);
+CommandRecord* commsNextCommand(void);
+void commsReleaseCommand(void);
+bool commsDroppedCommand(uint16_t* sequence);
+void commsAcknowledge(uint16_t sequence, uint8_t status);
+uint16_t commsTransmitSpace(void);
+bool commsTransmitEmpty(void);
 bool dataMessageSend(char* ident, int32_t parm1, int32_t parm2);
 bool sendResponse(char* ident, int32_t parameter);
 bool sendString(char* ident, char* string);
@@ -0,0 +1,606 @@
+/* STM32F1 SMPS Regulator
+
+The regulator sets the buck duty cycle from the difference between the
+setpoint and the measured channel 1 value. It is called once per regulator
+period and is independent of the hardware.
+
+An optional feed-forward term computes the ideal buck duty cycle D = Vout/Vin
+from the measured input voltage and an output voltage. This is either the
+measured output voltage, or for LED current regulation the voltage needed
+for the setpoint given by a linear LED string model Vout = knee + slope*I/1000.
+Changes in the feed-forward term are applied to the duty cycle directly, so
+that the feedback only has to correct the residual error. With the measured
+output voltage only the change due to the input voltage is applied, as the
+output follows the duty cycle and would otherwise feed back on itself. The
+output and input voltages are assumed to be measured with the same scaling.
+When feed-forward is turned on the duty cycle is moved to the feed-forward
+value at no more than FEEDFORWARD_SLEW per period, so that the output is not
+hit with a step of the whole duty cycle, and the feedback is held until the
+move is complete so that it does not wind up on the error meanwhile. Later
+changes are small and applied at once. The LED model mode can only be
+turned on once the knee and slope have been set.
+
+In buck-boost mode the regulator works on a single conversion demand from 0
+to BOOST_DEMAND + BOOST_MAX promille. Up to 1000 this is the buck duty cycle
+with the boost switch off. From there to BOOST_DEMAND is a pass-through
+band, twice PASS_BAND wide, with the buck switch fully on and the boost
+switch off, so that the demand crosses between buck and boost without short
+pulses on both switches. Above it the excess is the boost duty cycle. The
+duty cycles follow the demand continuously across the band, and the
+operating region reported is found from the demand with hysteresis so that
+it does not chatter at the boundaries.
+
+In MPPT mode the buck duty cycle is set by the maximum power point tracker,
+and the setpoint becomes a limit. When the regulated value exceeds it the
+regulator reduces the duty cycle and tracking restarts from there.
+
+The feedback is either a pure integrator with the error divided by a gain
+divisor, or a PI regulator with gains set by the relay auto-tune. Both work
+in velocity form, adding a step to the demand each period, so the demand
+itself is the integrator state. Gains can then be changed between periods
+without a step in the output. Each auto-tune stores its gains at a point of
+a schedule over the buck duty cycle, and with scheduling enabled the gains
+are interpolated between the tuned points at the present demand.
+
+The number of regulator periods taken to settle after a setpoint change is
+measured so that the step response can be compared with and without
+feed-forward.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "control.h"
+#include "fixmath.h"
+#include "mppt.h"
+#include "ramfunc.h"
+#include "buck-pmos-data-capture.h"
+
+/* Demand at which the boost switch starts, the top of the pass-through band */
+#define BOOST_DEMAND        (1000 + 2*PASS_BAND)
+#define PASS_CENTRE         (1000 + PASS_BAND)
+
+/*--------------------------------------------------------------------------*/
+/* Regulator state */
+
+static Reciprocal gainDivisor;      /* Error divisor setting the loop gain */
+/* PI regulator gains in Q16 promille per unit error */
+typedef struct {
+    int32_t proportional;
+    int32_t integral;               /* Per regulator period */
+    bool valid;
+} Gains;
+static bool piActive;               /* PI gains rather than the divisor */
+static Gains fixedGains;            /* Used when not scheduled */
+static Gains schedule[SCHEDULE_POINTS];
+static bool scheduleEnabled;
+static int32_t lastError;
+static int32_t fraction;            /* Q16 remainder of the feedback step */
+static bool feedbackRestart;        /* Gains changed, lastError is stale */
+static uint8_t controlMode;
+static uint8_t region;              /* Buck-boost operating region */
+static int32_t demand;              /* Conversion demand in promille */
+static int16_t lastBuckDutyCycle;   /* Duty cycles set last period */
+static int16_t lastBoostDutyCycle;
+static uint8_t feedForwardMode;
+static bool feedForwardSeed;        /* Set duty cycle to feed-forward value */
+static int32_t feedForwardPending;  /* Seed move not yet applied */
+static int32_t ledKnee;             /* LED model voltage at zero current */
+static int32_t ledSlope;            /* LED model voltage per 1000 current */
+static uint8_t ledModelSet;         /* LED_KNEE_SET and LED_SLOPE_SET */
+static int32_t lastFeedForward;     /* Feed-forward duty cycle last period */
+static int32_t lastInputVoltage;    /* Input voltage last period */
+static int32_t modifier;            /* Feedback step last period */
+/* Setpoint step response measurement */
+static int32_t lastSetValue;
+static bool settling;
+static int32_t settleCount;
+static int32_t settleHold;
+static int32_t settleResult;
+static bool settleAvailable;
+
+static int32_t feedForward(int32_t outputVoltage, int32_t inputVoltage);
+static void restartFeedback(void);
+static void updateRegion(void);
+static void scheduledGains(Gains* gains);
+static int32_t interpolateGain(int32_t difference, int32_t offset,
+                               int32_t span);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the regulator
+
+Feed-forward is off and there are no tuned gains, giving a pure integrating
+regulator.
+*/
+
+void controlInit(void)
+{
+    reciprocalInit(&gainDivisor, GAIN_DIVISOR);
+    piActive = false;
+    scheduleEnabled = false;
+    uint8_t point;
+    for (point = 0; point < SCHEDULE_POINTS; point++)
+        schedule[point].valid = false;
+    lastError = 0;
+    fraction = 0;
+    feedbackRestart = true;
+    mpptInit();
+    controlMode = CONTROL_BUCK;
+    region = REGION_BUCK;
+    demand = 0;
+    lastBuckDutyCycle = 0;
+    lastBoostDutyCycle = 0;
+    feedForwardMode = FEEDFORWARD_OFF;
+    feedForwardSeed = false;
+    feedForwardPending = 0;
+    ledKnee = 0;
+    ledSlope = 0;
+    ledModelSet = 0;
+    lastFeedForward = 0;
+    lastInputVoltage = 0;
+    modifier = 0;
+    lastSetValue = 0;
+    settling = false;
+    settleAvailable = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the regulator gain
+
+This returns the regulator to a pure integrator, discarding any tuned gains.
+The feedback restarts so that no step is carried over from the old gains.
+
+@param[in] uint16_t divisor: the error is divided by this to form the duty
+           cycle step. Must be non zero.
+*/
+
+void controlSetGain(uint16_t divisor)
+{
+    reciprocalInit(&gainDivisor, divisor);
+    piActive = false;
+    restartFeedback();
+    uint8_t point;
+    for (point = 0; point < SCHEDULE_POINTS; point++)
+        schedule[point].valid = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set PI gains from an auto-tune
+
+The gains become the fixed gains, and are stored at the schedule point
+nearest the duty cycle of the tune. The feedback restarts, as the error
+last seen by the regulator is from before the tune.
+
+@param[in] int16_t dutyCycle: buck duty cycle of the tune in promille.
+@param[in] int32_t proportional: Q16 promille per unit error.
+@param[in] int32_t integral: Q16 promille per unit error per period.
+*/
+
+void controlSetTuning(int16_t dutyCycle, int32_t proportional,
+                      int32_t integral)
+{
+    uint8_t point = clamp(dutyCycle*SCHEDULE_POINTS/1000, 0,
+                          SCHEDULE_POINTS - 1);
+    schedule[point].proportional = proportional;
+    schedule[point].integral = integral;
+    schedule[point].valid = true;
+    fixedGains = schedule[point];
+    piActive = true;
+    restartFeedback();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Enable gain scheduling
+
+@param[in] bool enable: interpolate the tuned gains at the present demand,
+           otherwise use the gains of the last tune.
+*/
+
+void controlSetSchedule(bool enable)
+{
+    scheduleEnabled = enable;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief PI gains in use
+
+Both are zero for the pure integrator.
+
+@param[out] int32_t* proportional: Q16 promille per unit error.
+@param[out] int32_t* integral: Q16 promille per unit error per period.
+*/
+
+void controlGains(int32_t* proportional, int32_t* integral)
+{
+    Gains gains = {0, 0, false};
+    if (piActive) scheduledGains(&gains);
+    *proportional = gains.proportional;
+    *integral = gains.integral;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the control mode
+
+In buck mode the boost duty cycle is left unchanged by the regulator.
+
+@param[in] uint8_t mode: CONTROL_BUCK, CONTROL_BUCK_BOOST or CONTROL_MPPT.
+*/
+
+void controlSetMode(uint8_t mode)
+{
+    if ((mode == CONTROL_MPPT) && (controlMode != CONTROL_MPPT)) mpptReset();
+    controlMode = mode;
+    region = REGION_BUCK;
+    lastBuckDutyCycle = -1;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Get the control mode
+
+@returns uint8_t: CONTROL_BUCK, CONTROL_BUCK_BOOST or CONTROL_MPPT.
+*/
+
+RAMFUNC
+uint8_t controlGetMode(void)
+{
+    return controlMode;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Buck-boost operating region
+
+@returns uint8_t: REGION_BUCK, REGION_PASS or REGION_BOOST.
+*/
+
+uint8_t controlRegion(void)
+{
+    return region;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the feed-forward mode
+
+When feed-forward is turned on the duty cycle is slewed to the feed-forward
+value from the next regulator period.
+
+@param[in] uint8_t mode: FEEDFORWARD_OFF, FEEDFORWARD_VOLTAGE or
+           FEEDFORWARD_LED.
+@returns bool: false, leaving the mode unchanged, if the LED model is asked
+         for before its knee and slope are set.
+*/
+
+bool controlSetFeedForward(uint8_t mode)
+{
+    if ((mode == FEEDFORWARD_LED) &&
+        (ledModelSet != (LED_KNEE_SET | LED_SLOPE_SET))) return false;
+    feedForwardSeed = (mode != FEEDFORWARD_OFF) && (mode != feedForwardMode);
+    feedForwardMode = mode;
+    feedForwardPending = 0;
+    lastFeedForward = 0;
+    lastInputVoltage = 0;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the LED string model knee voltage
+
+@param[in] int32_t knee: output voltage at which the LEDs start conducting.
+*/
+
+void controlSetLedKnee(int32_t knee)
+{
+    ledKnee = knee;
+    ledModelSet |= LED_KNEE_SET;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the LED string model slope
+
+@param[in] int32_t slope: increase in output voltage per 1000 of current.
+*/
+
+void controlSetLedSlope(int32_t slope)
+{
+    ledSlope = slope;
+    ledModelSet |= LED_SLOPE_SET;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Regulator update
+
+Called once per regulator period. If the duty cycles have been changed
+since the last update, for example by a command, the regulator continues
+from the new values.
+
+@param[in,out] int16_t* buckDutyCycle: buck duty cycle in promille.
+@param[in,out] int16_t* boostDutyCycle: boost duty cycle in promille.
+@param[in] int32_t setValue: setpoint of the regulated value.
+@param[in] int32_t isValue: measured regulated value.
+@param[in] int32_t inputVoltage: measured input voltage.
+@param[in] int32_t inputCurrent: measured input current.
+@param[in] int32_t outputVoltage: measured output voltage.
+*/
+
+RAMFUNC
+void controlUpdate(int16_t* buckDutyCycle, int16_t* boostDutyCycle,
+                   int32_t setValue, int32_t isValue, int32_t inputVoltage,
+                   int32_t inputCurrent, int32_t outputVoltage)
+{
+    int32_t demandMaximum = 1000;
+    if (controlMode == CONTROL_BUCK_BOOST)
+        demandMaximum = BOOST_DEMAND + BOOST_MAX;
+    if ((*buckDutyCycle != lastBuckDutyCycle) ||
+        (*boostDutyCycle != lastBoostDutyCycle))
+    {
+        demand = *buckDutyCycle;
+        if ((controlMode == CONTROL_BUCK_BOOST) && (*boostDutyCycle > 0))
+            demand = BOOST_DEMAND + *boostDutyCycle;
+    }
+
+/* Feed-forward. Changes in the ideal demand go straight to the output, the
+move to the seed is limited in rate. */
+    if ((feedForwardMode != FEEDFORWARD_OFF) && (controlMode != CONTROL_MPPT))
+    {
+        if (feedForwardMode == FEEDFORWARD_LED)
+            outputVoltage = addSaturate(ledKnee,
+                                mulSaturate(ledSlope, setValue, 0)/1000);
+        int32_t feedForwardDemand = feedForward(outputVoltage, inputVoltage);
+        if (feedForwardSeed) feedForwardPending = feedForwardDemand - demand;
+        else if (feedForwardMode == FEEDFORWARD_LED)
+            demand += feedForwardDemand - lastFeedForward;
+        else if (lastInputVoltage >= FEEDFORWARD_MIN_INPUT)
+            demand += feedForwardDemand -
+                      feedForward(outputVoltage, lastInputVoltage);
+        int32_t step = clamp(feedForwardPending, -FEEDFORWARD_SLEW,
+                             FEEDFORWARD_SLEW);
+        demand += step;
+        feedForwardPending -= step;
+        lastFeedForward = feedForwardDemand;
+        lastInputVoltage = inputVoltage;
+        feedForwardSeed = false;
+    }
+    else feedForwardPending = 0;
+
+/* Feedback. After a change of gains the proportional term starts from the
+present error rather than kicking on the difference from a stale one. */
+    int32_t error = subSaturate(setValue, isValue);
+    if (feedbackRestart) lastError = error;
+    feedbackRestart = false;
+    if (piActive)
+    {
+/* The fraction carries small steps over to later periods */
+        Gains gains;
+        scheduledGains(&gains);
+        int64_t step = (int64_t)gains.proportional*
+                       subSaturate(error, lastError) +
+                       (int64_t)gains.integral*error + fraction;
+        modifier = saturate32(step >> 16);
+        fraction = (int32_t)(step - ((int64_t)modifier << 16));
+        if ((fraction < 0) || (fraction > 0xFFFF)) fraction = 0;
+    }
+    else
+    {
+        modifier = reciprocalDivideSigned(&gainDivisor, error);
+        if (modifier == 0 && error < -CONTROL_DEADBAND) modifier = -1;
+        if (modifier == 0 && error > CONTROL_DEADBAND) modifier = 1;
+    }
+    lastError = error;
+    if ((controlMode == CONTROL_MPPT) && (modifier >= 0))
+        demand = mpptUpdate(demand, inputVoltage, inputCurrent);
+    else
+    {
+/* The feedback waits for the feed-forward seed to be reached */
+        if (feedForwardPending == 0) demand += modifier;
+        if (controlMode == CONTROL_MPPT) mpptReset();
+    }
+    demand = clamp(demand, 0, demandMaximum);
+
+/* Map the demand to the switch duty cycles, whatever the region */
+    if (controlMode == CONTROL_BUCK_BOOST)
+    {
+        updateRegion();
+        *buckDutyCycle = (demand < 1000) ? demand : 1000;
+        *boostDutyCycle = (demand > BOOST_DEMAND) ? demand - BOOST_DEMAND : 0;
+    }
+    else *buckDutyCycle = demand;
+    lastBuckDutyCycle = *buckDutyCycle;
+    lastBoostDutyCycle = *boostDutyCycle;
+
+/* Step response measurement */
+    if (setValue != lastSetValue)
+    {
+        lastSetValue = setValue;
+        settling = true;
+        settleCount = 0;
+        settleHold = 0;
+    }
+    if (settling)
+    {
+        settleCount++;
+        if (clamp(error, -CONTROL_DEADBAND, CONTROL_DEADBAND) == error)
+            settleHold++;
+        else settleHold = 0;
+        if (settleHold >= SETTLE_HOLD)
+        {
+            settleResult = settleCount - SETTLE_HOLD;
+            settleAvailable = true;
+            settling = false;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Feedback step applied in the last regulator period
+
+@returns int32_t: duty cycle step in promille.
+*/
+
+int32_t controlModifier(void)
+{
+    return modifier;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Settling time of the last setpoint step
+
+@param[out] int32_t* periods: regulator periods taken to settle.
+@returns true if a new measurement is available. This is cleared on reading.
+*/
+
+bool controlSettlingTime(int32_t* periods)
+{
+    if (! settleAvailable) return false;
+    *periods = settleResult;
+    settleAvailable = false;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief PI gains at the present demand
+
+Schedule points are at the centres of equal bands of the buck duty cycle.
+Between two tuned points the gains are interpolated linearly, and beyond the
+outermost tuned point its gains are used. Without scheduling, or with no
+tuned points, the fixed gains are used.
+
+@param[out] Gains* gains: gains to use.
+*/
+
+RAMFUNC
+static void scheduledGains(Gains* gains)
+{
+    *gains = fixedGains;
+    if (! scheduleEnabled) return;
+    int32_t spacing = 1000/SCHEDULE_POINTS;
+    int32_t position = clamp(demand, 0, 1000);
+    int8_t lower = -1;
+    int8_t upper = -1;
+    int8_t point;
+    for (point = 0; point < SCHEDULE_POINTS; point++)
+    {
+        if (! schedule[point].valid) continue;
+        int32_t centre = point*spacing + spacing/2;
+        if (centre <= position) lower = point;
+        else if (upper < 0) upper = point;
+    }
+    if (lower < 0) lower = upper;
+    if (upper < 0) upper = lower;
+    if (lower < 0) return;
+    *gains = schedule[lower];
+    if (upper == lower) return;
+    int32_t span = (upper - lower)*spacing;
+    int32_t offset = position - (lower*spacing + spacing/2);
+    gains->proportional += interpolateGain(schedule[upper].proportional -
+                                           schedule[lower].proportional,
+                                           offset, span);
+    gains->integral += interpolateGain(schedule[upper].integral -
+                                       schedule[lower].integral,
+                                       offset, span);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Part of a gain difference
+
+This is difference*offset/span truncated as in 64 bit arithmetic, but formed
+from 32 bit divisions, which the processor does in hardware rather than by
+a library call from FLASH. The offset is less than the span, so neither
+product overflows.
+
+@param[in] int32_t difference: between the gains of two points.
+@param[in] int32_t offset: from the lower point, 0 to span.
+@param[in] int32_t span: between the points.
+@returns int32_t: difference*offset/span.
+*/
+
+RAMFUNC
+static int32_t interpolateGain(int32_t difference, int32_t offset,
+                               int32_t span)
+{
+    return (difference/span)*offset + ((difference%span)*offset)/span;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Restart the feedback on a change of gains
+
+The fractional step carried over was formed with the old gains, and is
+dropped. The next update takes its error as the last.
+*/
+
+static void restartFeedback(void)
+{
+    fraction = 0;
+    feedbackRestart = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Compute the feed-forward demand
+
+For a buck converter the ideal duty cycle is Vout/Vin. In buck-boost mode
+when the output exceeds the input, the boost duty cycle is 1 - Vin/Vout,
+given as a demand above the pass-through band.
+
+@param[in] int32_t outputVoltage: measured or modelled output voltage.
+@param[in] int32_t inputVoltage: measured input voltage.
+@returns int32_t: ideal demand in promille, or zero if the input voltage is
+         not available.
+*/
+
+RAMFUNC
+static int32_t feedForward(int32_t outputVoltage, int32_t inputVoltage)
+{
+    if (inputVoltage < FEEDFORWARD_MIN_INPUT) return 0;
+    if (outputVoltage < inputVoltage)
+        return clamp(mulSaturate(1000, outputVoltage, 0)/inputVoltage, 0, 1000);
+    if (controlMode != CONTROL_BUCK_BOOST) return 1000;
+    return clamp(BOOST_DEMAND + 1000 -
+                 mulSaturate(1000, inputVoltage, 0)/outputVoltage,
+                 BOOST_DEMAND, BOOST_DEMAND + BOOST_MAX);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Update the buck-boost operating region
+
+The pass-through region is entered when the demand is within the band, at
+most PASS_BAND from its centre, and left when it is more than twice PASS_BAND
+away. The region is reported only, and does not change the duty cycles.
+*/
+
+RAMFUNC
+static void updateRegion(void)
+{
+    switch (region)
+    {
+    case REGION_BUCK:
+        if (demand > PASS_CENTRE - PASS_BAND) region = REGION_PASS;
+        break;
+    case REGION_PASS:
+        if (demand < PASS_CENTRE - 2*PASS_BAND) region = REGION_BUCK;
+        else if (demand > PASS_CENTRE + 2*PASS_BAND) region = REGION_BOOST;
+        break;
+    default:
+        if (demand < PASS_CENTRE + PASS_BAND) region = REGION_PASS;
+        break;
+    }
+}
+
@@ -0,0 +1,87 @@
+/* STM32F1 SMPS Regulator
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Control modes */
+#define CONTROL_BUCK        0
+#define CONTROL_BUCK_BOOST  1
+#define CONTROL_MPPT        2   /* Buck from a solar panel, output limited */
+
+/* Buck-boost operating regions */
+#define REGION_BUCK         0
+#define REGION_PASS         1
+#define REGION_BOOST        2
+
+/* Half width of the pass-through region and maximum boost duty cycle,
+in promille */
+#define PASS_BAND           20
+#define BOOST_MAX           800
+
+/* Feed-forward modes */
+#define FEEDFORWARD_OFF     0
+#define FEEDFORWARD_VOLTAGE 1   /* Use the measured output voltage */
+#define FEEDFORWARD_LED     2   /* Setpoint is LED current, use I-V model */
+
+/* Error band within which the regulator nudges by one step, and within which
+the output is considered settled. */
+#define CONTROL_DEADBAND    10
+/* Number of regulator periods within the deadband to count as settled */
+#define SETTLE_HOLD         5
+/* Gain schedule points, spaced evenly over the buck duty cycle */
+#define SCHEDULE_POINTS     4
+/* Input voltage below which it is taken as not measured */
+#define FEEDFORWARD_MIN_INPUT 100
+/* Largest feed-forward change of the demand per period, in promille */
+#define FEEDFORWARD_SLEW    50
+/* LED model parameters set */
+#define LED_KNEE_SET        0x01
+#define LED_SLOPE_SET       0x02
+
+void controlInit(void);
+void controlSetGain(uint16_t divisor);
+void controlSetTuning(int16_t dutyCycle, int32_t proportional,
+                      int32_t integral);
+void controlSetSchedule(bool enable);
+void controlGains(int32_t* proportional, int32_t* integral);
+void controlSetMode(uint8_t mode);
+uint8_t controlGetMode(void);
+uint8_t controlRegion(void);
+bool controlSetFeedForward(uint8_t mode);
+void controlSetLedKnee(int32_t knee);
+void controlSetLedSlope(int32_t slope);
+void controlUpdate(int16_t* buckDutyCycle, int16_t* boostDutyCycle,
+                   int32_t setValue, int32_t isValue, int32_t inputVoltage,
+                   int32_t inputCurrent, int32_t outputVoltage);
+int32_t controlModifier(void);
+bool controlSettlingTime(int32_t* periods);
+
+#endif
+
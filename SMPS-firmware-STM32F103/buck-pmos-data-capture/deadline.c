@@ -0,0 +1,329 @@
+/* STM32F1 SMPS Control Loop Deadline Monitor
+
+The regulator runs from the main loop on every twelfth timer 2 compare, so
+command parsing or a burst of telemetry in the same loop can hold it back.
+The timer 2 compare flag then stays set until the loop comes round, and
+holding it for more than a scan loses the compare altogether. Each regulator
+activation is timestamped with the DWT cycle counter to find:
+
+- Lateness, from the timer 2 compare to the activation. This is beyond the
+  deadline limit when the loop held the regulator too long.
+- The period from the previous activation, and its difference from the
+  nominal twelve scans as the jitter. A period more than half a scan longer
+  than nominal has lost a compare, which also counts as a miss.
+
+Both are kept as histograms in bins doubling in width, with the number of
+misses and the longest run of them.
+
+Consecutive misses escalate. At the shedding threshold telemetry is dropped
+to free the loop, until the regulator has again kept to its deadline for a
+number of activations. At the safe threshold the PWM is held off, until
+cleared by command. Either threshold may be disabled.
+
+The records are sent a few lines at a time on request, leaving room in the
+transmit buffer for telemetry and acknowledgements. Everything runs in the
+main loop.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libopencm3/cm3/dwt.h>
+
+#include "deadline.h"
+#include "commslib.h"
+
+/*--------------------------------------------------------------------------*/
+/* Records since the last reset, and a copy being sent */
+
+static DeadlineRecord record;
+static DeadlineRecord sent;
+static uint8_t sendLine;
+static bool sending;
+
+/* Settings */
+static uint32_t limit;
+static uint8_t shedMisses;
+static uint8_t safeMisses;
+
+/* Escalation */
+static uint8_t level;
+static bool levelChanged;
+static uint32_t consecutive;
+static uint8_t onTime;
+
+/* Previous activation, and the compare it followed */
+static uint32_t lastActivation;
+static uint32_t lastCompare;
+static bool activated;
+
+static uint8_t histogramBin(uint32_t cycles);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise with the default limit and escalation
+
+*/
+
+void deadlineInit(void)
+{
+    dwt_enable_cycle_counter();
+    limit = DEADLINE_LIMIT;
+    shedMisses = DEADLINE_SHED_MISSES;
+    safeMisses = DEADLINE_SAFE_MISSES;
+    level = DEADLINE_NORMAL;
+    levelChanged = false;
+    consecutive = 0;
+    onTime = 0;
+    activated = false;
+    sending = false;
+    deadlineReset();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the records
+
+The escalation level is kept.
+*/
+
+void deadlineReset(void)
+{
+    uint8_t bin;
+    record.activations = 0;
+    record.misses = 0;
+    record.consecutiveMax = 0;
+    record.latenessMax = 0;
+    record.periodMin = UINT32_MAX;
+    record.periodMax = 0;
+    for (bin = 0; bin < DEADLINE_BINS; bin++)
+    {
+        record.lateness[bin] = 0;
+        record.jitter[bin] = 0;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Settings
+
+@param[in] uint32_t cycles: lateness beyond which an activation is a miss.
+@param[in] uint8_t misses: consecutive misses that escalate, 0 never.
+*/
+
+void deadlineSetLimit(uint32_t cycles)
+{
+    limit = cycles;
+}
+
+void deadlineSetShed(uint8_t misses)
+{
+    shedMisses = misses;
+}
+
+void deadlineSetSafe(uint8_t misses)
+{
+    safeMisses = misses;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record a regulator activation
+
+Called at the start of each regulator update, before anything else is done.
+
+@param[in] uint32_t lateness: cycles from the timer 2 compare to now.
+@returns uint8_t: escalation level, DEADLINE_SAFE to hold the PWM off.
+*/
+
+uint8_t deadlineActivate(uint32_t lateness)
+{
+    uint32_t now = DWT_CYCCNT;
+    uint32_t compare = now - lateness;
+    bool miss = (lateness > limit);
+    record.activations++;
+    if (lateness > record.latenessMax) record.latenessMax = lateness;
+    record.lateness[histogramBin(lateness)]++;
+    if (activated)
+    {
+        uint32_t period = now - lastActivation;
+        if (period < record.periodMin) record.periodMin = period;
+        if (period > record.periodMax) record.periodMax = period;
+        uint32_t jitter = (period > DEADLINE_PERIOD) ?
+                          period - DEADLINE_PERIOD : DEADLINE_PERIOD - period;
+        record.jitter[histogramBin(jitter)]++;
+        if (compare - lastCompare > DEADLINE_PERIOD + DEADLINE_SCAN/2)
+            miss = true;
+    }
+    lastActivation = now;
+    lastCompare = compare;
+    activated = true;
+
+    if (miss)
+    {
+        record.misses++;
+        consecutive++;
+        if (consecutive > record.consecutiveMax)
+            record.consecutiveMax = consecutive;
+        onTime = 0;
+    }
+    else
+    {
+        consecutive = 0;
+        if (onTime < DEADLINE_RECOVERY) onTime++;
+    }
+
+/* The safe level is left only by command */
+    uint8_t next = level;
+    if ((safeMisses > 0) && (consecutive >= safeMisses))
+        next = DEADLINE_SAFE;
+    else if (level == DEADLINE_SAFE) next = DEADLINE_SAFE;
+    else if ((shedMisses > 0) && (consecutive >= shedMisses))
+        next = DEADLINE_SHED;
+    else if ((level == DEADLINE_SHED) && (onTime >= DEADLINE_RECOVERY))
+        next = DEADLINE_NORMAL;
+    if (next != level)
+    {
+        level = next;
+        levelChanged = true;
+    }
+    return level;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Restart timing after the regulator was not run
+
+While capture is off or a waveform is played the regulator does not run, so
+the period up to its next activation is not measured.
+*/
+
+void deadlineRestart(void)
+{
+    activated = false;
+}
+
+/*--------------------------------------------------------------------------*/
+
+uint8_t deadlineLevel(void)
+{
+    return level;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Return to the normal level from shedding or safe
+
+The run of misses is ended and timing restarts at the next activation.
+*/
+
+void deadlineClear(void)
+{
+    if (level == DEADLINE_NORMAL) return;
+    level = DEADLINE_NORMAL;
+    levelChanged = true;
+    consecutive = 0;
+    deadlineRestart();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Report a change of escalation level once
+
+@param[out] uint8_t* newLevel: level now.
+@param[out] uint32_t* misses: consecutive misses.
+@returns bool: true the first time a change is seen.
+*/
+
+bool deadlineReport(uint8_t* newLevel, uint32_t* misses)
+{
+    if (! levelChanged) return false;
+    levelChanged = false;
+    *newLevel = level;
+    *misses = consecutive;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start sending the records
+
+The records are copied to be sent and cleared.
+*/
+
+void deadlineSend(void)
+{
+    sent = record;
+    deadlineReset();
+    if (sent.periodMin > sent.periodMax) sent.periodMin = 0;
+    sendLine = 0;
+    sending = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send the next lines of the records
+
+Called on each pass of the main loop. Times are in processor cycles.
+"jn, <activations>, <misses>", "jc, <longest run of misses>, <level>",
+"jm, <longest lateness>, <limit>" and "jp, <shortest>, <longest period>"
+are followed by each bin of the lateness histogram as
+"jl, <bin start>, <count>" then of the jitter histogram as
+"jj, <bin start>, <count>".
+*/
+
+void deadlineSendStep(void)
+{
+    while (sending && (commsTransmitSpace() > DEADLINE_HEADROOM))
+    {
+        bool queued;
+        uint8_t bin = (sendLine < 4) ? 0 : (sendLine - 4) % DEADLINE_BINS;
+        uint32_t start = (bin == 0) ? 0 : (1UL << (DEADLINE_BIN_SHIFT + bin));
+        if (sendLine == 0)
+            queued = dataMessageSend("jn", sent.activations, sent.misses);
+        else if (sendLine == 1)
+            queued = dataMessageSend("jc", sent.consecutiveMax, level);
+        else if (sendLine == 2)
+            queued = dataMessageSend("jm", sent.latenessMax, limit);
+        else if (sendLine == 3)
+            queued = dataMessageSend("jp", sent.periodMin, sent.periodMax);
+        else if (sendLine < 4 + DEADLINE_BINS)
+            queued = dataMessageSend("jl", start, sent.lateness[bin]);
+        else
+            queued = dataMessageSend("jj", start, sent.jitter[bin]);
+        if (! queued) return;
+        if (++sendLine >= 4 + 2*DEADLINE_BINS) sending = false;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Histogram bin of a time
+
+@param[in] uint32_t cycles: time.
+@returns uint8_t: bin.
+*/
+
+static uint8_t histogramBin(uint32_t cycles)
+{
+    uint8_t bin = 0;
+    cycles >>= DEADLINE_BIN_SHIFT + 1;
+    while ((cycles > 0) && (bin < DEADLINE_BINS - 1))
+    {
+        cycles >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
@@ -0,0 +1,84 @@
+/* STM32F1 SMPS Control Loop Deadline Monitor
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEADLINE_H_
+#define DEADLINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Times in processor clock cycles, which timer 2 also counts */
+#define DEADLINE_CLOCK_MHZ  72
+#define DEADLINE_SCAN       65536
+#define DEADLINE_PERIOD     (12*DEADLINE_SCAN)  /* Regulator, 12 scans */
+#define DEADLINE_LIMIT      (500*DEADLINE_CLOCK_MHZ)
+
+/* Histogram bins. Bin 0 is below 2^(DEADLINE_BIN_SHIFT+1) cycles, and each
+bin after it starts at twice the one before. The last starts at a scan. */
+#define DEADLINE_BINS       8
+#define DEADLINE_BIN_SHIFT  9
+
+/* Escalation, in consecutive misses, 0 never */
+#define DEADLINE_SHED_MISSES    3
+#define DEADLINE_SAFE_MISSES    0
+#define DEADLINE_RECOVERY       8   /* Activations in time ending shedding */
+
+/* Transmit buffer space kept free for telemetry and acknowledgements while
+the records are sent */
+#define DEADLINE_HEADROOM   128
+
+/* Levels */
+#define DEADLINE_NORMAL     0
+#define DEADLINE_SHED       1       /* Telemetry dropped */
+#define DEADLINE_SAFE       2       /* PWM off until cleared */
+
+/* Counts since the last reset */
+typedef struct {
+    uint32_t activations;
+    uint32_t misses;
+    uint32_t consecutiveMax;        /* Longest run of misses */
+    uint32_t latenessMax;
+    uint32_t periodMin;
+    uint32_t periodMax;
+    uint32_t lateness[DEADLINE_BINS];   /* From the timer 2 compare */
+    uint32_t jitter[DEADLINE_BINS];     /* Period from DEADLINE_PERIOD */
+} DeadlineRecord;
+
+void deadlineInit(void);
+void deadlineReset(void);
+void deadlineSetLimit(uint32_t cycles);
+void deadlineSetShed(uint8_t misses);
+void deadlineSetSafe(uint8_t misses);
+uint8_t deadlineActivate(uint32_t lateness);
+void deadlineRestart(void);
+uint8_t deadlineLevel(void);
+void deadlineClear(void);
+bool deadlineReport(uint8_t* level, uint32_t* consecutive);
+void deadlineSend(void);
+void deadlineSendStep(void);
+
+#endif
+
@@ -0,0 +1,154 @@
+/* STM32F1 SMPS Dead Time Optimiser
+
+In synchronous operation the dead time between the main switch and the
+synchronous rectifier is a trade-off between shoot-through and body diode
+conduction, and the best value depends on the MOSFETs and drivers of each
+board.
+
+The optimiser sweeps the TIM1 dead time over a range while the regulator
+holds the output, and for each value averages the ratio of input to output
+power. The dead time giving the lowest ratio, that is the lowest input power
+for the same output power, is selected at the end of the sweep.
+
+The optimiser is stepped once per regulator period and does not access the
+hardware; the caller applies the dead time returned.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "deadtime.h"
+#include "fixmath.h"
+
+/*--------------------------------------------------------------------------*/
+/* Optimiser state */
+
+static bool running;
+static uint8_t originalDeadtime;    /* Restored if the sweep fails */
+static uint8_t candidate;           /* Dead time being measured */
+static uint8_t periodCount;
+static int64_t lossSum;             /* Sum of power ratios for candidate */
+static uint8_t bestDeadtime;
+static int32_t bestLossRatio;
+static bool resultAvailable;
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start a dead time sweep
+
+@param[in] uint8_t deadtime: dead time in use, restored if no result.
+*/
+
+void deadtimeOptimiserStart(uint8_t deadtime)
+{
+    originalDeadtime = deadtime;
+    candidate = DEADTIME_MIN;
+    periodCount = 0;
+    lossSum = 0;
+    bestDeadtime = deadtime;
+    bestLossRatio = INT32_MAX;
+    resultAvailable = false;
+    running = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Abandon a dead time sweep
+
+The caller should restore the dead time given when the sweep started.
+*/
+
+void deadtimeOptimiserStop(void)
+{
+    running = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check if a sweep is in progress
+
+*/
+
+bool deadtimeOptimiserRunning(void)
+{
+    return running;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Step the dead time sweep
+
+Called once per regulator period while the sweep is running.
+
+@param[in] int32_t inputPower: measured input power.
+@param[in] int32_t outputPower: measured output power, same units.
+@returns uint8_t: dead time to apply.
+*/
+
+uint8_t deadtimeOptimiserUpdate(int32_t inputPower, int32_t outputPower)
+{
+    if (! running) return bestDeadtime;
+    periodCount++;
+    if (periodCount > DEADTIME_SETTLE)
+    {
+/* Input to output power ratio in Q10, treating no output as worst case */
+        int32_t lossRatio = INT32_MAX;
+        if (outputPower > 0)
+            lossRatio = saturate32(((int64_t)inputPower << 10)/outputPower);
+        lossSum += lossRatio;
+    }
+    if (periodCount < DEADTIME_SETTLE + DEADTIME_AVERAGE) return candidate;
+
+    int32_t averageLoss = (int32_t)(lossSum/DEADTIME_AVERAGE);
+    if (averageLoss < bestLossRatio)
+    {
+        bestLossRatio = averageLoss;
+        bestDeadtime = candidate;
+    }
+    periodCount = 0;
+    lossSum = 0;
+    if (candidate + DEADTIME_STEP <= DEADTIME_MAX)
+    {
+        candidate += DEADTIME_STEP;
+        return candidate;
+    }
+    running = false;
+    if (bestLossRatio == INT32_MAX) bestDeadtime = originalDeadtime;
+    else resultAvailable = true;
+    return bestDeadtime;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Result of the last completed sweep
+
+@param[out] uint8_t* deadtime: selected dead time.
+@param[out] int32_t* lossRatio: input to output power ratio in Q10.
+@returns true if a new result is available. This is cleared on reading.
+*/
+
+bool deadtimeOptimiserResult(uint8_t* deadtime, int32_t* lossRatio)
+{
+    if (! resultAvailable) return false;
+    *deadtime = bestDeadtime;
+    *lossRatio = bestLossRatio;
+    resultAvailable = false;
+    return true;
+}
+
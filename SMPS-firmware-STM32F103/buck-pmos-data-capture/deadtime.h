@@ -0,0 +1,50 @@
+/* STM32F1 SMPS Dead Time Optimiser
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEADTIME_H_
+#define DEADTIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Dead time sweep range and step, in TIM1 BDTR DTG counts. Values up to 127
+are linear at 13.9ns per count. The minimum is kept well away from zero to
+avoid shoot-through. */
+#define DEADTIME_MIN        10
+#define DEADTIME_MAX        100
+#define DEADTIME_STEP       5
+/* Regulator periods allowed to settle, then averaged, at each dead time */
+#define DEADTIME_SETTLE     20
+#define DEADTIME_AVERAGE    16
+
+void deadtimeOptimiserStart(uint8_t deadtime);
+void deadtimeOptimiserStop(void);
+bool deadtimeOptimiserRunning(void);
+uint8_t deadtimeOptimiserUpdate(int32_t inputPower, int32_t outputPower);
+bool deadtimeOptimiserResult(uint8_t* deadtime, int32_t* lossRatio);
+
+#endif
+
@@ -0,0 +1,206 @@
+/* STM32F1 SMPS Power and Energy Accounting
+
+The input and output power are integrated at the full ADC sample rate from
+each calibrated scan, along with the charge through each port. The sums are
+kept in 64 bit integers of uW and mA per sample, which do not overflow in any
+practical run time, and are converted to engineering units only when read.
+
+- Interval average power, read and restarted by the telemetry.
+- Energy (J) and charge (C) through each port since the last reset.
+- Efficiency as the ratio of output to input energy since the last reset.
+
+Accumulation is called from the ADC ISR. Readers take a copy of the sums with
+interrupts disabled, as 64 bit accesses are not atomic.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "energy.h"
+#include "fixmath.h"
+#include "ramfunc.h"
+
+/*--------------------------------------------------------------------------*/
+/* Accumulators, written by the ADC ISR */
+
+static volatile int64_t powerSum[ENERGY_PORTS];     /* uW per sample */
+static volatile int64_t chargeSum[ENERGY_PORTS];    /* mA per sample */
+static volatile uint32_t sampleCount;
+/* Start of the current telemetry interval */
+static int64_t intervalPowerSum[ENERGY_PORTS];
+static uint32_t intervalCount;
+
+static void snapshot(int64_t* power, int64_t* charge, uint32_t* count);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Reset all accumulators
+
+*/
+
+void energyReset(void)
+{
+    uint8_t port;
+    cm_disable_interrupts();
+    for (port = 0; port < ENERGY_PORTS; port++)
+    {
+        powerSum[port] = 0;
+        chargeSum[port] = 0;
+        intervalPowerSum[port] = 0;
+    }
+    sampleCount = 0;
+    intervalCount = 0;
+    cm_enable_interrupts();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Accumulate one sample
+
+Called from the ADC ISR with each calibrated scan.
+
+@param[in] int32_t inputVoltage: in mV.
+@param[in] int32_t inputCurrent: in mA.
+@param[in] int32_t outputVoltage: in mV.
+@param[in] int32_t outputCurrent: in mA.
+*/
+
+RAMFUNC
+void energyAccumulate(int32_t inputVoltage, int32_t inputCurrent,
+                      int32_t outputVoltage, int32_t outputCurrent)
+{
+    powerSum[ENERGY_INPUT] += (int64_t)inputVoltage*inputCurrent;
+    powerSum[ENERGY_OUTPUT] += (int64_t)outputVoltage*outputCurrent;
+    chargeSum[ENERGY_INPUT] += inputCurrent;
+    chargeSum[ENERGY_OUTPUT] += outputCurrent;
+    sampleCount++;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Average power over the interval since the last call
+
+@param[out] int32_t* inputPower: in mW.
+@param[out] int32_t* outputPower: in mW.
+*/
+
+void energyInterval(int32_t* inputPower, int32_t* outputPower)
+{
+    int64_t power[ENERGY_PORTS];
+    int64_t charge[ENERGY_PORTS];
+    uint32_t count;
+    snapshot(power, charge, &count);
+    uint32_t samples = count - intervalCount;
+    *inputPower = 0;
+    *outputPower = 0;
+    if (samples > 0)
+    {
+        *inputPower = saturate32((power[ENERGY_INPUT] -
+                                  intervalPowerSum[ENERGY_INPUT])/
+                                 ((int64_t)samples*1000));
+        *outputPower = saturate32((power[ENERGY_OUTPUT] -
+                                   intervalPowerSum[ENERGY_OUTPUT])/
+                                  ((int64_t)samples*1000));
+    }
+    intervalPowerSum[ENERGY_INPUT] = power[ENERGY_INPUT];
+    intervalPowerSum[ENERGY_OUTPUT] = power[ENERGY_OUTPUT];
+    intervalCount = count;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Energy and charge through a port since the last reset
+
+@param[in] uint8_t port: ENERGY_INPUT or ENERGY_OUTPUT.
+@param[out] int32_t* energy: in J.
+@param[out] int32_t* charge: in C.
+*/
+
+void energyTotal(uint8_t port, int32_t* energy, int32_t* charge)
+{
+    int64_t power[ENERGY_PORTS];
+    int64_t chargeTotal[ENERGY_PORTS];
+    uint32_t count;
+    snapshot(power, chargeTotal, &count);
+/* Scale uW to W before the period multiply to keep well inside 64 bits */
+    *energy = saturate32(((power[port]/1000000)*ENERGY_PERIOD_NUMERATOR)/
+                         ENERGY_PERIOD_DENOMINATOR);
+    *charge = saturate32(((chargeTotal[port]/1000)*ENERGY_PERIOD_NUMERATOR)/
+                         ENERGY_PERIOD_DENOMINATOR);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Time accumulated since the last reset
+
+@returns int32_t: time in seconds.
+*/
+
+int32_t energySeconds(void)
+{
+    return ((int64_t)sampleCount*ENERGY_PERIOD_NUMERATOR)/
+           ENERGY_PERIOD_DENOMINATOR;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Conversion efficiency since the last reset
+
+@returns int32_t: output to input energy in promille, zero if there has been
+         no input energy.
+*/
+
+int32_t energyEfficiency(void)
+{
+    int64_t power[ENERGY_PORTS];
+    int64_t charge[ENERGY_PORTS];
+    uint32_t count;
+    snapshot(power, charge, &count);
+    if (power[ENERGY_INPUT] <= 0) return 0;
+/* Drop precision from large sums so that the promille scaling fits */
+    while (power[ENERGY_INPUT] > (INT64_MAX/1000))
+    {
+        power[ENERGY_INPUT] >>= 1;
+        power[ENERGY_OUTPUT] >>= 1;
+    }
+    return saturate32((power[ENERGY_OUTPUT]*1000)/power[ENERGY_INPUT]);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Copy the accumulators
+
+@param[out] int64_t* power: power sums for each port.
+@param[out] int64_t* charge: charge sums for each port.
+@param[out] uint32_t* count: number of samples.
+*/
+
+static void snapshot(int64_t* power, int64_t* charge, uint32_t* count)
+{
+    uint8_t port;
+    cm_disable_interrupts();
+    for (port = 0; port < ENERGY_PORTS; port++)
+    {
+        power[port] = powerSum[port];
+        charge[port] = chargeSum[port];
+    }
+    *count = sampleCount;
+    cm_enable_interrupts();
+}
+
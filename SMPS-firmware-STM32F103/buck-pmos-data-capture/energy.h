@@ -0,0 +1,52 @@
+/* STM32F1 SMPS Power and Energy Accounting
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Accounted ports */
+#define ENERGY_INPUT        0
+#define ENERGY_OUTPUT       1
+#define ENERGY_PORTS        2
+
+/* Sample period in seconds as a fraction, 65536 counts of the 72 MHz timer 2
+clock */
+#define ENERGY_PERIOD_NUMERATOR     128
+#define ENERGY_PERIOD_DENOMINATOR   140625
+
+void energyReset(void);
+void energyAccumulate(int32_t inputVoltage, int32_t inputCurrent,
+                      int32_t outputVoltage, int32_t outputCurrent);
+void energyInterval(int32_t* inputPower, int32_t* outputPower);
+void energyTotal(uint8_t port, int32_t* energy, int32_t* charge);
+int32_t energySeconds(void);
+int32_t energyEfficiency(void);
+
+#endif
+
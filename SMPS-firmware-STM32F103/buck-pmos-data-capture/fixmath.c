@@ -0,0 +1,54 @@
+/* STM32F1 SMPS Fixed Point Arithmetic
+
+The reciprocal for division by a runtime constant d uses the method of
+Granlund and Montgomery. With l = ceil(log2(d)) and N = RECIPROCAL_BITS, the
+multiplier m = floor(2^(N+l)/d) + 1 is less than 2^(N+1), and floor(n*m/2^(N+l))
+equals floor(n/d) for all n < 2^N. The product fits in 64 bits, which the
+Cortex M3 forms with a single UMULL and, unlike UDIV, in constant time.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fixmath.h"
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set up a reciprocal for division by a runtime constant
+
+This involves a 64 bit division, so is done only when the divisor changes.
+
+@param[out] Reciprocal* reciprocal: multiplier and shift.
+@param[in] uint32_t divisor: non zero divisor.
+*/
+
+void reciprocalInit(Reciprocal* reciprocal, uint32_t divisor)
+{
+    uint8_t log2Divisor = 0;
+    while ((log2Divisor < 32) && (((uint64_t)1 << log2Divisor) < divisor))
+        log2Divisor++;
+    reciprocal->shift = RECIPROCAL_BITS + log2Divisor;
+    reciprocal->multiplier =
+        (uint32_t)((((uint64_t)1 << reciprocal->shift)/divisor) + 1);
+}
+
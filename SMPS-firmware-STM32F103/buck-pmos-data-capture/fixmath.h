@@ -0,0 +1,131 @@
+/* STM32F1 SMPS Fixed Point Arithmetic
+
+Saturating integer arithmetic, clamping and division by runtime constants
+through reciprocal multiplication, for the control and PWM computations.
+
+Q formats are written Qn where n is the number of fraction bits.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIXMATH_H_
+#define FIXMATH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The helpers are always inlined, as the code running from RAM would
+otherwise call them in FLASH when built for size */
+#define FIXMATH_INLINE      static inline __attribute__((always_inline))
+
+/* Numerators given to the reciprocal division must be less than this */
+#define RECIPROCAL_BITS     28
+#define RECIPROCAL_LIMIT    ((int32_t)1 << RECIPROCAL_BITS)
+
+/* Division by a runtime constant d as a multiply and shift. For any
+n < 2^RECIPROCAL_BITS, (n*multiplier) >> shift is exactly n/d. */
+typedef struct {
+    uint32_t multiplier;
+    uint8_t shift;
+} Reciprocal;
+
+void reciprocalInit(Reciprocal* reciprocal, uint32_t divisor);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Saturate a 64 bit value to 32 bits */
+
+FIXMATH_INLINE int32_t saturate32(int64_t value)
+{
+    if (value > INT32_MAX) return INT32_MAX;
+    if (value < INT32_MIN) return INT32_MIN;
+    return (int32_t)value;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Limit a value to an inclusive range */
+
+FIXMATH_INLINE int32_t clamp(int32_t value, int32_t minimum, int32_t maximum)
+{
+    if (value > maximum) return maximum;
+    if (value < minimum) return minimum;
+    return value;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Saturating addition and subtraction */
+
+FIXMATH_INLINE int32_t addSaturate(int32_t a, int32_t b)
+{
+    return saturate32((int64_t)a + b);
+}
+
+FIXMATH_INLINE int32_t subSaturate(int32_t a, int32_t b)
+{
+    return saturate32((int64_t)a - b);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Saturating multiply of two fixed point values
+
+The product is shifted right by the number of fraction bits to be removed,
+for example 16 for a Q16 by Q16 product giving Q16. The shift is arithmetic
+so negative results round towards minus infinity.
+*/
+
+FIXMATH_INLINE int32_t mulSaturate(int32_t a, int32_t b, uint8_t shift)
+{
+    return saturate32(((int64_t)a*b) >> shift);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Divide by a runtime constant
+
+@param[in] Reciprocal* reciprocal: set up by reciprocalInit for the divisor.
+@param[in] uint32_t numerator: must be less than 2^RECIPROCAL_BITS.
+@returns uint32_t: numerator/divisor rounded down.
+*/
+
+FIXMATH_INLINE uint32_t reciprocalDivide(const Reciprocal* reciprocal,
+                                         uint32_t numerator)
+{
+    return (uint32_t)(((uint64_t)numerator*reciprocal->multiplier) >>
+                      reciprocal->shift);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Divide a signed value by a runtime constant
+
+The numerator is clamped to +/-(2^RECIPROCAL_BITS - 1). The result is
+truncated towards zero as for C integer division.
+*/
+
+FIXMATH_INLINE int32_t reciprocalDivideSigned(const Reciprocal* reciprocal,
+                                              int32_t numerator)
+{
+    numerator = clamp(numerator, 1 - RECIPROCAL_LIMIT, RECIPROCAL_LIMIT - 1);
+    if (numerator < 0)
+        return -(int32_t)reciprocalDivide(reciprocal, -numerator);
+    return reciprocalDivide(reciprocal, numerator);
+}
+
+#endif
+
@@ -0,0 +1,117 @@
+/* STM32F1 SMPS FLASH Programming
+
+The parameter store and the calibration block are written to FLASH here. The
+processor stalls when FLASH is read while it is programmed or erased, so
+these functions run from RAM and wait there for the FLASH to finish. The
+vector table and the ISRs on the sampling and receive paths are in RAM too,
+so interrupts are still taken while a page is erased. Code in FLASH,
+including the main loop, is held until the wait ends.
+
+The registers are written directly, as the libopencm3 functions would be
+called in FLASH from here in RAM. The FLASH is left locked.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/stm32/flash.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "flashprog.h"
+#include "ramfunc.h"
+
+static void flashUnlock(void);
+static void flashWait(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Program a word
+
+The FLASH is programmed a half word at a time. The word must be erased.
+
+@param[in] const volatile uint32_t* address: word aligned FLASH address.
+@param[in] uint32_t data: value.
+*/
+
+RAMFUNC
+void flashProgramWord(const volatile uint32_t* address, uint32_t data)
+{
+    volatile uint16_t* halfWord = (volatile uint16_t*)address;
+    flashUnlock();
+    FLASH_CR |= FLASH_CR_PG;
+    halfWord[0] = data & 0xFFFF;
+    flashWait();
+    halfWord[1] = data >> 16;
+    flashWait();
+    FLASH_CR &= ~FLASH_CR_PG;
+    FLASH_CR |= FLASH_CR_LOCK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Erase a page
+
+Takes 20 to 40ms.
+
+@param[in] const volatile uint32_t* page: start of the FLASH page.
+*/
+
+RAMFUNC
+void flashErasePage(const volatile uint32_t* page)
+{
+    flashUnlock();
+    FLASH_CR |= FLASH_CR_PER;
+    FLASH_AR = (uint32_t)page;
+    FLASH_CR |= FLASH_CR_STRT;
+    flashWait();
+    FLASH_CR &= ~FLASH_CR_PER;
+    FLASH_CR |= FLASH_CR_LOCK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Unlock the FLASH controller once any operation has finished
+
+*/
+
+RAMFUNC
+static void flashUnlock(void)
+{
+    flashWait();
+    if (FLASH_CR & FLASH_CR_LOCK)
+    {
+        FLASH_KEYR = FLASH_KEYR_KEY1;
+        FLASH_KEYR = FLASH_KEYR_KEY2;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Wait in RAM for the FLASH to finish
+
+The end and error flags are cleared by writing ones. An error shows when the
+result is read back.
+*/
+
+RAMFUNC
+static void flashWait(void)
+{
+    while (FLASH_SR & FLASH_SR_BSY);
+    FLASH_SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+}
+
@@ -0,0 +1,164 @@
+/* STM32F1 SMPS Interrupt Latency Measurement
+
+Interrupt service routines and the regulator are timed with the DWT cycle
+counter, to compare code run from FLASH with code run from RAM.
+
+- Duration, from entry to exit.
+- Latency, from an event marked by the code that causes the interrupt to
+  entry. This is only available where the cause is known, as for the ADC
+  scan started by the main loop, and includes the fixed conversion time.
+
+Jitter is taken as the difference between the longest and shortest times.
+The entry and exit calls run from RAM so that their own cost does not depend
+on the placement being measured.
+
+Records are updated from the ISRs. Readers take a copy with interrupts
+disabled.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+
+#include "latency.h"
+#include "ramfunc.h"
+
+/*--------------------------------------------------------------------------*/
+/* Measurement records */
+
+static volatile LatencyRecord record[LATENCY_SOURCES];
+static volatile uint32_t markTime[LATENCY_SOURCES];
+static volatile bool marked[LATENCY_SOURCES];
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start the cycle counter and clear the records
+
+*/
+
+void latencyInit(void)
+{
+    dwt_enable_cycle_counter();
+    latencyReset();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the records
+
+*/
+
+void latencyReset(void)
+{
+    uint8_t source;
+    cm_disable_interrupts();
+    for (source = 0; source < LATENCY_SOURCES; source++)
+    {
+        record[source].count = 0;
+        record[source].latencyMin = UINT32_MAX;
+        record[source].latencyMax = 0;
+        record[source].durationMin = UINT32_MAX;
+        record[source].durationMax = 0;
+        marked[source] = false;
+    }
+    cm_enable_interrupts();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Mark the event that will cause an entry
+
+@param[in] uint8_t source: measured code.
+*/
+
+void latencyMark(uint8_t source)
+{
+    markTime[source] = DWT_CYCCNT;
+    marked[source] = true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record an entry
+
+The latency is recorded if an event was marked since the last entry.
+
+@param[in] uint8_t source: measured code.
+@returns uint32_t: entry time to be given at exit.
+*/
+
+RAMFUNC
+uint32_t latencyEnter(uint8_t source)
+{
+    uint32_t entry = DWT_CYCCNT;
+    if (marked[source])
+    {
+        uint32_t latency = entry - markTime[source];
+        if (latency < record[source].latencyMin)
+            record[source].latencyMin = latency;
+        if (latency > record[source].latencyMax)
+            record[source].latencyMax = latency;
+        marked[source] = false;
+    }
+    return entry;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record an exit
+
+@param[in] uint8_t source: measured code.
+@param[in] uint32_t entry: time returned at entry.
+*/
+
+RAMFUNC
+void latencyExit(uint8_t source, uint32_t entry)
+{
+    uint32_t duration = DWT_CYCCNT - entry;
+    if (duration < record[source].durationMin)
+        record[source].durationMin = duration;
+    if (duration > record[source].durationMax)
+        record[source].durationMax = duration;
+    record[source].count++;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Copy a record
+
+Times not yet measured are given as zero.
+
+@param[in] uint8_t source: measured code.
+@param[out] LatencyRecord* copy: the record.
+*/
+
+void latencyRead(uint8_t source, LatencyRecord* copy)
+{
+    cm_disable_interrupts();
+    copy->count = record[source].count;
+    copy->latencyMin = record[source].latencyMin;
+    copy->latencyMax = record[source].latencyMax;
+    copy->durationMin = record[source].durationMin;
+    copy->durationMax = record[source].durationMax;
+    cm_enable_interrupts();
+    if (copy->latencyMin > copy->latencyMax) copy->latencyMin = 0;
+    if (copy->durationMin > copy->durationMax) copy->durationMin = 0;
+}
+
@@ -0,0 +1,56 @@
+/* STM32F1 SMPS Interrupt Latency Measurement
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Measured code */
+#define LATENCY_ADC         0   /* ADC end of scan ISR */
+#define LATENCY_COMMS       1   /* USART2 ISR */
+#define LATENCY_CONTROL     2   /* Regulator update */
+#define LATENCY_SOURCES     3
+
+/* Times in processor clock cycles */
+typedef struct {
+    uint32_t count;
+    uint32_t latencyMin;        /* From the marked event to entry */
+    uint32_t latencyMax;
+    uint32_t durationMin;       /* From entry to exit */
+    uint32_t durationMax;
+} LatencyRecord;
+
+void latencyInit(void);
+void latencyReset(void);
+void latencyMark(uint8_t source);
+uint32_t latencyEnter(uint8_t source);
+void latencyExit(uint8_t source, uint32_t entry);
+void latencyRead(uint8_t source, LatencyRecord* record);
+
+#endif
+
@@ -0,0 +1,238 @@
+/* STM32F1 SMPS Light Load Operation
+
+At low load currents the switching losses, which scale with frequency, come
+to dominate the converter losses. Below a load threshold the PWM frequency is
+reduced in proportion to the load, down to a minimum. If the load falls
+further, below a quarter of the threshold, the converter changes to burst
+operation at the minimum frequency: a fixed number of PWM periods is switched
+and then a number of periods is skipped, increasing as the load falls.
+
+Transitions are made without disturbing the output:
+- The frequency is slewed a little each regulator period, slowly going down
+  and faster going back up. The duty cycle, and so the output in continuous
+  conduction, is unchanged by the frequency.
+- When the number of skipped periods changes, the duty cycle is rescaled so
+  that the average over a burst stays the same, and the regulator continues
+  from there.
+
+The light load state is stepped once per regulator period and does not access
+the hardware; the caller applies the frequency and burst settings. The load
+threshold is held as a reciprocal set when it changes, and the burst target is
+compared by multiplication, so the update only divides when the number of
+skipped periods changes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lightload.h"
+#include "fixmath.h"
+
+/*--------------------------------------------------------------------------*/
+/* Light load state */
+
+static int32_t threshold;           /* Load threshold, zero disabled */
+static Reciprocal thresholdDivisor; /* Set with the threshold */
+static uint16_t minimumFrequency;
+static uint8_t state;
+static uint16_t frequency;          /* Frequency in use, zero if full */
+static uint8_t burstOff;            /* Periods skipped after each burst */
+
+static void setBurstOff(uint8_t periods, int16_t* dutyCycle);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise light load operation
+
+*/
+
+void lightLoadInit(void)
+{
+    lightLoadSetThreshold(LIGHTLOAD_THRESHOLD);
+    minimumFrequency = LIGHTLOAD_FREQUENCY_MIN;
+    state = LIGHTLOAD_FULL;
+    frequency = 0;
+    burstOff = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the light load parameters
+
+The new values take effect at the next update.
+
+@param[in] int32_t loadThreshold: load below which the frequency is reduced,
+           zero to disable. Limited to LIGHTLOAD_THRESHOLD_MAX.
+@param[in] uint16_t lowestFrequency: lowest frequency in kHz.
+*/
+
+void lightLoadSetThreshold(int32_t loadThreshold)
+{
+    threshold = clamp(loadThreshold, 0, LIGHTLOAD_THRESHOLD_MAX);
+    if (threshold > 0) reciprocalInit(&thresholdDivisor, threshold);
+}
+
+void lightLoadSetMinimumFrequency(uint16_t lowestFrequency)
+{
+    minimumFrequency = lowestFrequency;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Step the light load state
+
+Called once per regulator period after the regulator update. In burst mode
+the duty cycle is adjusted to hold the average output when the number of
+skipped periods changes.
+
+@param[in] int32_t load: measured load current.
+@param[in] uint16_t fullFrequency: set PWM frequency in kHz.
+@param[in] bool burstAllowed: false if periods may not be skipped.
+@param[in,out] int16_t* dutyCycle: buck duty cycle in promille.
+*/
+
+void lightLoadUpdate(int32_t load, uint16_t fullFrequency, bool burstAllowed,
+                     int16_t* dutyCycle)
+{
+    int32_t lowest = minimumFrequency;
+    if (lowest > fullFrequency) lowest = fullFrequency;
+    if ((frequency == 0) || (frequency > fullFrequency))
+        frequency = fullFrequency;
+
+/* Target frequency in proportion to the load below the threshold. The
+numerator is below 2^28 as the load is below the limited threshold. */
+    int32_t target = fullFrequency;
+    if ((threshold > 0) && (load < threshold))
+    {
+        target = lowest;
+        if (load > 0)
+            target = clamp(reciprocalDivide(&thresholdDivisor,
+                                            fullFrequency*load),
+                           lowest, fullFrequency);
+    }
+
+    int32_t burstEnter = threshold/LIGHTLOAD_BURST_DIVISOR;
+    int32_t burstExit = burstEnter + burstEnter/4;
+    if (state == LIGHTLOAD_BURST)
+    {
+        if (! burstAllowed || (threshold <= 0) || (load > burstExit))
+        {
+            setBurstOff(0, dutyCycle);
+            state = LIGHTLOAD_FOLDBACK;
+        }
+        else
+        {
+/* Skipped periods follow the load one at a time, as long as the duty cycle
+can make up for them. The target is BURST_ON_PERIODS*(burstExit - load)/load
+limited to 1..BURST_OFF_MAX, compared against the periods skipped now by
+cross multiplying. */
+            int64_t excess = (int64_t)BURST_ON_PERIODS*(burstExit - load);
+            bool above = (burstOff < BURST_OFF_MAX) &&
+                ((load <= 0) || (burstOff < 1) ||
+                 (excess >= (int64_t)(burstOff + 1)*load));
+            bool below = (load > 0) && (burstOff > 1) &&
+                (excess < (int64_t)burstOff*load);
+            int32_t period = BURST_ON_PERIODS + burstOff;
+            bool headroom = (*dutyCycle*(period + 1) < 1000*period);
+            if (above && headroom)
+                setBurstOff(burstOff + 1, dutyCycle);
+            else if (below || ! headroom)
+            {
+                if (burstOff > 1) setBurstOff(burstOff - 1, dutyCycle);
+            }
+            return;
+        }
+    }
+
+    if (target < frequency)
+    {
+        frequency -= LIGHTLOAD_SLEW_DOWN;
+        if (frequency < target) frequency = target;
+    }
+    else if (target > frequency)
+    {
+        frequency += LIGHTLOAD_SLEW_UP;
+        if (frequency > target) frequency = target;
+    }
+    state = (frequency < fullFrequency) ? LIGHTLOAD_FOLDBACK : LIGHTLOAD_FULL;
+
+    if (burstAllowed && (threshold > 0) && (frequency == lowest) &&
+        (load < burstEnter) && (*dutyCycle*(BURST_ON_PERIODS + 1) <
+                                1000*BURST_ON_PERIODS))
+    {
+        setBurstOff(1, dutyCycle);
+        state = LIGHTLOAD_BURST;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Light load state
+
+@returns uint8_t: LIGHTLOAD_FULL, LIGHTLOAD_FOLDBACK or LIGHTLOAD_BURST.
+*/
+
+uint8_t lightLoadState(void)
+{
+    return state;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief PWM frequency to use
+
+@param[in] uint16_t fullFrequency: set PWM frequency in kHz.
+@returns uint16_t: frequency in kHz, never above the set frequency.
+*/
+
+uint16_t lightLoadFrequency(uint16_t fullFrequency)
+{
+    if ((frequency == 0) || (frequency > fullFrequency)) return fullFrequency;
+    return frequency;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Periods skipped after each burst
+
+@returns uint8_t: skipped PWM periods, zero for continuous switching. Each
+         burst is BURST_ON_PERIODS long.
+*/
+
+uint8_t lightLoadBurstOff(void)
+{
+    return burstOff;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Change the skipped periods
+
+The duty cycle is scaled by the change in the fraction of periods switched.
+
+@param[in] uint8_t periods: new number of skipped periods.
+@param[in,out] int16_t* dutyCycle: duty cycle in promille.
+*/
+
+static void setBurstOff(uint8_t periods, int16_t* dutyCycle)
+{
+    int32_t scaled = (*dutyCycle*(BURST_ON_PERIODS + periods))/
+                     (BURST_ON_PERIODS + burstOff);
+    *dutyCycle = clamp(scaled, 0, 1000);
+    burstOff = periods;
+}
+
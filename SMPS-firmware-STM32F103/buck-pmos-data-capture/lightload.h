@@ -0,0 +1,67 @@
+/* STM32F1 SMPS Light Load Operation
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIGHTLOAD_H_
+#define LIGHTLOAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Light load states */
+#define LIGHTLOAD_FULL      0   /* Switching at the set frequency */
+#define LIGHTLOAD_FOLDBACK  1   /* Frequency reduced with the load */
+#define LIGHTLOAD_BURST     2   /* Minimum frequency with skipped periods */
+
+/* Load threshold in mA below which the frequency folds back. Zero disables
+light load operation. */
+#define LIGHTLOAD_THRESHOLD 0
+/* Largest threshold in mA, keeping the frequency product within the range of
+the reciprocal division */
+#define LIGHTLOAD_THRESHOLD_MAX 100000
+/* Lowest foldback frequency in kHz */
+#define LIGHTLOAD_FREQUENCY_MIN 20
+/* Burst mode is entered below 1/LIGHTLOAD_BURST_DIVISOR of the threshold and
+left a quarter above that again. */
+#define LIGHTLOAD_BURST_DIVISOR 4
+/* Frequency change per regulator period in kHz, slow going down and fast
+coming back up */
+#define LIGHTLOAD_SLEW_DOWN 1
+#define LIGHTLOAD_SLEW_UP   10
+/* PWM periods switched in each burst, and most periods skipped after it */
+#define BURST_ON_PERIODS    4
+#define BURST_OFF_MAX       28
+
+void lightLoadInit(void);
+void lightLoadSetThreshold(int32_t threshold);
+void lightLoadSetMinimumFrequency(uint16_t lowestFrequency);
+void lightLoadUpdate(int32_t load, uint16_t fullFrequency, bool burstAllowed,
+                     int16_t* dutyCycle);
+uint8_t lightLoadState(void);
+uint16_t lightLoadFrequency(uint16_t fullFrequency);
+uint8_t lightLoadBurstOff(void);
+
+#endif
+
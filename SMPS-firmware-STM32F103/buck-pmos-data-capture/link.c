@@ -0,0 +1,237 @@
+/* STM32F1 SMPS Serial Link Rate Negotiation
+
+The serial link starts at the compiled rate BAUDRATE, which every host can
+use. A higher rate is then negotiated in three steps, so that both ends
+change together and the link is proven before it is relied on:
+
+- The host proposes a rate, 'ub'. The firmware checks that USART2 can make
+  it closely enough, replies and acknowledges at the old rate, and changes
+  once everything queued has been transmitted.
+- The host changes its own rate and asks for a test pattern, 'ut'. The
+  command arriving intact proves the direction from the host, and the
+  pattern, generated from the seed given, proves the direction to it.
+- The host confirms the rate, 'uc'.
+
+If the confirmation does not arrive in time, or a framing, noise or overrun
+error is received before it, the firmware returns to the old rate, and the
+host is to do the same. Once confirmed, repeated receive errors return the
+link to the compiled rate, as does a reset, and the host falls back to it
+when the board stops answering.
+
+The pattern is the printable ASCII characters from a linear congruential
+generator seeded by the host, with the separators ',' and ':' replaced by
+'U', whose alternating bits show up timing errors.
+
+Receive errors are counted from the USART ISR. Everything else runs in the
+main loop.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libopencm3/cm3/dwt.h>
+
+#include "link.h"
+#include "commslib.h"
+#include "ramfunc.h"
+#include "buck-pmos-data-capture.h"
+
+static uint32_t baseRate;           /* Compiled rate, fallen back to */
+static uint32_t rate;               /* In use */
+static uint32_t previousRate;       /* Before the one on trial */
+static uint32_t targetRate;         /* To change to when idle */
+static uint8_t state;
+
+static volatile uint32_t errors;    /* Since the trial or window started */
+static volatile uint32_t errorTotal;
+static uint32_t windowStart;
+
+static void linkChange(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise at the rate the USART was set up with
+
+@param[in] uint32_t initialRate: compiled rate.
+*/
+
+void linkInit(uint32_t initialRate)
+{
+    baseRate = initialRate;
+    rate = initialRate;
+    state = LINK_STEADY;
+    errors = 0;
+    errorTotal = 0;
+    windowStart = DWT_CYCCNT;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Propose a new rate
+
+The rate is accepted if the baud rate register gives it to within
+LINK_ERROR_PERCENT, and no change is already under way.
+
+@param[in] uint32_t newRate: rate in baud.
+@returns bool: true if the change will be made once the reply is sent.
+*/
+
+bool linkPropose(uint32_t newRate)
+{
+    if (state != LINK_STEADY) return false;
+    if ((newRate < LINK_RATE_MIN) || (newRate > LINK_RATE_MAX)) return false;
+    uint32_t divider = (LINK_CLOCK + newRate/2)/newRate;
+    uint32_t actual = LINK_CLOCK/divider;
+    uint32_t difference = (actual > newRate) ? actual - newRate :
+                                               newRate - actual;
+    if (difference*100 > newRate*LINK_ERROR_PERCENT) return false;
+    previousRate = rate;
+    targetRate = newRate;
+    state = LINK_PENDING;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Confirm the rate on trial
+
+@returns bool: false if no rate was on trial.
+*/
+
+bool linkConfirm(void)
+{
+    if (state != LINK_TRIAL) return false;
+    state = LINK_STEADY;
+    errors = 0;
+    windowStart = DWT_CYCCNT;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Generate the test pattern
+
+@param[in] uint16_t seed: from the host.
+@param[out] char* pattern: LINK_PATTERN_SIZE characters and a terminating 0.
+*/
+
+void linkPattern(uint16_t seed, char* pattern)
+{
+    uint32_t generator = seed;
+    uint8_t i;
+    for (i = 0; i < LINK_PATTERN_SIZE; i++)
+    {
+        generator = generator*1103515245 + 12345;
+        char character = '!' + (generator >> 16) % 94;
+        if ((character == ',') || (character == ':')) character = 'U';
+        pattern[i] = character;
+    }
+    pattern[LINK_PATTERN_SIZE] = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Count a receive error
+
+Called from the USART ISR on a framing, noise or overrun error.
+*/
+
+RAMFUNC
+void linkError(void)
+{
+    errors++;
+    errorTotal++;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Make changes of rate and watch for errors
+
+Called on each pass of the main loop. A fall back is reported at the rate
+fallen back to as "uf, <rate>, <errors>".
+*/
+
+void linkPoll(void)
+{
+    uint32_t now = DWT_CYCCNT;
+    if ((state == LINK_PENDING) || (state == LINK_REVERT))
+    {
+        if (! commsTransmitEmpty()) return;
+        linkChange();
+        windowStart = now;
+        if (state == LINK_PENDING)
+        {
+            state = LINK_TRIAL;
+            errors = 0;
+            return;
+        }
+        state = LINK_STEADY;
+        dataMessageSend("uf", rate, errors);
+        errors = 0;
+        return;
+    }
+    if (state == LINK_TRIAL)
+    {
+        if ((errors == 0) &&
+            (now - windowStart < LINK_TRIAL_TIME*LINK_CYCLES_MS)) return;
+        targetRate = previousRate;
+        state = LINK_REVERT;
+        return;
+    }
+/* Steady at a negotiated rate */
+    if (rate == baseRate) return;
+    if (errors >= LINK_ERROR_LIMIT)
+    {
+        targetRate = baseRate;
+        state = LINK_REVERT;
+    }
+    else if (now - windowStart >= LINK_ERROR_TIME*LINK_CYCLES_MS)
+    {
+        errors = 0;
+        windowStart = now;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+
+uint32_t linkRate(void)
+{
+    return rate;
+}
+
+uint32_t linkErrors(void)
+{
+    return errorTotal;
+}
+
+uint8_t linkState(void)
+{
+    return state;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Change to the target rate
+
+*/
+
+static void linkChange(void)
+{
+    usartSetRate(targetRate);
+    rate = targetRate;
+}
+
@@ -0,0 +1,67 @@
+/* STM32F1 SMPS Serial Link Rate Negotiation
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINK_H_
+#define LINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* USART2 runs from the 36 MHz APB1 clock with 16 times oversampling, so the
+baud rate register is the clock over the rate and is at least 16. */
+#define LINK_CLOCK          36000000
+#define LINK_RATE_MIN       9600
+#define LINK_RATE_MAX       (LINK_CLOCK/16)
+#define LINK_ERROR_PERCENT  2       /* Largest rate error accepted */
+
+/* Times in processor clock cycles */
+#define LINK_CYCLES_MS      72000
+#define LINK_TRIAL_TIME     2000    /* ms to confirm a new rate */
+#define LINK_ERROR_TIME     1000    /* ms over which errors are counted */
+#define LINK_ERROR_LIMIT    8       /* Errors in that time that fall back */
+
+/* Test pattern of printable characters other than the separators */
+#define LINK_PATTERN_SIZE   64
+
+/* States */
+#define LINK_STEADY         0
+#define LINK_PENDING        1       /* New rate once the transmitter is idle */
+#define LINK_TRIAL          2       /* New rate awaiting confirmation */
+#define LINK_REVERT         3       /* Falling back once the transmitter is
+                                       idle */
+
+void linkInit(uint32_t rate);
+bool linkPropose(uint32_t rate);
+bool linkConfirm(void);
+void linkPattern(uint16_t seed, char* pattern);
+void linkError(void);
+void linkPoll(void);
+uint32_t linkRate(void);
+uint32_t linkErrors(void);
+uint8_t linkState(void);
+
+#endif
+
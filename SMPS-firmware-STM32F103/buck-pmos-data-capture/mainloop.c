@@ -0,0 +1,346 @@
+/* STM32F1 SMPS Main Loop
+
+The work of the main loop apart from the hardware, so that the simulator's
+emulator and replay tool run the same code in the same order as the device:
+
+- mainLoopInit() sets the firmware state and initialises the modules once
+  the peripherals are set up.
+- mainLoopPass() is run on every pass of the loop. It actions and
+  acknowledges the command lines received, reports and sends a capture and
+  the deadline records, takes up a link rate change and, while capture is
+  off, writes the saved parameters changed. Running out of FLASH for the
+  saved parameters is reported.
+- mainLoopScan() is run at each timer 2 compare while capture is on. It runs
+  the regulator on every twelfth compare and the telemetry on every 202nd,
+  and returns the ADC to base rate scans after a burst capture. The caller
+  then starts the next ADC scan unless a burst is running.
+
+The caller measures the lateness of the compare, which the device reads from
+timer 2 and the simulator takes as none.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buffer.h"
+#include "stringlib.h"
+#include "commslib.h"
+#include "commands.h"
+#include "control.h"
+#include "calibration.h"
+#include "fixmath.h"
+#include "deadtime.h"
+#include "mppt.h"
+#include "lightload.h"
+#include "energy.h"
+#include "autotune.h"
+#include "profile.h"
+#include "waveform.h"
+#include "brightness.h"
+#include "latency.h"
+#include "acquisition.h"
+#include "deadline.h"
+#include "link.h"
+#include "store.h"
+#include "mainloop.h"
+#include "buck-pmos-data-capture.h"
+
+/*--------------------------------------------------------------------------*/
+/* Globals defined in the main program */
+extern uint32_t v[NUM_CHANNEL];
+extern volatile int32_t measured[NUM_CHANNEL];
+extern uint16_t dataBlockSize;
+extern uint8_t capture;
+extern uint16_t frequency;
+extern int16_t ch1DutyCycle;
+extern int16_t ch2DutyCycle;
+extern int32_t isValue, setValue;
+extern bool synchronous;
+extern uint8_t deadtime;
+
+/* Compares since the last regulator update and telemetry */
+static uint16_t comDelay;
+static uint16_t regDelay;
+/* Auto-tune result waiting to be reported */
+static AutotuneResult tune;
+static bool tuneReport;
+
+static void regulatorUpdate(uint16_t lateness);
+static void telemetrySend(void);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Main loop initialisation
+
+The PWM is set to safe values and then to the parameters saved before the
+last reset, if any.
+
+@param[in] uint32_t baud: serial rate set up.
+*/
+
+void mainLoopInit(uint32_t baud)
+{
+    uint8_t i;
+    capture = false;
+    dataBlockSize = DATA_BLOCK_SIZE;
+    synchronous = false;
+    deadtime = DEADTIME;
+    comDelay = 0;
+    regDelay = 0;
+    tuneReport = false;
+    commsInit();
+    controlInit();
+    calibrationInit();
+    lightLoadInit();
+    energyReset();
+    profileInit();
+    waveformInit();
+    brightnessInit();
+    latencyInit();
+    acquisitionInit();
+    deadlineInit();
+    linkInit(baud);
+    storeInit();
+
+    frequency = FREQUENCY;
+    ch1DutyCycle = 0;
+    ch2DutyCycle = 0;
+    timer1PWMsettings(frequency, ch1DutyCycle, ch2DutyCycle);
+    commandsRestore();
+
+/* Clear the data array for the first pass */
+    for (i = 0; i < NUM_CHANNEL; i++)
+    {
+        v[i] = 0;
+        measured[i] = 0;
+    }
+    commsPrintString("\nAll meow!\n");
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief One pass of the main loop
+*/
+
+void mainLoopPass(void)
+{
+/* Action all command lines completed by the receive ISR since the last
+pass, and acknowledge each with its sequence id. */
+    CommandRecord* command;
+    while ((command = commsNextCommand()) != NULL)
+    {
+        uint8_t status = command->status;
+        if (status == COMMAND_OK) status = parseCommand(command);
+        commsAcknowledge(command->sequence, status);
+        commsReleaseCommand();
+    }
+    uint16_t droppedSequence;
+    if (commsDroppedCommand(&droppedSequence))
+        commsAcknowledge(droppedSequence, COMMAND_DROPPED);
+
+/* A capture is reported as soon as it is held, and sent a few lines at a
+time when requested. */
+    uint8_t triggerCause;
+    int32_t excursion;
+    if (acquisitionReport(&triggerCause, &excursion))
+        dataMessageSend("rt", triggerCause, excursion);
+    acquisitionSendStep();
+
+/* Changes of the deadline escalation level are reported as they occur */
+    uint8_t escalation;
+    uint32_t misses;
+    if (deadlineReport(&escalation, &misses))
+        dataMessageSend("je", escalation, misses);
+    deadlineSendStep();
+
+/* A new serial link rate is taken up once the reply proposing it has gone,
+and dropped again if not confirmed or if receive errors persist */
+    linkPoll();
+
+/* Saved parameter changes are written on every pass while the regulator is
+not running, including erasing a full bank. Running out of slots is
+reported once. */
+    if (! capture) storePoll(false);
+    uint8_t pendingKeys;
+    if (storeReport(&pendingKeys))
+        dataMessageSend("kf", pendingKeys, storeFree());
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 2 compare while capture is on
+
+@param[in] uint16_t lateness: processor cycles since the compare.
+@returns bool: true if the next ADC scan is to be started.
+*/
+
+bool mainLoopScan(uint16_t lateness)
+{
+/* Waveform playback sets the PWM in place of the regulator. */
+    if (waveformRunning()) deadlineRestart();
+    else if (regDelay++ > 10) regulatorUpdate(lateness);
+
+/* Delay a bit more to slow down comms to once per second. Telemetry is
+held back while the regulator deadline is being missed. */
+    if ((comDelay++ > 200) && (deadlineLevel() == DEADLINE_NORMAL))
+    {
+        telemetrySend();
+        comDelay = 0;
+    }
+
+/* Once a burst capture has ended return the ADC to base rate scans. No
+scan is started while the burst runs. */
+    if (acquisitionState() == ACQUISITION_DRAIN)
+    {
+        adcBurstRestore();
+        acquisitionRestored();
+    }
+    return (acquisitionState() != ACQUISITION_BURST);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Regulator update, every 10 ms
+
+@param[in] uint16_t lateness: processor cycles since the compare.
+*/
+
+static void regulatorUpdate(uint16_t lateness)
+{
+/* Overload holds the PWM off once the deadline is missed too often */
+    bool safe = (deadlineActivate(lateness) == DEADLINE_SAFE);
+/* Profiles set the setpoint and channel 2 at the regulator rate */
+    profileUpdate();
+    int32_t profileSetting;
+    if (profileValue(PROFILE_SETPOINT, &profileSetting))
+        setValue = profileSetting;
+    if (profileValue(PROFILE_DUTY2, &profileSetting) &&
+        (controlGetMode() == CONTROL_BUCK))
+        ch2DutyCycle = clamp(profileSetting, 0, 1000);
+    isValue = measured[OUTPUT_CURRENT];
+/* The auto-tune relay replaces the regulator while it runs. The regulator
+continues from the duty cycle it leaves. */
+    if (safe)
+    {
+        ch1DutyCycle = 0;
+        ch2DutyCycle = 0;
+    }
+    else if (autotuneRunning())
+    {
+        ch1DutyCycle = autotuneUpdate(setValue, isValue);
+        if (autotuneResult(&tune))
+        {
+            controlSetTuning(tune.dutyCycle, tune.proportionalGain,
+                             tune.integralGain);
+            commandsSaveTuning(tune.dutyCycle, tune.proportionalGain,
+                               tune.integralGain);
+            tuneReport = true;
+        }
+    }
+    else
+    {
+        uint32_t controlEntry = latencyEnter(LATENCY_CONTROL);
+        controlUpdate(&ch1DutyCycle, &ch2DutyCycle, setValue, isValue,
+                      measured[INPUT_VOLTAGE], measured[INPUT_CURRENT],
+                      measured[OUTPUT_VOLTAGE]);
+        latencyExit(LATENCY_CONTROL, controlEntry);
+    }
+    if (deadtimeOptimiserRunning())
+    {
+        uint8_t newDeadtime = deadtimeOptimiserUpdate(
+            power(measured[INPUT_VOLTAGE], measured[INPUT_CURRENT]),
+            power(measured[OUTPUT_VOLTAGE], measured[OUTPUT_CURRENT]));
+        if (newDeadtime != deadtime)
+        {
+            deadtime = newDeadtime;
+            timer1SetDeadtime(deadtime);
+        }
+/* Only the dead time chosen at the end of the sweep is saved */
+        if (! deadtimeOptimiserRunning()) storeSet(STORE_DEADTIME, deadtime);
+    }
+/* Light load operation in the buck modes. Periods are not skipped in
+synchronous mode, where the low side switch would be left on. */
+    if (controlGetMode() != CONTROL_MPPT)
+    {
+        lightLoadUpdate(measured[OUTPUT_CURRENT], frequency,
+                        ! synchronous && (ch2DutyCycle == 0),
+                        &ch1DutyCycle);
+    }
+    timer1SetBurst(lightLoadBurstOff());
+    timer1PWMsettings(lightLoadFrequency(frequency), ch1DutyCycle,
+                      ch2DutyCycle);
+/* One saved parameter change is written straight after the update, so that
+the FLASH stall ends well before the next. An erase holds the PWM for a few
+periods, which is not counted as missing the deadline. */
+    if (storePoll(true)) deadlineRestart();
+    regDelay = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Telemetry, about once a second
+*/
+
+static void telemetrySend(void)
+{
+    sendResponse("Channel 1: ", measured[OUTPUT_CURRENT]);
+    sendResponse("Channel 2: ", measured[OUTPUT_VOLTAGE]);
+    sendResponse("Channel 3: ", measured[INPUT_VOLTAGE]);
+    sendResponse("Channel 4: ", measured[INPUT_CURRENT]);
+
+    sendResponse("isValue: ", isValue);
+    sendResponse("setValue: ", setValue);
+
+    sendResponse("modifier: ", controlModifier());
+    sendResponse("PWM: ", ch1DutyCycle);
+    if (controlGetMode() == CONTROL_BUCK_BOOST)
+    {
+        sendResponse("PWM 2: ", ch2DutyCycle);
+        sendResponse("region: ", controlRegion());
+    }
+    if (controlGetMode() == CONTROL_MPPT)
+        dataMessageSend("mppt", mpptPower(), mpptEfficiency());
+
+    int32_t inputPower, outputPower;
+    energyInterval(&inputPower, &outputPower);
+    dataMessageSend("pw", inputPower, outputPower);
+    sendResponse("ef: ", energyEfficiency());
+    if (lightLoadState() != LIGHTLOAD_FULL)
+        dataMessageSend("ll", lightLoadFrequency(frequency),
+                        lightLoadBurstOff());
+
+    int32_t settlingTime;
+    if (controlSettlingTime(&settlingTime))
+        sendResponse("settle: ", settlingTime);
+    if (profileRunning())
+        dataMessageSend("qp", profileRunning(),
+                        profileTime(PROFILE_SETPOINT));
+    if (tuneReport)
+    {
+        dataMessageSend("tu", tune.period, tune.ultimateGain);
+        dataMessageSend("tk", tune.dutyCycle, tune.plantGain);
+        dataMessageSend("pi", tune.proportionalGain, tune.integralGain);
+        tuneReport = false;
+    }
+    uint8_t bestDeadtime;
+    int32_t lossRatio;
+    if (deadtimeOptimiserResult(&bestDeadtime, &lossRatio))
+        dataMessageSend("dt", bestDeadtime, lossRatio);
+}
+
@@ -0,0 +1,233 @@
+/* STM32F1 SMPS Maximum Power Point Tracker
+
+The buck duty cycle is adjusted to draw the maximum power from a solar panel
+on the input. Raising the duty cycle draws more current and lowers the panel
+voltage.
+
+Input voltage and current are averaged over the tracking interval, after
+which the duty cycle is moved by one step using either:
+
+- Perturb and observe: keep moving in the same direction while the power
+  increases, otherwise reverse.
+- Incremental conductance: at the maximum power point dP/dV = I + V.dI/dV is
+  zero. If it is positive the panel voltage is raised by lowering the duty
+  cycle, if negative the duty cycle is raised. Within a tolerance band the
+  duty cycle is held, which avoids the continuous dither of P&O. With too
+  little current to resolve the conductance the panel is taken to be near
+  open circuit and the duty cycle is raised. If a step gives no measurable
+  voltage change the step is repeated.
+
+Tracking efficiency is estimated as the average input power over a report
+interval relative to the highest averaged power seen in the same interval.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mppt.h"
+#include "fixmath.h"
+#include "ramfunc.h"
+
+/*--------------------------------------------------------------------------*/
+/* Tracker state */
+
+static uint8_t algorithm;
+static int32_t step;
+static uint8_t rate;
+static uint8_t periodCount;
+static int32_t voltageSum;
+static int32_t currentSum;
+static int32_t lastVoltage;         /* Averages at the last tracking step */
+static int32_t lastCurrent;
+static int32_t lastPower;
+static int32_t direction;           /* +1 or -1 duty cycle direction */
+static int32_t lastChange;          /* Duty cycle change at the last step */
+static bool primed;                 /* Last values are valid */
+/* Efficiency estimate */
+static int64_t powerSum;
+static int32_t powerCount;
+static int32_t powerMaximum;
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the tracker
+
+*/
+
+void mpptInit(void)
+{
+    algorithm = MPPT_PERTURB_OBSERVE;
+    step = MPPT_STEP;
+    rate = MPPT_RATE;
+    mpptReset();
+    mpptEfficiency();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the tracking parameters
+
+@param[in] uint8_t trackingAlgorithm: MPPT_PERTURB_OBSERVE or
+           MPPT_INCREMENTAL_CONDUCTANCE.
+@param[in] int32_t dutyCycleStep: duty cycle step in promille.
+@param[in] uint8_t periods: regulator periods between tracking steps.
+*/
+
+void mpptSetAlgorithm(uint8_t trackingAlgorithm)
+{
+    algorithm = trackingAlgorithm;
+    mpptReset();
+}
+
+void mpptSetStep(int32_t dutyCycleStep)
+{
+    step = dutyCycleStep;
+}
+
+void mpptSetRate(uint8_t periods)
+{
+    rate = clamp(periods, 1, MPPT_RATE_MAX);
+    mpptReset();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Restart tracking
+
+Used when the duty cycle has been changed by something else, for example
+the output limit.
+*/
+
+RAMFUNC
+void mpptReset(void)
+{
+    periodCount = 0;
+    voltageSum = 0;
+    currentSum = 0;
+    direction = 1;
+    lastChange = 0;
+    primed = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Tracking update
+
+Called once per regulator period.
+
+@param[in] int32_t dutyCycle: present duty cycle in promille.
+@param[in] int32_t voltage: input voltage.
+@param[in] int32_t current: input current.
+@returns int32_t: new duty cycle, which is not limited.
+*/
+
+RAMFUNC
+int32_t mpptUpdate(int32_t dutyCycle, int32_t voltage, int32_t current)
+{
+    voltageSum += voltage;
+    currentSum += current;
+    if (++periodCount < rate) return dutyCycle;
+
+    voltage = voltageSum/rate;
+    current = currentSum/rate;
+    periodCount = 0;
+    voltageSum = 0;
+    currentSum = 0;
+    int32_t power = mulSaturate(voltage, current, 10);
+
+    powerSum += power;
+    powerCount++;
+    if (power > powerMaximum) powerMaximum = power;
+
+    if (! primed)
+    {
+        primed = true;
+        lastChange = direction*step;
+        dutyCycle += lastChange;
+    }
+    else if (algorithm == MPPT_INCREMENTAL_CONDUCTANCE)
+    {
+        int32_t deltaV = voltage - lastVoltage;
+        int32_t deltaI = current - lastCurrent;
+/* dP = I.dV + V.dI, with dP/dV having the sign of dP*dV. The tolerance is
+I.|dV|/MPPT_TOLERANCE, compared multiplied through to avoid a 64 bit
+division. */
+        int64_t deltaP = (int64_t)current*deltaV + (int64_t)voltage*deltaI;
+        int64_t tolerance = (int64_t)current*(deltaV < 0 ? -deltaV : deltaV);
+        int64_t scaledP = deltaP*MPPT_TOLERANCE;
+        int32_t change = 0;
+/* With too little current the panel is near open circuit */
+        if (current < MPPT_MIN_CURRENT) change = step;
+/* A voltage change too small to measure after a step: keep going. Otherwise
+a current change alone means the irradiance has changed. */
+        else if (deltaV == 0)
+        {
+            if (lastChange != 0) change = lastChange;
+            else if (deltaI > 0) change = -step;
+            else if (deltaI < 0) change = step;
+        }
+        else if ((scaledP > tolerance) || (scaledP < -tolerance))
+        {
+            if ((deltaP > 0) == (deltaV > 0)) change = -step;
+            else change = step;
+        }
+        dutyCycle += change;
+        lastChange = change;
+    }
+    else
+    {
+        if (power < lastPower) direction = -direction;
+        dutyCycle += direction*step;
+    }
+    lastVoltage = voltage;
+    lastCurrent = current;
+    lastPower = power;
+    return dutyCycle;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Averaged input power at the last tracking step
+
+@returns int32_t: power in units of voltage times current over 1024.
+*/
+
+int32_t mpptPower(void)
+{
+    return lastPower;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Tracking efficiency since the last call
+
+@returns int32_t: average over maximum power in promille, or zero if there
+         has been no tracking step.
+*/
+
+int32_t mpptEfficiency(void)
+{
+    int32_t efficiency = 0;
+    if ((powerCount > 0) && (powerMaximum > 0))
+        efficiency = (int32_t)((powerSum*1000)/powerCount/powerMaximum);
+    powerSum = 0;
+    powerCount = 0;
+    powerMaximum = 0;
+    return efficiency;
+}
+
@@ -0,0 +1,59 @@
+/* STM32F1 SMPS Maximum Power Point Tracker
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPPT_H_
+#define MPPT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Tracking algorithms */
+#define MPPT_PERTURB_OBSERVE            0
+#define MPPT_INCREMENTAL_CONDUCTANCE    1
+
+/* Default duty cycle step in promille and tracking interval in regulator
+periods */
+#define MPPT_STEP           5
+#define MPPT_RATE           4
+#define MPPT_RATE_MAX       100
+/* Incremental conductance treats dP/dV as zero within 1/MPPT_TOLERANCE of
+the input current */
+#define MPPT_TOLERANCE      32
+/* Below this input current (mA) the panel is taken to be near open circuit,
+where the conductance cannot be resolved */
+#define MPPT_MIN_CURRENT    20
+
+void mpptInit(void);
+void mpptSetAlgorithm(uint8_t algorithm);
+void mpptSetStep(int32_t step);
+void mpptSetRate(uint8_t periods);
+void mpptReset(void);
+int32_t mpptUpdate(int32_t dutyCycle, int32_t voltage, int32_t current);
+int32_t mpptPower(void);
+int32_t mpptEfficiency(void);
+
+#endif
+
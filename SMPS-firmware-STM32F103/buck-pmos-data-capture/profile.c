@@ -0,0 +1,311 @@
+/* STM32F1 SMPS Setpoint Profile Player
+
+Lighting sequences are uploaded as tables of keyframes, each a time from the
+start of the profile in regulator periods and a value, for each of the
+channel 1 setpoint and the channel 2 duty cycle. The player then sets the
+values at the regulator rate, interpolating between keyframes with a step,
+a straight line or an eased (smoothstep) curve.
+
+Before the first keyframe its value is held. At the last keyframe a channel
+either stops, leaving the last value in place to be changed by command, or
+loops back to time zero. Channels
+started by the same command share a start period and so stay synchronised.
+
+The player is stepped once per regulator period and does not access the
+hardware; the caller reads the values and applies them.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "profile.h"
+#include "fixmath.h"
+
+/*--------------------------------------------------------------------------*/
+/* Profile tables and player state */
+
+typedef struct {
+    int32_t time;
+    int32_t value;
+} Keyframe;
+
+typedef struct {
+    Keyframe keyframe[PROFILE_KEYFRAMES];
+    uint8_t length;
+    uint8_t interpolation;
+    bool loop;
+    bool running;
+    bool valid;                     /* A value has been computed */
+    uint8_t segment;                /* Keyframe at the end of the segment */
+    int32_t time;
+    int32_t value;
+} Profile;
+
+static Profile profile[PROFILE_CHANNELS];
+
+static int32_t interpolate(const Profile* channel);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the player
+
+All profiles are cleared and set to linear interpolation without looping.
+*/
+
+void profileInit(void)
+{
+    uint8_t channel;
+    for (channel = 0; channel < PROFILE_CHANNELS; channel++)
+    {
+        profileClear(channel);
+        profile[channel].interpolation = PROFILE_LINEAR;
+        profile[channel].loop = false;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the keyframes of a channel
+
+The channel is stopped.
+
+@param[in] uint8_t channel: PROFILE_SETPOINT or PROFILE_DUTY2.
+*/
+
+void profileClear(uint8_t channel)
+{
+    if (channel >= PROFILE_CHANNELS) return;
+    profile[channel].length = 0;
+    profile[channel].running = false;
+    profile[channel].valid = false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Append a keyframe
+
+Keyframes must be given in order of increasing time. The channel is stopped
+while its table changes.
+
+@param[in] uint8_t channel: PROFILE_SETPOINT or PROFILE_DUTY2.
+@param[in] int32_t time: regulator periods from the start of the profile.
+@param[in] int32_t value: value at that time.
+@returns true if the keyframe was added, false if the table is full or the
+         time is not after the last keyframe.
+*/
+
+bool profileAddKeyframe(uint8_t channel, int32_t time, int32_t value)
+{
+    if (channel >= PROFILE_CHANNELS) return false;
+    Profile* table = &profile[channel];
+    if (table->length >= PROFILE_KEYFRAMES) return false;
+    if ((time < 0) || (time > PROFILE_TIME_MAX)) return false;
+    if ((table->length > 0) &&
+        (time <= table->keyframe[table->length - 1].time)) return false;
+    table->running = false;
+    table->keyframe[table->length].time = time;
+    table->keyframe[table->length].value = value;
+    table->length++;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the interpolation and looping of a channel
+
+@param[in] uint8_t channel: PROFILE_SETPOINT or PROFILE_DUTY2.
+@param[in] uint8_t interpolation: PROFILE_STEP, PROFILE_LINEAR or
+           PROFILE_EASED.
+@param[in] bool loop: restart at time zero after the last keyframe.
+*/
+
+void profileSetInterpolation(uint8_t channel, uint8_t interpolation)
+{
+    if (channel < PROFILE_CHANNELS)
+        profile[channel].interpolation = interpolation;
+}
+
+void profileSetLoop(uint8_t channel, bool loop)
+{
+    if (channel < PROFILE_CHANNELS) profile[channel].loop = loop;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start channels together
+
+Each channel in the mask restarts at time zero. Other channels carry on.
+
+@param[in] uint8_t channelMask: bit n set to start channel n.
+@returns false if a channel in the mask has no keyframes. None are started.
+*/
+
+bool profileStart(uint8_t channelMask)
+{
+    uint8_t channel;
+    for (channel = 0; channel < PROFILE_CHANNELS; channel++)
+    {
+        if ((channelMask & (1 << channel)) && (profile[channel].length == 0))
+            return false;
+    }
+    for (channel = 0; channel < PROFILE_CHANNELS; channel++)
+    {
+        if ((channelMask & (1 << channel)) == 0) continue;
+        profile[channel].time = 0;
+        profile[channel].segment = 0;
+        profile[channel].value = profile[channel].keyframe[0].value;
+        profile[channel].valid = true;
+        profile[channel].running = true;
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Stop all channels
+
+The values are left where they are.
+*/
+
+void profileStop(void)
+{
+    uint8_t channel;
+    for (channel = 0; channel < PROFILE_CHANNELS; channel++)
+    {
+        profile[channel].running = false;
+        profile[channel].valid = false;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Channels running
+
+@returns uint8_t: bit n set if channel n is running.
+*/
+
+uint8_t profileRunning(void)
+{
+    uint8_t mask = 0;
+    uint8_t channel;
+    for (channel = 0; channel < PROFILE_CHANNELS; channel++)
+        if (profile[channel].running) mask |= (1 << channel);
+    return mask;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Step the running channels
+
+Called once per regulator period, before the regulator.
+*/
+
+void profileUpdate(void)
+{
+    uint8_t channel;
+    for (channel = 0; channel < PROFILE_CHANNELS; channel++)
+    {
+        Profile* table = &profile[channel];
+/* A finished channel gave its last value in the period it finished */
+        if (! table->running)
+        {
+            table->valid = false;
+            continue;
+        }
+        int32_t end = table->keyframe[table->length - 1].time;
+        table->time++;
+        if (table->time > end)
+        {
+            if (table->loop && (end > 0))
+            {
+                table->time = 0;
+                table->segment = 0;
+            }
+            else
+            {
+                table->time = end;
+                table->running = false;
+            }
+        }
+        while ((table->segment < table->length - 1) &&
+               (table->time >= table->keyframe[table->segment].time))
+            table->segment++;
+        table->value = interpolate(table);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Value of a channel
+
+The value is available from the start of the channel until it finishes, up
+to and including the period that gives the last value, or is stopped with
+profileStop. The caller keeps the last value applied.
+
+@param[in] uint8_t channel: PROFILE_SETPOINT or PROFILE_DUTY2.
+@param[out] int32_t* value: current value.
+@returns true if the channel has a value to apply.
+*/
+
+bool profileValue(uint8_t channel, int32_t* value)
+{
+    if ((channel >= PROFILE_CHANNELS) || ! profile[channel].valid)
+        return false;
+    *value = profile[channel].value;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Time of a channel
+
+@param[in] uint8_t channel: PROFILE_SETPOINT or PROFILE_DUTY2.
+@returns int32_t: regulator periods since the start or last loop.
+*/
+
+int32_t profileTime(uint8_t channel)
+{
+    if (channel >= PROFILE_CHANNELS) return 0;
+    return profile[channel].time;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Interpolate the value at the present time
+
+The segment runs from the keyframe before the segment index to the keyframe
+at it. Before the first keyframe, and after the last, the value is held.
+
+@param[in] Profile* channel: channel state.
+@returns int32_t: interpolated value.
+*/
+
+static int32_t interpolate(const Profile* channel)
+{
+    const Keyframe* next = &channel->keyframe[channel->segment];
+    if ((channel->segment == 0) || (channel->time >= next->time))
+        return next->value;
+    const Keyframe* last = &channel->keyframe[channel->segment - 1];
+    if (channel->interpolation == PROFILE_STEP) return last->value;
+/* Position through the segment in Q16, eased as 3x^2 - 2x^3 */
+    int32_t position = ((int64_t)(channel->time - last->time) << 16)/
+                       (next->time - last->time);
+    if (channel->interpolation == PROFILE_EASED)
+    {
+        int32_t square = mulSaturate(position, position, 16);
+        position = mulSaturate(square, (3 << 16) - 2*position, 16);
+    }
+    return last->value + (int32_t)(((int64_t)(next->value - last->value)*
+                                    position) >> 16);
+}
+
@@ -0,0 +1,60 @@
+/* STM32F1 SMPS Setpoint Profile Player
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Profile channels */
+#define PROFILE_SETPOINT    0   /* Channel 1 regulator setpoint */
+#define PROFILE_DUTY2       1   /* Channel 2 duty cycle, in buck mode */
+#define PROFILE_CHANNELS    2
+
+/* Interpolation between keyframes */
+#define PROFILE_STEP        0   /* Hold each value until the next keyframe */
+#define PROFILE_LINEAR      1
+#define PROFILE_EASED       2   /* Smoothstep, zero slope at keyframes */
+
+/* Keyframes per channel and longest keyframe time in regulator periods */
+#define PROFILE_KEYFRAMES   32
+#define PROFILE_TIME_MAX    360000
+
+void profileInit(void);
+void profileClear(uint8_t channel);
+bool profileAddKeyframe(uint8_t channel, int32_t time, int32_t value);
+void profileSetInterpolation(uint8_t channel, uint8_t interpolation);
+void profileSetLoop(uint8_t channel, bool loop);
+bool profileStart(uint8_t channelMask);
+void profileStop(void);
+uint8_t profileRunning(void);
+void profileUpdate(void);
+bool profileValue(uint8_t channel, int32_t* value);
+int32_t profileTime(uint8_t channel);
+
+#endif
+
@@ -0,0 +1,72 @@
+/* STM32F1 SMPS RAM Resident Code
+
+At 72MHz the FLASH needs two wait states. The prefetch buffer hides these for
+straight line code, but every taken branch and literal load stalls, which
+lengthens the interrupt service routines that run at the sampling rate.
+Functions marked RAMFUNC are linked to run from SRAM, which has no wait
+states, and are held in FLASH after the initialised data until copied here.
+
+The libopencm3 reset handler only copies .data, so the copy is made at the
+start of main before any interrupt is enabled.
+
+The vector table is copied to RAM at the same time and VTOR pointed at it, so
+that the vector fetch on exception entry does not go to FLASH either. Entry
+to a RAM resident ISR is then the 12 cycles of the Cortex-M3 rather than
+about 14 to 17 with the vector read through the FLASH wait states, and it is
+no longer held off while the FLASH is programmed or erased.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/vector.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ramfunc.h"
+
+/* Section limits from the linker script */
+extern uint32_t _ramfunc, _eramfunc, _ramfunc_loadaddr;
+
+/* VTOR needs the table aligned to its size rounded up to a power of two */
+static vector_table_t ramVectors
+    __attribute__ ((aligned(RAMFUNC_VECTOR_ALIGN)));
+
+/*--------------------------------------------------------------------------*/
+/** @brief Copy the RAM resident code and the vector table from FLASH
+
+The section is word aligned at both ends in the linker script. The barriers
+make sure the new table is in use before any interrupt is enabled. Built with
+RAMFUNC=0 the table is left in FLASH for comparison.
+*/
+
+void ramfuncCopy(void)
+{
+    volatile uint32_t* source = &_ramfunc_loadaddr;
+    volatile uint32_t* destination = &_ramfunc;
+    while (destination < &_eramfunc) *destination++ = *source++;
+    if (! RAMFUNC_ENABLED) return;
+    ramVectors = vector_table;
+    SCB_VTOR = (uint32_t)&ramVectors;
+    __asm__ volatile ("dsb\n\tisb" ::: "memory");
+}
+
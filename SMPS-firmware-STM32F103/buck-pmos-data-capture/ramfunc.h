@@ -0,0 +1,53 @@
+/* STM32F1 SMPS RAM Resident Code
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RAMFUNC_H_
+#define RAMFUNC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Place a function in the .ramfunc section, which is copied to RAM at
+startup. Calls between FLASH and RAM are beyond the reach of a BL and are
+made through veneers added by the linker. Everything a RAMFUNC calls on its
+hot path is to be RAMFUNC too or inlined, and must avoid libgcc helpers such
+as 64 bit division, which run from FLASH. Build with RAMFUNC=0 to leave
+everything in FLASH for comparison. */
+#ifdef RAMFUNC_DISABLE
+#define RAMFUNC
+#define RAMFUNC_ENABLED     false
+#else
+#define RAMFUNC __attribute__((section(".ramfunc")))
+#define RAMFUNC_ENABLED     true
+#endif
+
+/* 16 system and 68 interrupt vectors of the STM32F103, 336 bytes */
+#define RAMFUNC_VECTOR_ALIGN    512
+
+void ramfuncCopy(void);
+
+#endif
+
@@ -0,0 +1,254 @@
+/* STM32F1 SMPS Switching Ripple Spectrum
+
+The ripple on an ADC input at the PWM switching frequency and its harmonics
+is measured on the device from a block of samples, so that only the
+amplitude and phase of each harmonic need be sent.
+
+The switching frequency is above the rate of the ADC, so the block is
+sampled in equivalent time. The PWM period is divided into a number of
+equal steps, and samples are taken a whole number of steps apart, that
+number being coprime with the steps in the period. With the ripple repeating
+every PWM period, the block then holds every step of one period in a
+scrambled order, repeated over several passes to average the noise. Timer 3
+triggers the conversions, and as it runs from the same clock as timer 1 the
+sampling stays locked to the PWM over the block.
+
+Each harmonic falls exactly on a bin of the block, which the Goertzel
+algorithm evaluates alone at far less cost than a complete transform. The
+bin is converted to amplitude and phase by CORDIC. The sine and arctangent
+tables are generated on the host at build time by table-gen, so no floating
+point is needed on the device.
+
+The number of steps is the largest divisor of the PWM period in timer counts
+that fits in a block. Harmonics up to half that number are resolved, which
+for most frequencies covers all those reported, but a period with no large
+divisors resolves fewer.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spectrum.h"
+
+static uint32_t greatestDivisor(uint32_t a, uint32_t b);
+static int32_t sine(uint32_t phase);
+static void cordicVector(int32_t x, int32_t y, uint32_t* magnitude,
+                         uint32_t* phase);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Plan the sampling of a block
+
+@param[in] uint32_t cycle: PWM period in timer counts, twice the timer 1
+           period register in centre aligned mode.
+@param[out] SpectrumPlan* plan: steps, sample interval and block length.
+*/
+
+void spectrumPlan(uint32_t cycle, SpectrumPlan* plan)
+{
+    uint16_t points = SPECTRUM_BLOCK_SIZE;
+    while ((points > 1) && ((cycle % points) != 0)) points--;
+    uint32_t step = cycle/points;
+/* The fewest steps between samples that the ADC can keep up with */
+    uint32_t advance = (SPECTRUM_SAMPLE_MIN + step - 1)/step;
+    while (greatestDivisor(advance, points) != 1) advance++;
+    plan->cycle = cycle;
+    plan->points = points;
+    plan->advance = advance;
+    plan->samplePeriod = advance*step;
+    uint32_t passes = SPECTRUM_CAPTURE_MAX/
+                      ((uint32_t)points*plan->samplePeriod);
+    if (passes > SPECTRUM_BLOCK_SIZE/points)
+        passes = SPECTRUM_BLOCK_SIZE/points;
+    if (passes < 1) passes = 1;
+    plan->count = passes*points;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Harmonics resolved by a plan
+
+Harmonics at or above half the steps in a period alias onto lower ones.
+
+@param[in] SpectrumPlan* plan: from spectrumPlan.
+@returns uint8_t: number of harmonics that may be given to spectrumBin.
+*/
+
+uint8_t spectrumHarmonics(const SpectrumPlan* plan)
+{
+    uint16_t harmonics = (plan->points - 1)/2;
+    if (harmonics > SPECTRUM_HARMONICS) harmonics = SPECTRUM_HARMONICS;
+    return harmonics;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Amplitude and phase of one harmonic
+
+The Goertzel recurrence is run over the block at the bin where the harmonic
+falls, after removing the mean to keep the state small. As the block holds a
+whole number of cycles of the bin, the final state gives the bin of the
+discrete Fourier transform exactly. Its phase is moved from the first sample
+to the PWM counter at zero, the middle of the off time.
+
+@param[in] uint16_t* samples: ADC counts in the order taken.
+@param[in] SpectrumPlan* plan: with which the samples were taken.
+@param[in] uint32_t start: timer counts from the PWM counter at zero to the
+           first sample.
+@param[in] uint8_t harmonic: 1 for the switching frequency.
+@param[out] SpectrumBin* bin: amplitude and phase.
+*/
+
+void spectrumBin(const uint16_t* samples, const SpectrumPlan* plan,
+                 uint32_t start, uint8_t harmonic, SpectrumBin* bin)
+{
+    uint16_t n;
+    uint32_t sum = 0;
+    for (n = 0; n < plan->count; n++) sum += samples[n];
+    int32_t mean = (sum + plan->count/2)/plan->count;
+
+/* Turns advanced by the harmonic from one sample to the next, in Q32 */
+    uint32_t binIndex = ((uint32_t)harmonic*plan->advance) % plan->points;
+    uint32_t omega = (uint32_t)(((uint64_t)binIndex << 32)/plan->points);
+    int32_t cosine = sine(omega + 0x40000000);
+    int32_t sineOmega = sine(omega);
+
+    int32_t state1 = 0;
+    int32_t state2 = 0;
+    for (n = 0; n < plan->count; n++)
+    {
+        int32_t state = samples[n] - mean +
+                        (int32_t)(((int64_t)cosine*state1) >> 29) - state2;
+        state2 = state1;
+        state1 = state;
+    }
+/* X = exp(j omega) state1 - state2 */
+    int32_t real = (int32_t)(((int64_t)cosine*state1) >> 30) - state2;
+    int32_t imaginary = (int32_t)(((int64_t)sineOmega*state1) >> 30);
+
+    uint32_t magnitude;
+    uint32_t phase;
+    cordicVector(real, imaginary, &magnitude, &phase);
+/* A sinusoid of amplitude A gives a bin of A*count/2 */
+    bin->amplitude = (uint32_t)(((uint64_t)magnitude << 9)/plan->count);
+    uint32_t startPhase = (uint32_t)(((uint64_t)start << 32)/plan->cycle);
+    bin->phase = phase - harmonic*startPhase;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Greatest common divisor */
+
+static uint32_t greatestDivisor(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Sine by table lookup
+
+@param[in] uint32_t phase: turns in Q32.
+@returns int32_t: sine in Q30.
+*/
+
+static int32_t sine(uint32_t phase)
+{
+    uint32_t quarter = phase >> 30;
+    uint32_t position = phase & 0x3FFFFFFF;
+    if ((quarter & 1) != 0) position = 0x40000000 - position;
+    uint32_t index = position >> (30 - SPECTRUM_SINE_BITS);
+    uint32_t fraction = (position >> (14 - SPECTRUM_SINE_BITS)) & 0xFFFF;
+    int32_t value = spectrumSine[index];
+    if (index < SPECTRUM_SINE_SIZE - 1)
+        value += (int32_t)(((int64_t)(spectrumSine[index + 1] - value)*
+                            fraction) >> 16);
+    return ((quarter & 2) != 0) ? -value : value;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Magnitude and angle of a vector by CORDIC
+
+The vector is scaled up to near full range for precision, turned into the
+right half plane, then rotated onto the x axis in steps of atan(2^-i),
+accumulating the angle turned.
+
+@param[in] int32_t x, y: vector.
+@param[out] uint32_t* magnitude: length of the vector.
+@param[out] uint32_t* phase: angle from the x axis in Q32 turns.
+*/
+
+static void cordicVector(int32_t x, int32_t y, uint32_t* magnitude,
+                         uint32_t* phase)
+{
+    *magnitude = 0;
+    *phase = 0;
+    if ((x == 0) && (y == 0)) return;
+/* Leave room for the CORDIC gain of 1.65 over a diagonal */
+    int8_t shift = 0;
+    while ((x < (1 << 28)) && (x > -(1 << 28)) &&
+           (y < (1 << 28)) && (y > -(1 << 28)))
+    {
+        x <<= 1;
+        y <<= 1;
+        shift++;
+    }
+    while ((x >= (1 << 29)) || (x <= -(1 << 29)) ||
+           (y >= (1 << 29)) || (y <= -(1 << 29)))
+    {
+        x >>= 1;
+        y >>= 1;
+        shift--;
+    }
+    uint32_t angle = 0;
+    if (x < 0)
+    {
+        x = -x;
+        y = -y;
+        angle = 0x80000000;
+    }
+    uint8_t i;
+    for (i = 0; i < SPECTRUM_CORDIC_STEPS; i++)
+    {
+        int32_t xStep = x >> i;
+        int32_t yStep = y >> i;
+        if (y > 0)
+        {
+            x += yStep;
+            y -= xStep;
+            angle += spectrumArctan[i];
+        }
+        else
+        {
+            x -= yStep;
+            y += xStep;
+            angle -= spectrumArctan[i];
+        }
+    }
+    uint32_t length = (uint32_t)(((uint64_t)x*SPECTRUM_CORDIC_SCALE) >> 30);
+    *magnitude = (shift >= 0) ? length >> shift : length << -shift;
+    *phase = angle;
+}
+
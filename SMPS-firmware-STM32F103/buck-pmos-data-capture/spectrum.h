@@ -0,0 +1,80 @@
+/* STM32F1 SMPS Switching Ripple Spectrum
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Timer 1 and 3 clock, in Hz */
+#define SPECTRUM_TIMER_CLOCK    72000000
+/* Most samples in a block */
+#define SPECTRUM_BLOCK_SIZE     256
+/* Harmonics of the switching frequency reported, at most */
+#define SPECTRUM_HARMONICS      8
+/* Shortest sample interval in timer counts. A conversion with 7.5 cycles
+sampling takes 20 ADC clocks of 8 counts, and some margin is left. */
+#define SPECTRUM_SAMPLE_MIN     168
+/* Longest block in timer counts, 10 ms */
+#define SPECTRUM_CAPTURE_MAX    720000
+
+/* Quarter wave sine table, indexed by the top bits of the phase within the
+quarter and interpolated */
+#define SPECTRUM_SINE_BITS      8
+#define SPECTRUM_SINE_SIZE      ((1 << SPECTRUM_SINE_BITS) + 1)
+/* CORDIC iterations, and the reciprocal of their gain in Q30 */
+#define SPECTRUM_CORDIC_STEPS   20
+#define SPECTRUM_CORDIC_SCALE   652032874
+
+/* Equivalent time sampling of a block. Each sample is taken a whole number
+of sample steps later in the PWM period than the one before, so that the
+block visits every step. */
+typedef struct {
+    uint32_t cycle;         /* PWM period in timer counts */
+    uint16_t points;        /* Sample steps in a PWM period */
+    uint16_t advance;       /* Steps between samples, coprime with points */
+    uint16_t samplePeriod;  /* Timer counts between samples */
+    uint16_t count;         /* Samples, a whole number of passes */
+} SpectrumPlan;
+
+typedef struct {
+    uint32_t amplitude;     /* ADC counts in Q8 */
+    uint32_t phase;         /* Turns in Q32, from the PWM counter at zero */
+} SpectrumBin;
+
+/* Sine of the first quarter turn in Q30, and the CORDIC angles atan(2^-i)
+in Q32 turns, from tables.c */
+extern const int32_t spectrumSine[SPECTRUM_SINE_SIZE];
+extern const uint32_t spectrumArctan[SPECTRUM_CORDIC_STEPS];
+
+void spectrumPlan(uint32_t cycle, SpectrumPlan* plan);
+uint8_t spectrumHarmonics(const SpectrumPlan* plan);
+void spectrumBin(const uint16_t* samples, const SpectrumPlan* plan,
+                 uint32_t start, uint8_t harmonic, SpectrumBin* bin);
+
+#endif
+
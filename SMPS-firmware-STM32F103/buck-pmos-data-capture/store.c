@@ -0,0 +1,420 @@
+/* STM32F1 SMPS Parameter Store
+
+Operating parameters are kept over a reset in the last two pages of FLASH
+(see the store region in the linker script), so that a board comes back as
+it was last set rather than needing its configuration sent again.
+
+The store is a log. Each change is appended as a record of the key and its
+value with a CRC, and the latest record of a key is its value. Records fill
+one bank while the other is kept erased, and when the bank is full the live
+values are copied to the other bank, whose header is written last with a
+later generation so that the copy replaces the full bank only when complete.
+The full bank is erased later. Every word of both banks is so programmed in
+turn before a page is erased again, which spreads the wear.
+
+At reset the bank with the later generation is read into an index in RAM of
+the value of each key, from which all lookups are made. A record that fails
+its CRC, as when power failed while it was written, is ignored.
+
+Changes are made to the index at once and written to FLASH later by
+storePoll(). The processor stalls when FLASH is read while it is programmed
+or erased, so the writes are made by flashprog.c from RAM, where the
+interrupts continue to be taken. The main loop runs from FLASH and waits. While
+the regulator runs one record (about 200us) is written after each regulator
+update, to be done long before the next. A page erase takes 20 to 40ms,
+longer than a regulator period, so while the regulator runs it is put off
+until a change has no free slot to go to. The PWM then holds its duty cycle
+for the erase.
+
+If a bank cannot be erased, or a copy cannot be completed, the store has run
+out of slots. The changes then wait in the index and are lost at a reset.
+This is reported once by storeReport(), and no more erases are tried until
+the board is reset.
+
+Everything runs in the main loop.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "store.h"
+#include "flashprog.h"
+
+/*--------------------------------------------------------------------------*/
+/* The banks in FLASH. They are not loaded with the firmware, so the values
+survive reprogramming, and are volatile as they are changed by FLASH
+programming. */
+__attribute__ ((section(".storeBlock"), aligned(STORE_PAGE_SIZE)))
+const volatile uint32_t storePages[STORE_BANKS][STORE_BANK_WORDS] =
+    { [0 ... STORE_BANKS - 1] =
+        { [0 ... STORE_BANK_WORDS - 1] = STORE_ERASED } };
+
+/* Bit of a key in the masks */
+#define STORE_BIT(key)      ((uint64_t)1 << (key))
+
+/* Index of the latest value of each key, a bit per key */
+static int32_t values[STORE_KEYS];
+static uint64_t present;
+static uint64_t pending;            /* Changed and not yet written */
+
+/* Bank in use, -1 if none, and the one kept erased */
+static int8_t current;
+static uint8_t spare;
+static uint32_t generation;
+static uint16_t next;               /* Free slot of the current bank */
+static bool erased[STORE_BANKS];
+
+/* Copy of the live values to the spare bank */
+static bool copying;
+static uint8_t copyKey;
+static uint16_t copyNext;
+
+/* Out of slots, and reported */
+static bool failed;
+static bool failReported;
+
+static bool storeRecord(uint8_t bank, uint16_t slot, uint8_t key);
+static void storeCopyStep(void);
+static bool storeProgram(uint8_t bank, uint16_t slot, uint32_t first,
+                         uint32_t second);
+static void storeErase(uint8_t bank);
+static bool bankErased(uint8_t bank);
+static uint16_t crc16(uint16_t field, int32_t value);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Build the index from the current bank
+
+*/
+
+void storeInit(void)
+{
+    uint8_t bank;
+    present = 0;
+    pending = 0;
+    current = -1;
+    generation = 0;
+    copying = false;
+    failed = false;
+    failReported = false;
+    for (bank = 0; bank < STORE_BANKS; bank++)
+    {
+        erased[bank] = bankErased(bank);
+        if (storePages[bank][0] != STORE_MAGIC) continue;
+        uint32_t bankGeneration = storePages[bank][1];
+        if ((current < 0) || ((int32_t)(bankGeneration - generation) > 0))
+        {
+            current = bank;
+            generation = bankGeneration;
+        }
+    }
+/* With no bank in use start with an erased one if there is one */
+    if (current < 0) spare = erased[0] ? 0 : 1;
+    else spare = 1 - current;
+    next = STORE_SLOTS;
+    if (current < 0) return;
+
+    uint16_t slot;
+    for (slot = 1; slot < STORE_SLOTS; slot++)
+    {
+        uint32_t first = storePages[current][2*slot];
+        int32_t value = storePages[current][2*slot + 1];
+        if ((first == STORE_ERASED) && (value == (int32_t)STORE_ERASED))
+        {
+            next = slot;
+            break;
+        }
+        uint16_t field = first & 0xFFFF;
+        uint16_t key = field & ~STORE_REMOVED;
+        if (((first >> 16) != crc16(field, value)) ||
+            (key >= STORE_KEYS)) continue;
+        if (field & STORE_REMOVED) present &= ~STORE_BIT(key);
+        else
+        {
+            values[key] = value;
+            present |= STORE_BIT(key);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Look up a value
+
+@param[in] uint8_t key: key.
+@param[out] int32_t* value: value, unchanged if none.
+@returns bool: true if the key has a value.
+*/
+
+bool storeGet(uint8_t key, int32_t* value)
+{
+    if ((key >= STORE_KEYS) || ! (present & STORE_BIT(key))) return false;
+    *value = values[key];
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Change a value
+
+The change is written later. Setting the value already held does nothing.
+
+@param[in] uint8_t key: key.
+@param[in] int32_t value: value.
+*/
+
+void storeSet(uint8_t key, int32_t value)
+{
+    if (key >= STORE_KEYS) return;
+    uint64_t bit = STORE_BIT(key);
+    if ((present & bit) && (values[key] == value)) return;
+    values[key] = value;
+    present |= bit;
+    pending |= bit;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Remove a value, so that the default is used after a reset
+
+@param[in] uint8_t key: key.
+*/
+
+void storeRemove(uint8_t key)
+{
+    if (key >= STORE_KEYS) return;
+    uint64_t bit = STORE_BIT(key);
+    if (! (present & bit)) return;
+    present &= ~bit;
+    pending |= bit;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write a change, copy or erase a bank
+
+Called on each pass of the main loop while the regulator is not running,
+and after each regulator update while it is. At most one record or one page
+erase is written on each call.
+
+@param[in] bool regulating: the regulator is running, so a page is only
+           erased when a change is waiting for it.
+@returns bool: true if a page was erased, holding the main loop for 20 to
+         40ms.
+*/
+
+bool storePoll(bool regulating)
+{
+    if (copying)
+    {
+        storeCopyStep();
+        return false;
+    }
+    bool full = (current < 0) || (next >= STORE_SLOTS);
+    if (! erased[spare] && ! failed &&
+        (! regulating || (full && (pending != 0))))
+    {
+        storeErase(spare);
+        return true;
+    }
+    if (pending == 0) return false;
+/* Start a bank, or move to the other when full */
+    if (full)
+    {
+        if (! erased[spare]) return false;
+        copying = true;
+        copyKey = 0;
+        copyNext = 1;
+        return false;
+    }
+    uint8_t key = 0;
+    while (! (pending & STORE_BIT(key))) key++;
+    if (storeRecord(current, next++, key)) pending &= ~STORE_BIT(key);
+    return false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Report running out of slots
+
+@param[out] uint8_t* pendingKeys: changes that cannot be written.
+@returns bool: true once when the store has run out of slots.
+*/
+
+bool storeReport(uint8_t* pendingKeys)
+{
+    if (! failed || failReported) return false;
+    failReported = true;
+    *pendingKeys = storePending();
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Records that can be added before the bank is full
+
+@returns uint16_t: free slots of the current bank, 0 if none in use.
+*/
+
+uint16_t storeFree(void)
+{
+    if (current < 0) return 0;
+    return STORE_SLOTS - next;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Changes not yet written
+
+@returns uint8_t: number of keys.
+*/
+
+uint8_t storePending(void)
+{
+    uint8_t count = 0;
+    uint64_t bits = pending;
+    while (bits != 0)
+    {
+        count += bits & 1;
+        bits >>= 1;
+    }
+    return count;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write the record of a key from the index
+
+@param[in] uint8_t bank: bank.
+@param[in] uint16_t slot: free slot.
+@param[in] uint8_t key: key, recorded as removed if it has no value.
+@returns bool: true if the record verifies.
+*/
+
+static bool storeRecord(uint8_t bank, uint16_t slot, uint8_t key)
+{
+    uint16_t field = key;
+    int32_t value = values[key];
+    if (! (present & STORE_BIT(key)))
+    {
+        field |= STORE_REMOVED;
+        value = 0;
+    }
+    return storeProgram(bank, slot, ((uint32_t)crc16(field, value) << 16) |
+                                    field, value);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Copy the next live value to the spare bank
+
+Removed keys are left out. When all are copied the header is written, and
+the spare bank becomes the current one.
+*/
+
+static void storeCopyStep(void)
+{
+    while ((copyKey < STORE_KEYS) && ! (present & STORE_BIT(copyKey)))
+        pending &= ~STORE_BIT(copyKey++);
+    if (copyKey < STORE_KEYS)
+    {
+        pending &= ~STORE_BIT(copyKey);
+        if (! storeRecord(spare, copyNext++, copyKey))
+            pending |= STORE_BIT(copyKey);
+        copyKey++;
+        return;
+    }
+    copying = false;
+/* The full bank stays current and the changes wait */
+    if (! storeProgram(spare, 0, STORE_MAGIC, generation + 1))
+    {
+        pending |= present;
+        failed = true;
+        return;
+    }
+    generation++;
+    next = copyNext;
+    if (current < 0) current = 1 - spare;
+    uint8_t full = current;
+    current = spare;
+    spare = full;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Program two words and check them
+
+@param[in] uint8_t bank: bank.
+@param[in] uint16_t slot: slot.
+@param[in] uint32_t first: first word.
+@param[in] uint32_t second: second word.
+@returns bool: true if both verify.
+*/
+
+static bool storeProgram(uint8_t bank, uint16_t slot, uint32_t first,
+                         uint32_t second)
+{
+    erased[bank] = false;
+    flashProgramWord(&storePages[bank][2*slot], first);
+    flashProgramWord(&storePages[bank][2*slot + 1], second);
+    return (storePages[bank][2*slot] == first) &&
+           (storePages[bank][2*slot + 1] == second);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Erase a bank
+
+@param[in] uint8_t bank: bank.
+*/
+
+static void storeErase(uint8_t bank)
+{
+    flashErasePage(storePages[bank]);
+    erased[bank] = bankErased(bank);
+    if (! erased[bank]) failed = true;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static bool bankErased(uint8_t bank)
+{
+    uint16_t word;
+    for (word = 0; word < STORE_BANK_WORDS; word++)
+        if (storePages[bank][word] != STORE_ERASED) return false;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief CRC-16-CCITT of a record
+
+@param[in] uint16_t field: key and flag.
+@param[in] int32_t value: value.
+@returns uint16_t: CRC of the field then the value, each LSB first.
+*/
+
+static uint16_t crc16(uint16_t field, int32_t value)
+{
+    uint8_t bytes[6] = {field & 0xFF, field >> 8, value & 0xFF,
+                        (value >> 8) & 0xFF, (value >> 16) & 0xFF,
+                        (value >> 24) & 0xFF};
+    uint16_t crc = 0xFFFF;
+    uint8_t i, bit;
+    for (i = 0; i < sizeof(bytes); i++)
+    {
+        crc ^= (uint16_t)bytes[i] << 8;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
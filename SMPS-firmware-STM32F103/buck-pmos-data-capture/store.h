@@ -0,0 +1,90 @@
+/* STM32F1 SMPS Parameter Store
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STORE_H_
+#define STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "control.h"
+#include "brightness.h"
+
+/* Two banks of one 1K FLASH page each, in the store region of the linker
+script. Each bank holds a header and records in slots of two words. */
+#define STORE_PAGE_SIZE     1024
+#define STORE_BANKS         2
+#define STORE_BANK_WORDS    (STORE_PAGE_SIZE/4)
+#define STORE_SLOTS         (STORE_BANK_WORDS/2)
+
+/* Header of a bank in use. The bank with the later generation is current. */
+#define STORE_MAGIC         0x50415231
+
+/* A record is the key and its CRC in the first word, key in the low half, and
+the value in the second. A removed key is recorded with this flag. */
+#define STORE_REMOVED       0x8000
+#define STORE_ERASED        0xFFFFFFFF
+
+/* Keys. Each schedule point of the regulator keeps the duty cycle and gains
+of its last tune. */
+#define STORE_FREQUENCY     0
+#define STORE_SETPOINT      1
+#define STORE_DUTY_CYCLE_1  2
+#define STORE_DUTY_CYCLE_2  3
+#define STORE_GAIN_DIVISOR  4
+#define STORE_SCHEDULE      5
+#define STORE_CONTROL_MODE  6
+#define STORE_FEEDFORWARD   7
+#define STORE_SYNCHRONOUS   8
+#define STORE_DEADTIME      9
+#define STORE_TUNE_LAST     10  /* Schedule point of the last tune */
+#define STORE_TUNE_DUTY(point)          (11 + 3*(point))
+#define STORE_TUNE_PROPORTIONAL(point)  (12 + 3*(point))
+#define STORE_TUNE_INTEGRAL(point)      (13 + 3*(point))
+/* Keys added since follow the tunes, so that saved values keep their keys.
+Each brightness channel keeps its curve and full scale. There are at most 64
+keys. */
+#define STORE_LED_KNEE      STORE_TUNE_DUTY(SCHEDULE_POINTS)
+#define STORE_LED_SLOPE     (STORE_LED_KNEE + 1)
+#define STORE_LIGHTLOAD     (STORE_LED_KNEE + 2)
+#define STORE_LIGHTLOAD_FREQUENCY   (STORE_LED_KNEE + 3)
+#define STORE_MPPT_ALGORITHM        (STORE_LED_KNEE + 4)
+#define STORE_MPPT_STEP     (STORE_LED_KNEE + 5)
+#define STORE_MPPT_RATE     (STORE_LED_KNEE + 6)
+#define STORE_BRIGHTNESS_CURVE(channel)     (STORE_LED_KNEE + 7 + 2*(channel))
+#define STORE_BRIGHTNESS_SCALE(channel)     (STORE_LED_KNEE + 8 + 2*(channel))
+#define STORE_KEYS          STORE_BRIGHTNESS_CURVE(BRIGHTNESS_CHANNELS)
+
+void storeInit(void);
+bool storeGet(uint8_t key, int32_t* value);
+void storeSet(uint8_t key, int32_t value);
+void storeRemove(uint8_t key);
+bool storePoll(bool regulating);
+bool storeReport(uint8_t* pendingKeys);
+uint16_t storeFree(void);
+uint8_t storePending(void);
+
+#endif
+
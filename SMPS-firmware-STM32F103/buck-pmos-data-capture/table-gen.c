@@ -0,0 +1,176 @@
+/* SMPS Lookup Table Generator
+
+Runs on the build host and writes the C source of the constant lookup tables
+used by the firmware to standard output, so that the tables can be computed
+in floating point without any on the device. The Makefile builds and runs it
+to produce tables.c.
+
+- Brightness curves, the output fraction of full scale in Q16 for each
+  perceptual level, at BRIGHTNESS_TABLE_SIZE points from level 0 to 65536.
+  - Gamma: Y = L^2.2.
+  - CIE 1976 L*: Y = ((L*100 + 16)/116)^3 above L*100 = 8, and
+    L*100/903.3 below, with the level L from 0 to 1.
+- Spectrum analysis, the sine of the first quarter turn in Q30 at
+  SPECTRUM_SINE_SIZE points, and the CORDIC angles atan(2^-i) in Q32 turns.
+- PWM periods, the timer 1 count from the 72 MHz clock for each frequency in
+  kHz up to PWM_FREQUENCY_MAX, so that a frequency change does not divide.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "brightness.h"
+#include "spectrum.h"
+#include "buck-pmos-data-capture.h"
+
+#define GAMMA               2.2
+
+static double gammaCurve(double level);
+static double cieCurve(double level);
+static double quarterSine(double position);
+static double cordicAngle(double position);
+static void printTable(double (*curve)(double), int size, double limit);
+static void printPeriods(void);
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+    printf("/* Lookup tables generated by table-gen. Do not edit. */\n\n");
+    printf("#include <stdint.h>\n\n");
+    printf("#include \"brightness.h\"\n");
+    printf("#include \"spectrum.h\"\n");
+    printf("#include \"buck-pmos-data-capture.h\"\n\n");
+
+    printf("const uint16_t brightnessTable[BRIGHTNESS_CURVES - 1]\n");
+    printf("                              [BRIGHTNESS_TABLE_SIZE] = {\n");
+    printTable(gammaCurve, BRIGHTNESS_TABLE_SIZE, 65535);
+    printf(",\n");
+    printTable(cieCurve, BRIGHTNESS_TABLE_SIZE, 65535);
+    printf("\n};\n\n");
+
+    printf("const int32_t spectrumSine[SPECTRUM_SINE_SIZE] =\n");
+    printTable(quarterSine, SPECTRUM_SINE_SIZE, 1073741824.0);
+    printf(";\n\n");
+    printf("const uint32_t spectrumArctan[SPECTRUM_CORDIC_STEPS] =\n");
+    printTable(cordicAngle, SPECTRUM_CORDIC_STEPS, 4294967296.0);
+    printf(";\n\n");
+
+    printf("const uint16_t pwmPeriodTable[PWM_FREQUENCY_MAX + 1] =\n");
+    printPeriods();
+    printf(";\n");
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Brightness curves
+
+@param[in] double level: perceptual level from 0 to 1.
+@returns double: luminance from 0 to 1.
+*/
+
+static double gammaCurve(double level)
+{
+    return pow(level, GAMMA);
+}
+
+static double cieCurve(double level)
+{
+    double lightness = level*100;
+    if (lightness <= 8) return lightness/903.3;
+    return pow((lightness + 16)/116, 3);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Spectrum analysis tables
+
+@param[in] double position: from 0 to 1 over the table.
+@returns double: sine over the first quarter turn, or the CORDIC angle of
+         the step in turns.
+*/
+
+static double quarterSine(double position)
+{
+    return sin(position*M_PI/2);
+}
+
+static double cordicAngle(double position)
+{
+    return atan(pow(2, -position*(SPECTRUM_CORDIC_STEPS - 1)))/(2*M_PI);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Print a table as a brace enclosed initialiser
+
+Entries are the curve at evenly spaced points from 0 to 1 inclusive, scaled
+to the limit and rounded.
+
+@param[in] curve: function of the position from 0 to 1.
+@param[in] int size: number of entries.
+@param[in] double limit: scale applied to the curve, and the largest entry.
+*/
+
+static void printTable(double (*curve)(double), int size, double limit)
+{
+    int i;
+    printf("    {");
+    for (i = 0; i < size; i++)
+    {
+        if (i > 0) printf(",");
+        if ((i % 8) == 0) printf("\n        ");
+        else printf(" ");
+        long long value = llround(curve((double)i/(size - 1))*limit);
+        if (value < 0) value = 0;
+        if (value > limit) value = limit;
+        printf("%lld", value);
+    }
+    printf("\n    }");
+}
+
+
+/*--------------------------------------------------------------------------*/
+/** @brief Print the PWM period table
+
+Entry f is 72000/f rounded down, the timer 1 count for f kHz, limited to the
+16 bit timer. Entry 0 is not a valid frequency and is given the longest
+period.
+*/
+
+static void printPeriods(void)
+{
+    int frequency;
+    printf("    {");
+    for (frequency = 0; frequency <= PWM_FREQUENCY_MAX; frequency++)
+    {
+        long period = 0xFFFF;
+        if (frequency > 0) period = 72000/frequency;
+        if (period > 0xFFFF) period = 0xFFFF;
+        if (frequency > 0) printf(",");
+        if ((frequency % 8) == 0) printf("\n        ");
+        else printf(" ");
+        printf("%ld", period);
+    }
+    printf("\n    }");
+}
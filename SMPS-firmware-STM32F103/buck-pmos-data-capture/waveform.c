@@ -0,0 +1,271 @@
+/* STM32F1 SMPS PWM Waveform Tables
+
+Waveform playback drives the buck and boost duty cycles from a table in RAM
+with no CPU involvement. At each timer 1 update event the TIM1 DMA burst
+feature (DCR/DMAR) has DMA1 channel 5 load CCR2 and CCR3 from the next table
+entry, and the repetition counter sets how many PWM periods each entry is
+held.
+
+There are two tables. One is played while the other is uploaded, and a play
+command given during playback switches tables at the end of the current
+table, which is a PWM period boundary, so the change is atomic. A table may
+be played a set number of times or until stopped.
+
+Duty cycles are kept in promille and converted to compare values for the
+current PWM period, and reconverted in place if the frequency changes.
+
+This file manages the tables and is independent of the hardware. The end of
+table handling is called from the DMA ISR.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "waveform.h"
+#include "fixmath.h"
+
+/*--------------------------------------------------------------------------*/
+/* Tables and playback state */
+
+static int16_t dutyCycle[2][WAVEFORM_LENGTH][WAVEFORM_CHANNELS];
+/* Compare values in DMA burst order, CCR2 then CCR3 for each entry */
+static volatile uint16_t compare[2][WAVEFORM_LENGTH*WAVEFORM_CHANNELS];
+static uint8_t length[2];
+static volatile uint8_t active;     /* Table being played */
+static volatile uint8_t upload;     /* Table being uploaded */
+static volatile bool running;
+static volatile bool switchPending;
+static uint8_t repeat;              /* PWM periods each entry is held */
+static uint16_t plays;              /* Plays of each table, zero forever */
+static volatile uint16_t playsLeft;
+
+static void convertTable(uint8_t table, uint32_t period);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Initialise the tables
+
+Both tables are empty, each entry is held for one period and tables play
+until stopped.
+*/
+
+void waveformInit(void)
+{
+    length[0] = 0;
+    length[1] = 0;
+    active = 0;
+    upload = 0;
+    running = false;
+    switchPending = false;
+    repeat = 1;
+    plays = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Clear the upload table
+
+Ignored while a switch to the upload table is pending.
+*/
+
+void waveformClear(void)
+{
+    if (! switchPending) length[upload] = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Append an entry to the upload table
+
+@param[in] int16_t buckDutyCycle: promille.
+@param[in] int16_t boostDutyCycle: promille.
+@returns false if the table is full or waiting to be switched in.
+*/
+
+bool waveformAdd(int16_t buckDutyCycle, int16_t boostDutyCycle)
+{
+    if (switchPending || (length[upload] >= WAVEFORM_LENGTH)) return false;
+    dutyCycle[upload][length[upload]][0] = clamp(buckDutyCycle, 0, 1000);
+    dutyCycle[upload][length[upload]][1] = clamp(boostDutyCycle, 0, 1000);
+    length[upload]++;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the repetitions
+
+The repeat takes effect at the next start of playback.
+
+@param[in] uint8_t periods: PWM periods each entry is held, 1 to
+           WAVEFORM_REPEAT_MAX.
+@param[in] uint16_t tablePlays: times each table is played, zero to play
+           until stopped.
+*/
+
+void waveformSetRepeat(uint8_t periods)
+{
+    repeat = clamp(periods, 1, WAVEFORM_REPEAT_MAX);
+}
+
+uint8_t waveformRepeat(void)
+{
+    return repeat;
+}
+
+void waveformSetPlays(uint16_t tablePlays)
+{
+    plays = tablePlays;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Play the upload table
+
+If stopped, the upload table becomes the played table and the caller starts
+the hardware. During playback the upload table is switched in at the end of
+the current table.
+
+@param[in] uint32_t period: PWM period in timer counts.
+@returns false if the upload table is empty or a switch is already pending.
+*/
+
+bool waveformPlay(uint32_t period)
+{
+    if ((length[upload] == 0) || switchPending) return false;
+    convertTable(upload, period);
+    if (running)
+    {
+        switchPending = true;
+        return true;
+    }
+    active = upload;
+    upload = 1 - active;
+    playsLeft = plays;
+    running = true;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Stop playback
+
+The caller stops the hardware.
+*/
+
+void waveformStop(void)
+{
+    running = false;
+    if (switchPending)
+    {
+        upload = 1 - active;
+        switchPending = false;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check if a table is playing
+
+*/
+
+bool waveformRunning(void)
+{
+    return running;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Reconvert the tables for a new PWM period
+
+@param[in] uint32_t period: PWM period in timer counts.
+*/
+
+void waveformConvert(uint32_t period)
+{
+    convertTable(0, period);
+    convertTable(1, period);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Table being played
+
+@returns uint16_t*: compare values for the DMA, in burst order.
+*/
+
+volatile uint16_t* waveformTable(void)
+{
+    return compare[active];
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief DMA transfers in the played table
+
+@returns uint16_t: number of halfwords.
+*/
+
+uint16_t waveformTransfers(void)
+{
+    return length[active]*WAVEFORM_CHANNELS;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief End of table
+
+Called from the DMA transfer complete ISR. A pending switch takes priority
+over the count of plays, which restarts with the new table.
+
+@returns uint8_t: WAVEFORM_CONTINUE, WAVEFORM_SWITCH or WAVEFORM_STOP.
+*/
+
+uint8_t waveformTableEnd(void)
+{
+    if (! running) return WAVEFORM_STOP;
+    if (switchPending)
+    {
+        active = upload;
+        upload = 1 - active;
+        switchPending = false;
+        playsLeft = plays;
+        return WAVEFORM_SWITCH;
+    }
+    if ((plays > 0) && (--playsLeft == 0))
+    {
+        running = false;
+        return WAVEFORM_STOP;
+    }
+    return WAVEFORM_CONTINUE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Convert a table to compare values
+
+The outputs are in PWM mode 2, so the compare value sets the off time.
+
+@param[in] uint8_t table: table index.
+@param[in] uint32_t period: PWM period in timer counts.
+*/
+
+static void convertTable(uint8_t table, uint32_t period)
+{
+    uint8_t entry;
+    uint8_t channel;
+    for (entry = 0; entry < length[table]; entry++)
+        for (channel = 0; channel < WAVEFORM_CHANNELS; channel++)
+            compare[table][entry*WAVEFORM_CHANNELS + channel] =
+                (period*(1000 - dutyCycle[table][entry][channel]))/1000;
+}
+
@@ -0,0 +1,61 @@
+/* STM32F1 SMPS PWM Waveform Tables
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAVEFORM_H_
+#define WAVEFORM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Entries in each table, each a buck and boost duty cycle */
+#define WAVEFORM_LENGTH     64
+/* Compare registers written by each DMA burst, CCR2 and CCR3 */
+#define WAVEFORM_CHANNELS   2
+/* Most PWM periods each entry may be held, limited by the 8 bit repetition
+counter with two updates per period in centre aligned mode */
+#define WAVEFORM_REPEAT_MAX 128
+
+/* Action at the end of a table */
+#define WAVEFORM_CONTINUE   0   /* Circular DMA plays the table again */
+#define WAVEFORM_SWITCH     1   /* Rearm the DMA with the other table */
+#define WAVEFORM_STOP       2
+
+void waveformInit(void);
+void waveformClear(void);
+bool waveformAdd(int16_t buckDutyCycle, int16_t boostDutyCycle);
+void waveformSetRepeat(uint8_t periods);
+uint8_t waveformRepeat(void);
+void waveformSetPlays(uint16_t plays);
+bool waveformPlay(uint32_t period);
+void waveformStop(void);
+bool waveformRunning(void);
+void waveformConvert(uint32_t period);
+volatile uint16_t* waveformTable(void);
+uint16_t waveformTransfers(void);
+uint8_t waveformTableEnd(void);
+
+#endif
+
@@ -0,0 +1,58 @@
+/* Serial Port Speeds
+
+The termios speed settings of the serial rates used with the boards, shared
+by the host tools and the emulator so that each accepts the same rates, up
+to the fastest rate the client negotiates with a board.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <termios.h>
+
+#include "serial-speed.h"
+
+/*--------------------------------------------------------------------------*/
+/** @brief Terminal speed setting of a baud rate
+
+@param[in] uint32_t baud: serial rate.
+@returns speed_t: termios speed, B0 if not a standard rate.
+*/
+
+speed_t baudConstant(uint32_t baud)
+{
+    static const struct {
+        uint32_t baud;
+        speed_t speed;
+    } speeds[] = {
+        {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600},
+        {115200, B115200}, {230400, B230400}, {460800, B460800},
+        {500000, B500000}, {576000, B576000}, {921600, B921600},
+        {1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000},
+        {2000000, B2000000},
+    };
+    uint8_t i;
+    for (i = 0; i < sizeof(speeds)/sizeof(speeds[0]); i++)
+        if (speeds[i].baud == baud) return speeds[i].speed;
+    return B0;
+}
+
@@ -0,0 +1,227 @@
+/* SMPS Command Throughput and Latency Benchmark
+
+Drives boards, or emulator instances, through the asynchronous client and
+reports the rate of acknowledged commands and their latency:
+
+- round trip: setpoints sent to the first board one at a time, each waiting
+  for the reply of the last, as a blocking client would.
+- pipelined: setpoints given to every board all at once, sent with up to a
+  window of frames outstanding on each board.
+- fleet: rounds of new setpoints for all boards together, each round waiting
+  for every board to reply.
+
+Latencies of the first two are from sending a frame to its acknowledgement,
+and of the fleet rounds from giving the setpoints to the last reply.
+
+With -u the serial link rate of each board is first raised by negotiation
+to at most the rate given.
+
+Usage: smps-bench [-b baud] [-u highest baud] [-w window] [-n requests]
+                  [-r rounds] port...
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "smps-client.h"
+
+/* Time allowed for the boards to be found */
+#define SYNC_TIME           3000000000      /* ns */
+#define SETPOINT_LOW        700
+#define SETPOINT_HIGH       710
+
+static void report(const char* name, std::vector<int64_t>* latencies,
+                   uint64_t failed, int64_t elapsed);
+static int64_t clockTime();
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    uint32_t baud = SMPS_BAUDRATE;
+    uint32_t highest = 0;
+    uint8_t window = SMPS_WINDOW;
+    uint32_t requests = 200;
+    uint32_t rounds = 50;
+    int option;
+    while ((option = getopt(argc, argv, "b:u:w:n:r:")) != -1)
+    {
+        switch (option)
+        {
+        case 'b':
+            baud = atol(optarg);
+            break;
+        case 'u':
+            highest = atol(optarg);
+            break;
+        case 'w':
+            window = atoi(optarg);
+            break;
+        case 'n':
+            requests = atol(optarg);
+            break;
+        case 'r':
+            rounds = atol(optarg);
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: smps-bench [-b baud] [-u highest baud] "
+                        "[-w window] [-n requests] [-r rounds] port...\n");
+        return 1;
+    }
+
+    SmpsClient client;
+    client.setWindow(window);
+    std::vector<SmpsBoard*> boards;
+    int index;
+    for (index = optind; index < argc; index++)
+    {
+        SmpsBoard* board = client.open(argv[index], baud);
+        if (board == NULL)
+        {
+            fprintf(stderr, "Cannot open %s\n", argv[index]);
+            return 1;
+        }
+        boards.push_back(board);
+    }
+    int64_t start = clockTime();
+    for (SmpsBoard* board : boards)
+    {
+        while (! board->synchronised() && (clockTime() - start < SYNC_TIME))
+            usleep(1000);
+        if (board->synchronised()) continue;
+        fprintf(stderr, "No reply from %s\n", board->path().c_str());
+        return 1;
+    }
+    printf("%zu boards, %s\n", boards.size(), boards[0]->identity().c_str());
+    if (highest > 0)
+    {
+        for (SmpsBoard* board : boards)
+            printf("%s at %u baud\n", board->path().c_str(),
+                   board->negotiate(highest));
+    }
+
+/* Round trip */
+    std::vector<int64_t> latencies;
+    uint64_t failed = 0;
+    uint32_t request;
+    start = clockTime();
+    for (request = 0; request < requests; request++)
+    {
+        SmpsReply reply = boards[0]->setpoint((request & 1) ? SETPOINT_HIGH :
+                                              SETPOINT_LOW).get();
+        if (reply.ok()) latencies.push_back(reply.latency);
+        else failed++;
+    }
+    report("round trip", &latencies, failed, clockTime() - start);
+
+/* Pipelined */
+    std::vector<SmpsFuture> replies;
+    failed = 0;
+    start = clockTime();
+    for (request = 0; request < requests; request++)
+        for (SmpsBoard* board : boards)
+            replies.push_back(board->setpoint((request & 1) ? SETPOINT_HIGH :
+                                              SETPOINT_LOW));
+    for (SmpsFuture& future : replies)
+    {
+        SmpsReply reply = future.get();
+        if (reply.ok()) latencies.push_back(reply.latency);
+        else failed++;
+    }
+    report("pipelined", &latencies, failed, clockTime() - start);
+
+/* Fleet */
+    std::vector<int32_t> values(boards.size());
+    failed = 0;
+    start = clockTime();
+    uint32_t round;
+    for (round = 0; round < rounds; round++)
+    {
+        for (index = 0; index < (int)values.size(); index++)
+            values[index] = SETPOINT_LOW + (round + index) % 11;
+        int64_t given = clockTime();
+        replies = client.setpoints(boards, values);
+        for (SmpsFuture& future : replies)
+            if (! future.get().ok()) failed++;
+        latencies.push_back(clockTime() - given);
+    }
+    report("fleet", &latencies, failed, clockTime() - start);
+    uint64_t lost = 0, timeouts = 0;
+    for (SmpsBoard* board : boards)
+    {
+        lost += board->lost();
+        timeouts += board->timeouts();
+    }
+    printf("%lu lost, %lu timed out\n", lost, timeouts);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Print the rate and latency percentiles of a test
+
+The latencies are cleared for the next test.
+
+@param[in] char* name: test.
+@param[in] vector<int64_t>* latencies: ns, one per success.
+@param[in] uint64_t failed: replies that were not successful.
+@param[in] int64_t elapsed: ns taken by the test.
+*/
+
+static void report(const char* name, std::vector<int64_t>* latencies,
+                   uint64_t failed, int64_t elapsed)
+{
+    std::sort(latencies->begin(), latencies->end());
+    size_t count = latencies->size();
+    printf("%-10s %6zu ok %4lu failed %8.1f/s", name, count, failed,
+           count*1e9/elapsed);
+    if (count > 0)
+    {
+        printf("  ms p50 %.2f p90 %.2f p99 %.2f max %.2f",
+               (*latencies)[count/2]*1e-6, (*latencies)[count*9/10]*1e-6,
+               (*latencies)[count*99/100]*1e-6, (*latencies)[count - 1]*1e-6);
+    }
+    printf("\n");
+    latencies->clear();
+}
+
+/*--------------------------------------------------------------------------*/
+
+static int64_t clockTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
+
@@ -0,0 +1,975 @@
+/* Asynchronous Command Client for SMPS Boards
+
+Commands are sent to the firmware in binary frames, each of which the
+firmware answers with "ack, <sequence>, <status>" after any responses of its
+commands. The sequence id counts the lines and frames received since reset,
+so the client learns it once by sending "ai" and waiting for the
+acknowledgement that follows the ident text, and from then on gives each
+frame the next id as it is sent. Replies are matched to frames by their id,
+and the responses received since the previous acknowledgement are those of
+the frame acknowledged. Telemetry lines are recognised by their identifiers
+and left out.
+
+The records asked for by 'rr' and 'jr' follow the acknowledgement over many
+passes of the firmware's main loop, interleaved with telemetry and other
+replies. The frame is held after its acknowledgement while they are
+collected into its reply, which is ready when the last has come. Records
+stopping for longer than the timeout complete the frame as timed out with
+those received.
+
+Several frames may be outstanding on a board, up to a window no larger than
+the firmware's command queue so that none are dropped. Frames beyond the
+window wait in the client. An acknowledgement that is skipped over, as when
+the firmware's transmit buffer was full, completes its frame as lost. If no
+acknowledgement arrives in the timeout all outstanding frames complete as
+timed out and the sequence is learnt again.
+
+Frames for many boards given in one call are queued together and sent in
+the same pass of the loop.
+
+The serial link rate may be raised by negotiation. The board is asked to
+change, the port follows it, and a test pattern from a fresh seed is read
+back before the rate is confirmed. A rate that fails is abandoned on both
+sides and the next lower one tried. Since the board returns to its initial
+rate on reset or on persistent receive errors, the port does too when a
+sync goes unanswered at a negotiated rate.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <iterator>
+
+#include "serial-speed.h"
+#include "smps-client.h"
+
+#define FRAME_START         0xA5
+#define FIELD_SIZE          6
+#define SWEEP_TIME          10              /* ms */
+#define EVENTS_MAX          64
+#define READ_SIZE           4096
+#define SWITCH_TIME         20000           /* us for the board to change */
+
+/* Argument types, as in commands.h */
+#define ARGUMENT_NONE       0
+#define ARGUMENT_SWITCH     1
+#define ARGUMENT_INTEGER    2
+
+/* Commands of the firmware's command table with their argument types. The
+ranges are left to the firmware. */
+static const struct {
+    const char* code;
+    uint8_t argumentType;
+} commandTypes[] = {
+    {"ac", ARGUMENT_SWITCH}, {"ad", ARGUMENT_NONE}, {"ai", ARGUMENT_NONE},
+    {"at", ARGUMENT_NONE}, {"as", ARGUMENT_INTEGER}, {"pf", ARGUMENT_INTEGER},
+    {"pp", ARGUMENT_INTEGER},
+    {"pq", ARGUMENT_INTEGER}, {"ps", ARGUMENT_INTEGER},
+    {"pg", ARGUMENT_INTEGER}, {"ph", ARGUMENT_SWITCH},
+    {"pm", ARGUMENT_INTEGER}, {"pn", ARGUMENT_SWITCH},
+    {"pd", ARGUMENT_INTEGER}, {"pe", ARGUMENT_INTEGER},
+    {"pk", ARGUMENT_INTEGER}, {"pl", ARGUMENT_INTEGER},
+    {"pt", ARGUMENT_INTEGER}, {"pv", ARGUMENT_INTEGER},
+    {"cc", ARGUMENT_INTEGER}, {"cg", ARGUMENT_INTEGER},
+    {"co", ARGUMENT_INTEGER}, {"cq", ARGUMENT_INTEGER},
+    {"cl", ARGUMENT_INTEGER}, {"ch", ARGUMENT_INTEGER},
+    {"cw", ARGUMENT_NONE}, {"cd", ARGUMENT_NONE}, {"ma", ARGUMENT_INTEGER},
+    {"ms", ARGUMENT_INTEGER}, {"mr", ARGUMENT_INTEGER},
+    {"qc", ARGUMENT_INTEGER}, {"qz", ARGUMENT_NONE}, {"qt", ARGUMENT_INTEGER},
+    {"qv", ARGUMENT_INTEGER}, {"qi", ARGUMENT_INTEGER},
+    {"ql", ARGUMENT_SWITCH}, {"qs", ARGUMENT_INTEGER}, {"qx", ARGUMENT_NONE},
+    {"bc", ARGUMENT_INTEGER}, {"bk", ARGUMENT_INTEGER},
+    {"bf", ARGUMENT_INTEGER}, {"bl", ARGUMENT_INTEGER},
+    {"wz", ARGUMENT_NONE}, {"wa", ARGUMENT_INTEGER}, {"wb", ARGUMENT_INTEGER},
+    {"wr", ARGUMENT_INTEGER}, {"wn", ARGUMENT_INTEGER}, {"wp", ARGUMENT_NONE},
+    {"wx", ARGUMENT_NONE}, {"rc", ARGUMENT_INTEGER}, {"rd", ARGUMENT_INTEGER},
+    {"rs", ARGUMENT_INTEGER}, {"rw", ARGUMENT_INTEGER},
+    {"ra", ARGUMENT_SWITCH}, {"rr", ARGUMENT_NONE}, {"jd", ARGUMENT_INTEGER},
+    {"js", ARGUMENT_INTEGER}, {"jf", ARGUMENT_INTEGER}, {"jx", ARGUMENT_NONE},
+    {"jr", ARGUMENT_NONE}, {"ub", ARGUMENT_INTEGER}, {"ut", ARGUMENT_INTEGER},
+    {"uc", ARGUMENT_NONE}, {"ul", ARGUMENT_NONE}, {"ks", ARGUMENT_NONE},
+    {"kz", ARGUMENT_NONE}, {"dr", ARGUMENT_NONE},
+    {"dp", ARGUMENT_NONE}, {"dz", ARGUMENT_NONE}, {"db", ARGUMENT_NONE},
+    {"dl", ARGUMENT_NONE},
+};
+
+/* Identifiers of the lines of a telemetry block, and of lines sent by the
+main loop rather than in response to a command */
+static const char* telemetryIdents[] = {
+    "Channel 1", "Channel 2", "Channel 3", "Channel 4", "isValue",
+    "setValue", "modifier", "PWM", "PWM 2", "region", "mppt", "pw", "ef",
+    "ll", "settle", "qp", "tu", "tk", "pi", "dt", "rt", "je", "uf", "kf",
+};
+
+/* Commands answered with records after their acknowledgement */
+static const struct {
+    const char* code;
+    uint8_t records;
+} recordCommands[] = {
+    {"rr", SMPS_RECORDS_CAPTURE}, {"jr", SMPS_RECORDS_DEADLINE},
+};
+
+/* Identifiers of the record lines, and the records each belongs to. These
+are lines from the firmware, so "ra" is not confused with the command. */
+static const struct {
+    const char* ident;
+    uint8_t records;
+} recordIdents[] = {
+    {"ri", SMPS_RECORDS_CAPTURE}, {"ra", SMPS_RECORDS_CAPTURE},
+    {"rb", SMPS_RECORDS_CAPTURE}, {"re", SMPS_RECORDS_CAPTURE},
+    {"jn", SMPS_RECORDS_DEADLINE}, {"jc", SMPS_RECORDS_DEADLINE},
+    {"jm", SMPS_RECORDS_DEADLINE}, {"jp", SMPS_RECORDS_DEADLINE},
+    {"jl", SMPS_RECORDS_DEADLINE}, {"jj", SMPS_RECORDS_DEADLINE},
+};
+
+/* Rates tried in negotiation, highest first. All are made by the board's
+USART to within 1%. */
+static const uint32_t negotiatedRates[] = {
+    2000000, 1500000, 1152000, 1000000, 921600, 576000, 500000, 460800,
+};
+
+/* Sent to learn the sequence. The first return ends any partial line. */
+static const char syncLine[] = "\rai\r";
+static const char identText[] = "Entropia e.V. LED control";
+static const char resetText[] = "All meow!";
+
+static bool isTelemetry(const TelemetryMessage& message);
+static uint8_t recordKind(const TelemetryMessage& message);
+static SmpsResponse makeResponse(const TelemetryMessage& message);
+static SmpsFuture readyReply(uint8_t status);
+static std::string linkPattern(uint16_t seed);
+static int64_t clockTime();
+
+/*--------------------------------------------------------------------------*/
+/** @brief Find a response by its identifier
+
+@param[in] string_view ident: identifier, for sendResponse() replies the
+label without its colon.
+@returns SmpsResponse*: first response with the identifier, NULL if none.
+*/
+
+const SmpsResponse* SmpsReply::find(std::string_view ident) const
+{
+    for (const SmpsResponse& response : responses)
+        if (response.ident == ident) return &response;
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------*/
+
+SmpsClient::SmpsClient() :
+    stopping(false), window(SMPS_WINDOW), timeout(SMPS_TIMEOUT_TIME)
+{
+    poll = epoll_create1(0);
+    wakeup = eventfd(0, EFD_NONBLOCK);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    epoll_ctl(poll, EPOLL_CTL_ADD, wakeup, &event);
+    now = clockTime();
+    thread = std::thread(&SmpsClient::run, this);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Stop the loop and close all boards
+
+Requests not yet complete are completed as closed.
+*/
+
+SmpsClient::~SmpsClient()
+{
+    stopping = true;
+    wake();
+    thread.join();
+    for (SmpsBoard* board : boards)
+    {
+        board->close();
+        delete board;
+    }
+    ::close(wakeup);
+    ::close(poll);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Open a board's port
+
+The port is set raw at the baud rate and the sequence is learnt before any
+commands are sent. Commands may be given straight away.
+
+@param[in] char* path: port.
+@param[in] uint32_t baud: serial rate.
+@returns SmpsBoard*: the board, owned by the client, NULL if not opened.
+*/
+
+SmpsBoard* SmpsClient::open(const char* path, uint32_t baud)
+{
+    int file = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (file < 0) return NULL;
+    struct termios settings;
+    if (tcgetattr(file, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        speed_t speed = baudConstant(baud);
+        if (speed != B0) cfsetspeed(&settings, speed);
+        tcsetattr(file, TCSANOW, &settings);
+    }
+    SmpsBoard* board = new SmpsBoard(this, path, file, baud);
+    std::lock_guard<std::mutex> lock(mutex);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = board;
+    if (epoll_ctl(poll, EPOLL_CTL_ADD, file, &event) < 0)
+    {
+        ::close(file);
+        delete board;
+        return NULL;
+    }
+    boards.push_back(board);
+    board->synchronise();
+    return board;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the frames that may be outstanding on each board
+
+@param[in] uint8_t lines: window, limited to 1 to SMPS_WINDOW_MAX.
+*/
+
+void SmpsClient::setWindow(uint8_t lines)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lines < 1) lines = 1;
+    if (lines > SMPS_WINDOW_MAX) lines = SMPS_WINDOW_MAX;
+    window = lines;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send the same commands to many boards together
+
+@param[in] vector<SmpsBoard*> boards: boards to command.
+@param[in] SmpsCommand* commands: commands applied together on each board.
+@param[in] size_t count: number of commands.
+@returns vector<SmpsFuture>: reply of each board in turn.
+*/
+
+std::vector<SmpsFuture> SmpsClient::send(const std::vector<SmpsBoard*>& boards,
+                                         const SmpsCommand* commands,
+                                         size_t count)
+{
+    std::vector<SmpsFuture> replies;
+    std::string frame;
+    uint8_t records;
+    bool valid = SmpsBoard::encode(commands, count, &frame, &records);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (SmpsBoard* board : boards)
+        {
+            if (valid) replies.push_back(submit(board, frame, records));
+            else replies.push_back(readyReply(SMPS_INVALID));
+        }
+    }
+    wake();
+    return replies;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Change the setpoints of many boards together
+
+@param[in] vector<SmpsBoard*> boards: boards to command.
+@param[in] vector<int32_t> values: setpoint of each board in turn.
+@returns vector<SmpsFuture>: reply of each board in turn.
+*/
+
+std::vector<SmpsFuture> SmpsClient::setpoints(
+    const std::vector<SmpsBoard*>& boards, const std::vector<int32_t>& values)
+{
+    std::vector<SmpsFuture> replies;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t index;
+        for (index = 0; index < boards.size(); index++)
+        {
+            SmpsCommand command = {"ps", 0};
+            if (index < values.size()) command.argument = values[index];
+            std::string frame;
+            SmpsBoard::encode(&command, 1, &frame);
+            replies.push_back(submit(boards[index], frame));
+        }
+    }
+    wake();
+    return replies;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Queue a frame on a board
+
+Called with the mutex held.
+
+@param[in] SmpsBoard* board: board to send to.
+@param[in] string frame: encoded frame.
+@param[in] uint8_t records: SMPS_RECORDS_ asked for by the frame.
+@returns SmpsFuture: the reply.
+*/
+
+SmpsFuture SmpsClient::submit(SmpsBoard* board, std::string frame,
+                              uint8_t records)
+{
+    if (board->file < 0) return readyReply(SMPS_CLOSED);
+    SmpsBoard::Request request;
+    request.frame = std::move(frame);
+    request.sequence = 0;
+    request.sent = 0;
+    request.records = records;
+    request.received = 0;
+    request.jitterBins = 0;
+    SmpsFuture reply = request.promise.get_future();
+    board->waiting.push_back(std::move(request));
+    return reply;
+}
+
+/*--------------------------------------------------------------------------*/
+
+void SmpsClient::wake()
+{
+    uint64_t one = 1;
+    if (write(wakeup, &one, sizeof(one)) < 0) return;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Serve the boards until stopped
+
+Received characters are decoded as they arrive, which completes
+acknowledged frames. Each pass then sends waiting frames as the windows
+allow and times out frames not acknowledged.
+*/
+
+void SmpsClient::run()
+{
+    static uint8_t buffer[READ_SIZE];
+    struct epoll_event events[EVENTS_MAX];
+    while (! stopping)
+    {
+        int count = epoll_wait(poll, events, EVENTS_MAX, SWEEP_TIME);
+        std::lock_guard<std::mutex> lock(mutex);
+        now = clockTime();
+        int event;
+        for (event = 0; event < count; event++)
+        {
+            SmpsBoard* board = (SmpsBoard*)events[event].data.ptr;
+            if (board == NULL)
+            {
+                uint64_t value;
+                while (read(wakeup, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            if (board->file < 0) continue;
+            ssize_t length;
+            while ((length = read(board->file, buffer, sizeof(buffer))) > 0)
+                board->decoder.decode(buffer, length);
+            if ((length == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+                board->close();
+        }
+        for (SmpsBoard* board : boards)
+        {
+            board->expire();
+            board->transmit();
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Board on an open port
+
+@param[in] SmpsClient* client: client serving the board.
+@param[in] char* path: port.
+@param[in] int file: the open port.
+@param[in] uint32_t baud: serial rate it was opened with.
+*/
+
+SmpsBoard::SmpsBoard(SmpsClient* client, const char* path, int file,
+                     uint32_t baud) :
+    client(client), portPath(path), file(file), decoder(this), inStep(false),
+    identified(false), sequence(0), syncSent(0), lostCount(0),
+    timeoutCount(0), baseBaud(baud), baud(baud)
+{
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send commands to be applied together
+
+@param[in] SmpsCommand* commands: commands.
+@param[in] size_t count: number of commands, 1 to SMPS_BATCH_MAX.
+@returns SmpsFuture: the reply, SMPS_INVALID straight away if a command is
+not recognised.
+*/
+
+SmpsFuture SmpsBoard::send(const SmpsCommand* commands, size_t count)
+{
+    std::string frame;
+    uint8_t records;
+    if (! encode(commands, count, &frame, &records))
+        return readyReply(SMPS_INVALID);
+    SmpsFuture reply;
+    {
+        std::lock_guard<std::mutex> lock(client->mutex);
+        reply = client->submit(this, std::move(frame), records);
+    }
+    client->wake();
+    return reply;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send one command
+
+@param[in] char* code: two command letters.
+@param[in] int32_t argument: argument, 1 or 0 for a switch.
+@returns SmpsFuture: the reply.
+*/
+
+SmpsFuture SmpsBoard::command(const char* code, int32_t argument)
+{
+    SmpsCommand entry;
+    strncpy(entry.code, code, sizeof(entry.code) - 1);
+    entry.code[sizeof(entry.code) - 1] = 0;
+    entry.argument = argument;
+    return send(&entry, 1);
+}
+
+/*--------------------------------------------------------------------------*/
+
+std::string SmpsBoard::identity() const
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    return identityText;
+}
+
+uint32_t SmpsBoard::baudRate() const
+{
+    std::lock_guard<std::mutex> lock(client->mutex);
+    return baud;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Raise the serial link rate as far as the port and board allow
+
+The rates above the present one, up to the highest given, are tried from the
+highest down. For each the board is asked to change, the port follows once
+the board has, and the test pattern is read back before the rate is
+confirmed. A rate the board rejects is passed over. One that fails is
+abandoned, the port returning at once and the board after its trial time,
+before the next is tried.
+
+Blocks until done, so is not to be called from the loop thread.
+
+@param[in] uint32_t highest: highest rate to try.
+@returns uint32_t: rate in use.
+*/
+
+uint32_t SmpsBoard::negotiate(uint32_t highest)
+{
+    uint16_t seed = clockTime() & 0xFFFF;
+    for (uint32_t rate : negotiatedRates)
+    {
+        uint32_t previous = baudRate();
+        if ((rate > highest) || (rate <= previous)) continue;
+        SmpsReply reply = command("ub", rate).get();
+        if (! reply.ok() || (reply.find("ub") == NULL)) continue;
+        usleep(SWITCH_TIME);
+        {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            setSpeed(rate);
+        }
+        client->wake();
+        seed++;
+        reply = command("ut", seed).get();
+        const SmpsResponse* pattern = reply.find("ut");
+        if (reply.ok() && (pattern != NULL) &&
+            (pattern->text == linkPattern(seed)))
+        {
+            reply = command("uc").get();
+            if (reply.ok() && (reply.find("Link") == NULL)) return rate;
+        }
+        {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            setSpeed(previous);
+        }
+        client->wake();
+        usleep(SMPS_LINK_TRIAL_TIME*1000);
+    }
+    return baudRate();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Encode commands as a binary frame
+
+Each command is its two letters and the argument LSB first. The checksum
+makes the length, payload and checksum sum to zero.
+
+@param[in] SmpsCommand* commands: commands.
+@param[in] size_t count: number of commands.
+@param[out] string* frame: the frame.
+@param[out] uint8_t* records: SMPS_RECORDS_ asked for, or NULL.
+@returns true if all commands are recognised with a valid argument type.
+*/
+
+bool SmpsBoard::encode(const SmpsCommand* commands, size_t count,
+                       std::string* frame, uint8_t* records)
+{
+    if (records != NULL) *records = 0;
+    if ((count == 0) || (count > SMPS_BATCH_MAX)) return false;
+    uint8_t length = count*FIELD_SIZE;
+    frame->clear();
+    frame->push_back((char)FRAME_START);
+    frame->push_back((char)length);
+    uint8_t checksum = length;
+    size_t index;
+    for (index = 0; index < count; index++)
+    {
+        const SmpsCommand* command = &commands[index];
+        const auto* type = std::begin(commandTypes);
+        while ((type != std::end(commandTypes)) &&
+               (strncmp(type->code, command->code, 2) != 0)) type++;
+        if (type == std::end(commandTypes)) return false;
+        if ((type->argumentType == ARGUMENT_SWITCH) &&
+            (command->argument != 0) && (command->argument != 1)) return false;
+        if ((type->argumentType == ARGUMENT_NONE) && (command->argument != 0))
+            return false;
+        for (const auto& entry : recordCommands)
+            if ((records != NULL) &&
+                (strncmp(entry.code, command->code, 2) == 0))
+                *records |= entry.records;
+        uint8_t field[FIELD_SIZE];
+        field[0] = command->code[0];
+        field[1] = command->code[1];
+        uint32_t argument = (uint32_t)command->argument;
+        uint8_t byte;
+        for (byte = 0; byte < 4; byte++)
+            field[2 + byte] = (argument >> (8*byte)) & 0xFF;
+        for (byte = 0; byte < FIELD_SIZE; byte++)
+        {
+            frame->push_back((char)field[byte]);
+            checksum += field[byte];
+        }
+    }
+    frame->push_back((char)(uint8_t)(0 - checksum));
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take a decoded message from the board
+
+The reset message of a board being synchronised is that of its start, which
+came before the sync line. Record lines go to the frame collecting them.
+
+Called from the loop with the mutex held.
+*/
+
+void SmpsBoard::message(const TelemetryMessage& message)
+{
+    if ((message.kind == TELEMETRY_FIELD) || isTelemetry(message)) return;
+    uint8_t records = recordKind(message);
+    if (records != 0)
+    {
+        record(message, records);
+        return;
+    }
+    if ((message.kind == TELEMETRY_VALUES) && (message.ident == "ack") &&
+        (message.count == 2))
+    {
+        acknowledge(message.value[0], message.value[1]);
+        return;
+    }
+    if (message.kind == TELEMETRY_TEXT)
+    {
+        if (message.text == resetText)
+        {
+            if (! inStep) return;
+            fail(SMPS_CLOSED);
+            synchronise();
+            return;
+        }
+        if (message.text == identText)
+        {
+            identityText = message.text;
+            identified = true;
+        }
+    }
+    responses.push_back(makeResponse(message));
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Complete the frame acknowledged
+
+Frames sent before it that are still outstanding had their
+acknowledgements lost. Until the sequence is learnt, the acknowledgement
+following the ident text gives it.
+
+@param[in] uint16_t ackSequence: sequence id acknowledged.
+@param[in] uint8_t status: status given by the firmware.
+*/
+
+void SmpsBoard::acknowledge(uint16_t ackSequence, uint8_t status)
+{
+    if (! inStep)
+    {
+        if (identified && (status == SMPS_OK))
+        {
+            sequence = ackSequence + 1;
+            inStep = true;
+        }
+        identified = false;
+        responses.clear();
+        return;
+    }
+    while (! outstanding.empty())
+    {
+        Request* request = &outstanding.front();
+        int16_t after = ackSequence - request->sequence;
+        if (after < 0) break;
+        if (after == 0)
+        {
+            if ((status == SMPS_OK) && (request->records != 0))
+                collect(request);
+            else complete(request, status);
+            outstanding.pop_front();
+            break;
+        }
+        lostCount++;
+        complete(request, SMPS_LOST);
+        outstanding.pop_front();
+    }
+    identified = false;
+    responses.clear();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Give a frame its reply
+
+The responses gathered are moved to a frame acknowledged as received.
+
+@param[in] Request* request: frame to complete.
+@param[in] uint8_t status: reply status.
+*/
+
+void SmpsBoard::complete(Request* request, uint8_t status)
+{
+    SmpsReply reply;
+    reply.status = status;
+    reply.sequence = request->sequence;
+    reply.latency = client->now - request->sent;
+    if (status < SMPS_LOST) reply.responses = std::move(responses);
+    request->promise.set_value(std::move(reply));
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Hold an acknowledged frame for the records it asked for
+
+The reply is made as for complete() and the records are added to it as
+they come. A capture is not sent if none is held, which the firmware
+reports in place of it.
+
+@param[in] Request* request: frame acknowledged as received.
+*/
+
+void SmpsBoard::collect(Request* request)
+{
+    request->reply.status = SMPS_OK;
+    request->reply.sequence = request->sequence;
+    request->reply.latency = client->now - request->sent;
+    request->reply.responses = std::move(responses);
+    if (request->reply.find("Capture") != NULL)
+        request->records &= ~SMPS_RECORDS_CAPTURE;
+    if (request->records == 0)
+    {
+        request->promise.set_value(std::move(request->reply));
+        return;
+    }
+    request->received = client->now;
+    collecting.push_back(std::move(*request));
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Add a record line to the frame collecting it
+
+The frame is complete with the last line of its records, "re" for a capture
+and the last jitter bin for the deadline records. Lines of records that no
+frame is collecting, as after a timeout, are dropped.
+
+@param[in] TelemetryMessage message: record line.
+@param[in] uint8_t records: SMPS_RECORDS_ the line belongs to.
+*/
+
+void SmpsBoard::record(const TelemetryMessage& message, uint8_t records)
+{
+    auto request = collecting.begin();
+    while ((request != collecting.end()) && ! (request->records & records))
+        request++;
+    if (request == collecting.end()) return;
+    request->reply.responses.push_back(makeResponse(message));
+    request->received = client->now;
+    if ((records == SMPS_RECORDS_CAPTURE) && (message.ident == "re"))
+        request->records &= ~SMPS_RECORDS_CAPTURE;
+    if ((records == SMPS_RECORDS_DEADLINE) && (message.ident == "jj") &&
+        (++request->jitterBins >= SMPS_DEADLINE_BINS))
+        request->records &= ~SMPS_RECORDS_DEADLINE;
+    if (request->records != 0) return;
+    request->promise.set_value(std::move(request->reply));
+    collecting.erase(request);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Complete all outstanding frames, which will not be acknowledged
+
+@param[in] uint8_t status: reply status.
+*/
+
+void SmpsBoard::fail(uint8_t status)
+{
+    for (Request& request : outstanding) complete(&request, status);
+    outstanding.clear();
+    for (Request& request : collecting)
+    {
+        request.reply.status = status;
+        request.promise.set_value(std::move(request.reply));
+    }
+    collecting.clear();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Learn the sequence again
+
+Waiting frames are held until it is learnt.
+*/
+
+void SmpsBoard::synchronise()
+{
+    inStep = false;
+    identified = false;
+    responses.clear();
+    output.append(syncLine, sizeof(syncLine) - 1);
+    syncSent = client->now;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send waiting frames as the window allows
+
+Each is given the next sequence id as it is queued for the port. Output
+the port does not take is kept for the next pass.
+*/
+
+void SmpsBoard::transmit()
+{
+    if (file < 0) return;
+    while (inStep && ! waiting.empty() &&
+           (outstanding.size() < client->window))
+    {
+        Request request = std::move(waiting.front());
+        waiting.pop_front();
+        request.sequence = sequence++;
+        request.sent = client->now;
+        output.append(request.frame);
+        outstanding.push_back(std::move(request));
+    }
+    if (output.empty()) return;
+    ssize_t length = write(file, output.data(), output.size());
+    if (length > 0) output.erase(0, length);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Time out frames not acknowledged, and an unanswered sync
+
+An unanswered sync at a negotiated rate is tried again at the initial rate,
+to which the board has returned. Frames whose records have stopped are
+completed with those received.
+*/
+
+void SmpsBoard::expire()
+{
+    if (file < 0) return;
+    auto request = collecting.begin();
+    while (request != collecting.end())
+    {
+        if (client->now - request->received <= client->timeout)
+        {
+            request++;
+            continue;
+        }
+        timeoutCount++;
+        request->reply.status = SMPS_TIMEOUT;
+        request->promise.set_value(std::move(request->reply));
+        request = collecting.erase(request);
+    }
+    if (! inStep)
+    {
+        if (client->now - syncSent <= client->timeout) return;
+        if ((baud == baseBaud) || ! setSpeed(baseBaud)) synchronise();
+        return;
+    }
+    if (outstanding.empty() ||
+        (client->now - outstanding.front().sent <= client->timeout)) return;
+    timeoutCount += outstanding.size();
+    fail(SMPS_TIMEOUT);
+    synchronise();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Change the rate of the port and learn the sequence again
+
+Output not yet taken by the port and any partial line received are
+discarded, as they belong to the old rate.
+
+Called with the mutex held.
+
+@param[in] uint32_t rate: new rate.
+@returns bool: false if the port cannot be set to the rate.
+*/
+
+bool SmpsBoard::setSpeed(uint32_t rate)
+{
+    struct termios settings;
+    speed_t speed = baudConstant(rate);
+    if ((file < 0) || (speed == B0) || (tcgetattr(file, &settings) != 0))
+        return false;
+    cfsetspeed(&settings, speed);
+    if (tcsetattr(file, TCSADRAIN, &settings) != 0) return false;
+    baud = rate;
+    output.clear();
+    decoder.reset();
+    synchronise();
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Close the port, completing all frames as closed
+
+*/
+
+void SmpsBoard::close()
+{
+    if (file >= 0)
+    {
+        epoll_ctl(client->poll, EPOLL_CTL_DEL, file, NULL);
+        ::close(file);
+    }
+    file = -1;
+    inStep = false;
+    fail(SMPS_CLOSED);
+    for (Request& request : waiting) complete(&request, SMPS_CLOSED);
+    waiting.clear();
+}
+
+/*--------------------------------------------------------------------------*/
+
+static bool isTelemetry(const TelemetryMessage& message)
+{
+    if (message.kind == TELEMETRY_TEXT) return false;
+    for (const char* ident : telemetryIdents)
+        if (message.ident == ident) return true;
+    return false;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Records a line belongs to
+
+@param[in] TelemetryMessage message: decoded line.
+@returns uint8_t: SMPS_RECORDS_ of the line, 0 if not a record.
+*/
+
+static uint8_t recordKind(const TelemetryMessage& message)
+{
+    if (message.kind != TELEMETRY_VALUES) return 0;
+    for (const auto& entry : recordIdents)
+        if (message.ident == entry.ident) return entry.records;
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static SmpsResponse makeResponse(const TelemetryMessage& message)
+{
+    SmpsResponse response;
+    response.kind = message.kind;
+    response.ident = message.ident;
+    response.count = message.count;
+    memcpy(response.value, message.value, sizeof(response.value));
+    response.text = message.text;
+    return response;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Reply that is ready without sending anything
+
+@param[in] uint8_t status: reply status.
+@returns SmpsFuture: ready future.
+*/
+
+static SmpsFuture readyReply(uint8_t status)
+{
+    std::promise<SmpsReply> promise;
+    SmpsReply reply;
+    reply.status = status;
+    reply.sequence = 0;
+    reply.latency = 0;
+    promise.set_value(std::move(reply));
+    return promise.get_future();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Test pattern of the link rate negotiation
+
+As generated by the firmware in link.c.
+
+@param[in] uint16_t seed: seed given with 'ut'.
+@returns string: the pattern.
+*/
+
+static std::string linkPattern(uint16_t seed)
+{
+    std::string pattern;
+    uint32_t generator = seed;
+    while (pattern.size() < SMPS_PATTERN_SIZE)
+    {
+        generator = generator*1103515245 + 12345;
+        char character = '!' + (generator >> 16) % 94;
+        if ((character == ',') || (character == ':')) character = 'U';
+        pattern.push_back(character);
+    }
+    return pattern;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static int64_t clockTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
+
@@ -0,0 +1,311 @@
+/* Asynchronous Command Client for SMPS Boards
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMPS_CLIENT_H_
+#define SMPS_CLIENT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "telemetry-decoder.h"
+
+#define SMPS_BAUDRATE       230400
+
+/* Reply status. The first are those of the acknowledgement (see commslib.h),
+the rest are found by the client. */
+#define SMPS_OK             0
+#define SMPS_INVALID        1
+#define SMPS_OVERLONG       2
+#define SMPS_DROPPED        3
+#define SMPS_CHECKSUM       4
+#define SMPS_INCOMPLETE     5
+#define SMPS_REJECTED       6   /* Refused in the present state */
+#define SMPS_LOST           16  /* A later line was acknowledged first */
+#define SMPS_TIMEOUT        17  /* No acknowledgement in the timeout */
+#define SMPS_CLOSED         18  /* The port closed or the board reset */
+
+/* The firmware queues 8 lines, one of which is being assembled. More lines
+outstanding than this can be dropped without their own acknowledgement.
+Beyond the default the replies of a full queue can overflow the firmware's
+transmit buffer, losing acknowledgements. */
+#define SMPS_WINDOW_MAX     7
+#define SMPS_WINDOW         4
+/* Commands in one binary frame of at most 80 bytes */
+#define SMPS_BATCH_MAX      13
+#define SMPS_TIMEOUT_TIME   1000000000      /* ns */
+/* Serial link rate negotiation, as in link.h */
+#define SMPS_LINK_TRIAL_TIME    2000        /* ms the board waits for 'uc' */
+#define SMPS_PATTERN_SIZE       64
+/* Records sent by the main loop after the acknowledgement of a command, and
+collected into its reply */
+#define SMPS_RECORDS_CAPTURE    1   /* 'rr', "ri" "ra" "rb" up to "re" */
+#define SMPS_RECORDS_DEADLINE   2   /* 'jr', "jn" to the last "jj" */
+/* Histogram bins of the deadline records, as in deadline.h */
+#define SMPS_DEADLINE_BINS      8
+
+/* A command as two letters and an argument. Switches are 1 or 0 and
+commands without an argument take 0. */
+struct SmpsCommand
+{
+    char code[3];
+    int32_t argument;
+};
+
+/* A response line, as for TelemetryMessage but holding its text */
+struct SmpsResponse
+{
+    uint8_t kind;
+    std::string ident;
+    uint8_t count;
+    int32_t value[TELEMETRY_VALUES_MAX];
+    std::string text;
+};
+
+struct SmpsReply
+{
+    uint8_t status;
+    uint16_t sequence;
+    int64_t latency;                /* ns from sending to acknowledgement */
+    std::vector<SmpsResponse> responses;
+
+    bool ok() const { return status == SMPS_OK; }
+    const SmpsResponse* find(std::string_view ident) const;
+};
+
+typedef std::future<SmpsReply> SmpsFuture;
+
+class SmpsClient;
+
+/* One board on a serial port. The commands of a call are sent in one binary
+frame and are applied together, and the future is ready when the frame is
+acknowledged, with the responses sent between the previous acknowledgement
+and this one. Telemetry is left out of the responses. A frame asking for
+records is ready once they have all followed the acknowledgement, with the
+records after the responses. The port starts at the rate it was opened with,
+which is the board's after reset, and may be raised by negotiation. */
+class SmpsBoard : public TelemetrySink
+{
+public:
+    SmpsFuture send(const SmpsCommand* commands, size_t count);
+    SmpsFuture command(const char* code, int32_t argument = 0);
+
+/* Actions */
+    SmpsFuture capture(bool on) { return command("ac", on); }
+    SmpsFuture deadtimeOptimise() { return command("ad"); }
+    SmpsFuture identify() { return command("ai"); }
+    SmpsFuture autotune() { return command("at"); }
+    SmpsFuture spectrum(int32_t input) { return command("as", input); }
+/* Parameters */
+    SmpsFuture frequency(int32_t kHz) { return command("pf", kHz); }
+    SmpsFuture dutyCycle1(int32_t promille) { return command("pp", promille); }
+    SmpsFuture dutyCycle2(int32_t promille) { return command("pq", promille); }
+    SmpsFuture setpoint(int32_t value) { return command("ps", value); }
+    SmpsFuture gain(int32_t divisor) { return command("pg", divisor); }
+    SmpsFuture gainSchedule(bool on) { return command("ph", on); }
+    SmpsFuture controlMode(int32_t mode) { return command("pm", mode); }
+    SmpsFuture synchronous(bool on) { return command("pn", on); }
+    SmpsFuture deadtime(int32_t ticks) { return command("pd", ticks); }
+    SmpsFuture feedForward(int32_t mode) { return command("pe", mode); }
+    SmpsFuture ledKnee(int32_t mV) { return command("pk", mV); }
+    SmpsFuture ledSlope(int32_t slope) { return command("pl", slope); }
+    SmpsFuture lightLoad(int32_t mA) { return command("pt", mA); }
+    SmpsFuture lightLoadFrequency(int32_t kHz) { return command("pv", kHz); }
+/* Calibration */
+    SmpsFuture calibrationSelect(int32_t input) { return command("cc", input); }
+    SmpsFuture calibrationGain(int32_t gain) { return command("cg", gain); }
+    SmpsFuture calibrationOffset(int32_t offset)
+        { return command("co", offset); }
+    SmpsFuture calibrationQuadratic(int32_t quadratic)
+        { return command("cq", quadratic); }
+    SmpsFuture calibrationLow(int32_t value) { return command("cl", value); }
+    SmpsFuture calibrationHigh(int32_t value) { return command("ch", value); }
+    SmpsFuture calibrationSave() { return command("cw"); }
+    SmpsFuture calibrationReset() { return command("cd"); }
+/* Maximum power point tracking */
+    SmpsFuture trackerAlgorithm(int32_t algorithm)
+        { return command("ma", algorithm); }
+    SmpsFuture trackerStep(int32_t step) { return command("ms", step); }
+    SmpsFuture trackerRate(int32_t rate) { return command("mr", rate); }
+/* Setpoint profiles */
+    SmpsFuture profileSelect(int32_t channel) { return command("qc", channel); }
+    SmpsFuture profileErase() { return command("qz"); }
+    SmpsFuture profileKeyframeTime(int32_t time)
+        { return command("qt", time); }
+    SmpsFuture profileKeyframeValue(int32_t value)
+        { return command("qv", value); }
+    SmpsFuture profileInterpolation(int32_t mode)
+        { return command("qi", mode); }
+    SmpsFuture profileLoop(bool on) { return command("ql", on); }
+    SmpsFuture profileStart(int32_t channels)
+        { return command("qs", channels); }
+    SmpsFuture profileStop() { return command("qx"); }
+/* Perceptual brightness */
+    SmpsFuture brightnessSelect(int32_t channel)
+        { return command("bc", channel); }
+    SmpsFuture brightnessCurve(int32_t curve) { return command("bk", curve); }
+    SmpsFuture brightnessFullScale(int32_t value)
+        { return command("bf", value); }
+    SmpsFuture brightnessLevel(int32_t level) { return command("bl", level); }
+/* PWM waveform tables */
+    SmpsFuture waveformErase() { return command("wz"); }
+    SmpsFuture waveformBuck(int32_t promille)
+        { return command("wa", promille); }
+    SmpsFuture waveformBoost(int32_t promille)
+        { return command("wb", promille); }
+    SmpsFuture waveformRepeat(int32_t count) { return command("wr", count); }
+    SmpsFuture waveformPlays(int32_t count) { return command("wn", count); }
+    SmpsFuture waveformPlay() { return command("wp"); }
+    SmpsFuture waveformStop() { return command("wx"); }
+/* Triggered capture, collected into the reply of captureRead() */
+    SmpsFuture captureInput(int32_t input) { return command("rc", input); }
+    SmpsFuture captureChange(int32_t value) { return command("rd", value); }
+    SmpsFuture captureDeviation(int32_t value) { return command("rs", value); }
+    SmpsFuture captureWindow(int32_t scans) { return command("rw", scans); }
+    SmpsFuture captureArm(bool on) { return command("ra", on); }
+    SmpsFuture captureRead() { return command("rr"); }
+/* Regulator deadline, records collected into the reply of deadlineRead() */
+    SmpsFuture deadline(int32_t us) { return command("jd", us); }
+    SmpsFuture deadlineShed(int32_t misses) { return command("js", misses); }
+    SmpsFuture deadlineSafe(int32_t misses) { return command("jf", misses); }
+    SmpsFuture deadlineNormal() { return command("jx"); }
+    SmpsFuture deadlineRead() { return command("jr"); }
+/* Serial link rate, negotiated with negotiate() */
+    SmpsFuture linkStatus() { return command("ul"); }
+/* Parameters saved in FLASH */
+    SmpsFuture storeStatus() { return command("ks"); }
+    SmpsFuture storeClear() { return command("kz"); }
+/* Data */
+    SmpsFuture dataRaw() { return command("dr"); }
+    SmpsFuture dataEnergy() { return command("dp"); }
+    SmpsFuture dataEnergyReset() { return command("dz"); }
+    SmpsFuture dataBenchmark() { return command("db"); }
+    SmpsFuture dataLatency() { return command("dl"); }
+
+    const std::string& path() const { return portPath; }
+    bool synchronised() const { return inStep; }
+    std::string identity() const;
+    uint64_t lost() const { return lostCount; }
+    uint64_t timeouts() const { return timeoutCount; }
+    uint32_t baudRate() const;
+    uint32_t negotiate(uint32_t highest);
+
+    void message(const TelemetryMessage& message) override;
+
+private:
+    friend class SmpsClient;
+
+/* A frame waiting to be sent or acknowledged */
+    struct Request
+    {
+        std::string frame;
+        std::promise<SmpsReply> promise;
+        uint16_t sequence;
+        int64_t sent;               /* ns, monotonic */
+        uint8_t records;            /* SMPS_RECORDS_ still to come */
+        int64_t received;           /* ns, monotonic, of the last record */
+        uint8_t jitterBins;         /* "jj" lines received */
+        SmpsReply reply;            /* Kept while the records come */
+    };
+
+    SmpsBoard(SmpsClient* client, const char* path, int file,
+              uint32_t baud);
+    static bool encode(const SmpsCommand* commands, size_t count,
+                       std::string* frame, uint8_t* records = NULL);
+    void acknowledge(uint16_t sequence, uint8_t status);
+    void complete(Request* request, uint8_t status);
+    void collect(Request* request);
+    void record(const TelemetryMessage& message, uint8_t records);
+    void fail(uint8_t status);
+    void synchronise();
+    void transmit();
+    void expire();
+    bool setSpeed(uint32_t rate);
+    void close();
+
+    SmpsClient* client;
+    std::string portPath;
+    int file;
+    TelemetryDecoder decoder;
+    std::deque<Request> waiting;        /* Guarded by the client's mutex */
+    std::deque<Request> outstanding;    /* Loop thread only, as below */
+    std::deque<Request> collecting;     /* Acknowledged, awaiting records */
+    std::vector<SmpsResponse> responses;
+    std::string output;                 /* Not yet accepted by the port */
+    std::string identityText;
+    std::atomic<bool> inStep;
+    bool identified;                    /* Ident text since the last ack */
+    uint16_t sequence;                  /* Of the next line sent */
+    int64_t syncSent;
+    uint64_t lostCount;
+    uint64_t timeoutCount;
+    uint32_t baseBaud;                  /* Rate of the board after reset */
+    uint32_t baud;                      /* Rate of the port */
+};
+
+/* Boards served by one thread with epoll. Calls may be made from any
+thread. */
+class SmpsClient
+{
+public:
+    SmpsClient();
+    ~SmpsClient();
+    SmpsBoard* open(const char* path, uint32_t baud = SMPS_BAUDRATE);
+    void setWindow(uint8_t lines);
+    void setTimeout(int64_t ns) { timeout = ns; }
+    std::vector<SmpsFuture> send(const std::vector<SmpsBoard*>& boards,
+                                 const SmpsCommand* commands, size_t count);
+    std::vector<SmpsFuture> setpoints(const std::vector<SmpsBoard*>& boards,
+                                      const std::vector<int32_t>& values);
+
+private:
+    friend class SmpsBoard;
+
+    SmpsFuture submit(SmpsBoard* board, std::string frame,
+                      uint8_t records = 0);
+    void wake();
+    void run();
+
+    int poll;
+    int wakeup;
+    std::thread thread;
+    std::mutex mutex;
+    std::vector<SmpsBoard*> boards;
+    std::atomic<bool> stopping;
+    uint8_t window;
+    int64_t timeout;                    /* ns */
+    int64_t now;                        /* ns, monotonic, at the last wakeup */
+};
+
+#endif
+
@@ -0,0 +1,274 @@
+/* Incremental Decoder of the SMPS Serial Stream
+
+Characters are decoded as they arrive, in whatever pieces the serial port
+delivers them, into messages passed to a sink. Lines are assembled in a fixed
+buffer in the decoder, and messages refer into it, so nothing is allocated.
+
+ASCII lines end in CR, LF or both, and take the forms sent by commslib:
+
+- "ident, value, value" from dataMessageSend, with one or two values.
+- "Label: value" from sendResponse.
+- "ident,string" from sendString, where the text is not numeric.
+- Anything else, such as the start up banner, is passed as text.
+
+Binary frames have the same form as binary commands to the firmware: the
+start byte 0xA5, which never occurs in ASCII, a payload length byte, the
+payload and a checksum byte such that length, payload and checksum sum to 0.
+The payload is a sequence of fields each of two identifier letters and a 32
+bit value, least significant byte first, passed as one message per field.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+
+#include "telemetry-decoder.h"
+
+/* Decoder states */
+#define DECODE_LINE             0
+#define DECODE_DISCARD          1   /* Overlong line, up to its end */
+#define DECODE_FRAME_LENGTH     2
+#define DECODE_FRAME_PAYLOAD    3
+#define DECODE_FRAME_CHECKSUM   4
+
+static std::string_view trim(std::string_view text);
+static bool parseInteger(std::string_view text, int32_t* value);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Decoder for one serial stream
+
+@param[in] TelemetrySink* sink: receives the decoded messages.
+*/
+
+TelemetryDecoder::TelemetryDecoder(TelemetrySink* sink) :
+    sink(sink), lineCount(0), frameCount(0), errorCount(0)
+{
+    reset();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Discard any partly received line or frame
+
+Used when the stream is interrupted.
+*/
+
+void TelemetryDecoder::reset()
+{
+    state = DECODE_LINE;
+    length = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Decode received characters
+
+@param[in] uint8_t* data: characters as received.
+@param[in] size_t dataLength: number of characters.
+*/
+
+void TelemetryDecoder::decode(const uint8_t* data, size_t dataLength)
+{
+    const uint8_t* end = data + dataLength;
+    while (data < end)
+    {
+        uint8_t character = *data++;
+        switch (state)
+        {
+        case DECODE_LINE:
+            if (character == TELEMETRY_FRAME_START)
+            {
+                if (length > 0) endLine();
+                state = DECODE_FRAME_LENGTH;
+            }
+            else if ((character == '\r') || (character == '\n'))
+            {
+                if (length > 0) endLine();
+            }
+            else if (length < TELEMETRY_LINE_SIZE) line[length++] = character;
+            else
+            {
+                errorCount++;
+                state = DECODE_DISCARD;
+            }
+            break;
+        case DECODE_DISCARD:
+            if ((character == '\r') || (character == '\n'))
+            {
+                length = 0;
+                state = DECODE_LINE;
+            }
+            else if (character == TELEMETRY_FRAME_START)
+            {
+                length = 0;
+                state = DECODE_FRAME_LENGTH;
+            }
+            break;
+        case DECODE_FRAME_LENGTH:
+            frameLength = character;
+            frameChecksum = character;
+            length = 0;
+            if ((frameLength == 0) || (frameLength > TELEMETRY_LINE_SIZE))
+            {
+                errorCount++;
+                state = DECODE_LINE;
+            }
+            else state = DECODE_FRAME_PAYLOAD;
+            break;
+        case DECODE_FRAME_PAYLOAD:
+            line[length++] = character;
+            frameChecksum += character;
+            if (length == frameLength) state = DECODE_FRAME_CHECKSUM;
+            break;
+        case DECODE_FRAME_CHECKSUM:
+            frameChecksum += character;
+            if (frameChecksum == 0) endFrame();
+            else errorCount++;
+            length = 0;
+            state = DECODE_LINE;
+            break;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Pass on a complete ASCII line
+
+A colon marks a response with one value. Otherwise the identifier ends at
+the first comma, and the rest is taken as values if all are integers.
+*/
+
+void TelemetryDecoder::endLine()
+{
+    std::string_view text((const char*)line, length);
+    length = 0;
+    lineCount++;
+    TelemetryMessage message;
+    message.kind = TELEMETRY_TEXT;
+    message.count = 0;
+    message.text = trim(text);
+    size_t separator = text.find(':');
+    if (separator != std::string_view::npos)
+    {
+        message.ident = text.substr(0, separator);
+        message.text = trim(text.substr(separator + 1));
+        message.kind = TELEMETRY_STRING;
+        if (parseInteger(message.text, &message.value[0]))
+        {
+            message.kind = TELEMETRY_VALUES;
+            message.count = 1;
+        }
+    }
+    else if ((separator = text.find(',')) != std::string_view::npos)
+    {
+        message.ident = text.substr(0, separator);
+        message.text = trim(text.substr(separator + 1));
+        message.kind = TELEMETRY_VALUES;
+        std::string_view rest = message.text;
+        while ((message.kind == TELEMETRY_VALUES) && ! rest.empty())
+        {
+            separator = rest.find(',');
+            std::string_view field = trim(rest.substr(0, separator));
+            if ((message.count >= TELEMETRY_VALUES_MAX) ||
+                ! parseInteger(field, &message.value[message.count]))
+                message.kind = TELEMETRY_STRING;
+            else message.count++;
+            if (separator == std::string_view::npos) break;
+            rest = rest.substr(separator + 1);
+        }
+        if (message.kind != TELEMETRY_VALUES) message.count = 0;
+    }
+    sink->message(message);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Pass on the fields of a complete binary frame
+
+*/
+
+void TelemetryDecoder::endFrame()
+{
+    frameCount++;
+    if ((frameLength % TELEMETRY_FIELD_SIZE) != 0)
+    {
+        errorCount++;
+        return;
+    }
+    TelemetryMessage message;
+    message.kind = TELEMETRY_FIELD;
+    message.count = 1;
+    uint8_t index;
+    for (index = 0; index < frameLength; index += TELEMETRY_FIELD_SIZE)
+    {
+        const uint8_t* field = line + index;
+        message.ident = std::string_view((const char*)field, 2);
+        message.value[0] = (int32_t)((uint32_t)field[2] |
+                                     ((uint32_t)field[3] << 8) |
+                                     ((uint32_t)field[4] << 16) |
+                                     ((uint32_t)field[5] << 24));
+        sink->message(message);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Remove leading and trailing spaces
+
+@param[in] std::string_view text: text to trim.
+@returns std::string_view: the trimmed text.
+*/
+
+static std::string_view trim(std::string_view text)
+{
+    while (! text.empty() && (text.front() == ' ')) text.remove_prefix(1);
+    while (! text.empty() && (text.back() == ' ')) text.remove_suffix(1);
+    return text;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Convert a signed decimal field to an integer
+
+@param[in] std::string_view text: field, which must be entirely numeric.
+@param[out] int32_t* value: converted value.
+@returns true if the field is a valid 32 bit integer.
+*/
+
+static bool parseInteger(std::string_view text, int32_t* value)
+{
+    bool negative = false;
+    if (! text.empty() && (text.front() == '-'))
+    {
+        negative = true;
+        text.remove_prefix(1);
+    }
+    if (text.empty() || (text.size() > 10)) return false;
+    int64_t result = 0;
+    for (char character : text)
+    {
+        if ((character < '0') || (character > '9')) return false;
+        result = result*10 + (character - '0');
+    }
+    if (negative) result = -result;
+    if ((result < INT32_MIN) || (result > INT32_MAX)) return false;
+    *value = (int32_t)result;
+    return true;
+}
+
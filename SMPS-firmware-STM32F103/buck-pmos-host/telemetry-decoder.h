@@ -0,0 +1,92 @@
+/* Incremental Decoder of the SMPS Serial Stream
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TELEMETRY_DECODER_H_
+#define TELEMETRY_DECODER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+
+/* Longest line kept, longer lines are discarded */
+#define TELEMETRY_LINE_SIZE     128
+#define TELEMETRY_VALUES_MAX    2
+
+/* Binary frames, as for commands to the firmware (see commslib.h) */
+#define TELEMETRY_FRAME_START   0xA5
+#define TELEMETRY_FIELD_SIZE    6
+
+/* Message kinds */
+#define TELEMETRY_VALUES        0   /* Identifier with integer values */
+#define TELEMETRY_STRING        1   /* Identifier with a string */
+#define TELEMETRY_TEXT          2   /* Line of any other form */
+#define TELEMETRY_FIELD         3   /* Binary frame field with one value */
+
+/* A decoded message. The views are into the decoder's buffer and are only
+valid until the sink returns. */
+struct TelemetryMessage
+{
+    uint8_t kind;
+    std::string_view ident;
+    uint8_t count;
+    int32_t value[TELEMETRY_VALUES_MAX];
+    std::string_view text;
+};
+
+class TelemetrySink
+{
+public:
+    virtual ~TelemetrySink() {}
+    virtual void message(const TelemetryMessage& message) = 0;
+};
+
+class TelemetryDecoder
+{
+public:
+    explicit TelemetryDecoder(TelemetrySink* sink);
+    void reset();
+    void decode(const uint8_t* data, size_t length);
+    uint64_t lines() const { return lineCount; }
+    uint64_t frames() const { return frameCount; }
+    uint64_t errors() const { return errorCount; }
+
+private:
+    void endLine();
+    void endFrame();
+
+    TelemetrySink* sink;
+    uint8_t state;
+    uint8_t line[TELEMETRY_LINE_SIZE];
+    uint16_t length;
+    uint8_t frameLength;
+    uint8_t frameChecksum;
+    uint64_t lineCount;
+    uint64_t frameCount;
+    uint64_t errorCount;
+};
+
+#endif
+
@@ -0,0 +1,288 @@
+/* Memory Mapped Columnar Telemetry Ring
+
+Telemetry rows for one device are kept in a file mapped into memory, so that
+other processes map the same file and read the columns in place with no
+copying and no calls to the writer. Each column is a contiguous array with
+one entry per row, so a reader scanning one quantity touches only that
+quantity's memory.
+
+The file holds the latest rows in a ring. The writer fills the slot of the
+next row in every column and then advances the row count with release
+ordering. A reader takes the row count with acquire ordering, after which the
+rows after count - capacity up to count are complete, the oldest slot being
+the one the writer fills next. A row may be overwritten while being read if
+the writer laps it, which read() detects by checking the count again
+afterwards. Readers using the columns directly should keep well clear of the
+oldest row.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <string>
+
+#include "telemetry-ring.h"
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The row count must be lock free to be shared between processes");
+
+/* The time and value columns start on a cache line */
+#define RING_ALIGN      64
+
+static size_t align(size_t offset);
+static size_t ringSize(uint64_t capacity, uint32_t columns);
+
+/*--------------------------------------------------------------------------*/
+
+TelemetryRing::TelemetryRing() :
+    header(NULL), time(NULL), value(NULL), size(0)
+{
+}
+
+TelemetryRing::~TelemetryRing()
+{
+    close();
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Create a ring file for writing
+
+Any existing file is replaced. The new file is built under a temporary name
+and renamed over the old one, so that a reader still mapping the old file
+keeps its rows rather than losing them to truncation, and no reader sees a
+partly initialised ring.
+
+@param[in] char* path: file to create.
+@param[in] uint64_t capacity: rows held.
+@param[in] uint32_t columns: value columns, excluding the time.
+@param[in] char** names: name of each value column.
+@returns true if the file was created and mapped.
+*/
+
+bool TelemetryRing::create(const char* path, uint64_t capacity,
+                           uint32_t columns, const char* const* names)
+{
+    close();
+    if ((capacity == 0) || (columns == 0) ||
+        (columns > TELEMETRY_RING_COLUMNS_MAX)) return false;
+    std::string temporary = std::string(path) + ".XXXXXX";
+    int file = mkstemp(&temporary[0]);
+    if (file < 0) return false;
+    if ((fchmod(file, 0644) < 0) ||
+        (ftruncate(file, ringSize(capacity, columns)) < 0))
+    {
+        ::close(file);
+        unlink(temporary.c_str());
+        return false;
+    }
+    if (! map(file, true))
+    {
+        unlink(temporary.c_str());
+        return false;
+    }
+    memcpy(header->magic, TELEMETRY_RING_MAGIC, sizeof(header->magic));
+    header->version = TELEMETRY_RING_VERSION;
+    header->columns = columns;
+    header->capacity = capacity;
+    uint32_t column;
+    for (column = 0; column < columns; column++)
+        strncpy(header->name[column], names[column],
+                TELEMETRY_RING_NAME_SIZE - 1);
+    header->rows.store(0, std::memory_order_release);
+    time = (int64_t*)((uint8_t*)header + align(sizeof(TelemetryRingHeader)));
+    value = (int32_t*)((uint8_t*)time + align(capacity*sizeof(int64_t)));
+    if (rename(temporary.c_str(), path) < 0)
+    {
+        close();
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Open a ring file for reading
+
+@param[in] char* path: file written by another process.
+@returns true if the file is a valid ring and was mapped.
+*/
+
+bool TelemetryRing::open(const char* path)
+{
+    close();
+    int file = ::open(path, O_RDONLY);
+    if (file < 0) return false;
+    if (! map(file, false)) return false;
+    if ((size < sizeof(TelemetryRingHeader)) ||
+        (memcmp(header->magic, TELEMETRY_RING_MAGIC,
+                sizeof(header->magic)) != 0) ||
+        (header->version != TELEMETRY_RING_VERSION) ||
+        (header->columns == 0) ||
+        (header->columns > TELEMETRY_RING_COLUMNS_MAX) ||
+        (size < ringSize(header->capacity, header->columns)))
+    {
+        close();
+        return false;
+    }
+    time = (int64_t*)((uint8_t*)header + align(sizeof(TelemetryRingHeader)));
+    value = (int32_t*)((uint8_t*)time +
+                       align(header->capacity*sizeof(int64_t)));
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Map a ring file
+
+The file is closed as the mapping holds it.
+
+@param[in] int file: open file.
+@param[in] bool writable: map for writing.
+@returns true if mapped.
+*/
+
+bool TelemetryRing::map(int file, bool writable)
+{
+    struct stat status;
+    void* address = MAP_FAILED;
+    if (fstat(file, &status) == 0)
+    {
+        size = status.st_size;
+        address = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE :
+                       PROT_READ, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (address == MAP_FAILED)
+    {
+        size = 0;
+        return false;
+    }
+    header = (TelemetryRingHeader*)address;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+
+void TelemetryRing::close()
+{
+    if (header != NULL) munmap(header, size);
+    header = NULL;
+    time = NULL;
+    value = NULL;
+    size = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Append a row
+
+@param[in] int64_t rowTime: ns since the epoch.
+@param[in] int32_t* values: one for each column.
+*/
+
+void TelemetryRing::append(int64_t rowTime, const int32_t* values)
+{
+    uint64_t rows = header->rows.load(std::memory_order_relaxed);
+    uint64_t slot = rows % header->capacity;
+    time[slot] = rowTime;
+    uint32_t column;
+    for (column = 0; column < header->columns; column++)
+        value[column*header->capacity + slot] = values[column];
+    header->rows.store(rows + 1, std::memory_order_release);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Copy out a row
+
+@param[in] uint64_t row: row number from creation.
+@param[out] int64_t* rowTime: ns since the epoch.
+@param[out] int32_t* values: one for each column.
+@returns true if the row was complete and not overwritten while read.
+*/
+
+bool TelemetryRing::read(uint64_t row, int64_t* rowTime,
+                         int32_t* values) const
+{
+    uint64_t capacity = header->capacity;
+    uint64_t rows = header->rows.load(std::memory_order_acquire);
+    if ((row >= rows) || (row + capacity <= rows)) return false;
+    uint64_t slot = row % capacity;
+    *rowTime = time[slot];
+    uint32_t column;
+    for (column = 0; column < header->columns; column++)
+        values[column] = value[column*capacity + slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    rows = header->rows.load(std::memory_order_relaxed);
+    return (row + capacity > rows);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Rows written since creation
+
+Acquire ordering makes the contents of these rows visible.
+*/
+
+uint64_t TelemetryRing::rows() const
+{
+    return header->rows.load(std::memory_order_acquire);
+}
+
+/*--------------------------------------------------------------------------*/
+
+const char* TelemetryRing::columnName(uint32_t column) const
+{
+    if (column >= header->columns) return "";
+    return header->name[column];
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Column of values
+
+@param[in] uint32_t column: column index.
+@returns int32_t*: the column, indexed by row modulo the capacity.
+*/
+
+const int32_t* TelemetryRing::column(uint32_t column) const
+{
+    if (column >= header->columns) return NULL;
+    return value + column*header->capacity;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static size_t align(size_t offset)
+{
+    return (offset + RING_ALIGN - 1) & ~(size_t)(RING_ALIGN - 1);
+}
+
+static size_t ringSize(uint64_t capacity, uint32_t columns)
+{
+    return align(sizeof(TelemetryRingHeader)) +
+           align(capacity*sizeof(int64_t)) + columns*capacity*sizeof(int32_t);
+}
+
@@ -0,0 +1,82 @@
+/* Memory Mapped Columnar Telemetry Ring
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TELEMETRY_RING_H_
+#define TELEMETRY_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define TELEMETRY_RING_MAGIC        "SMPSRING"
+#define TELEMETRY_RING_VERSION      1
+#define TELEMETRY_RING_COLUMNS_MAX  32
+#define TELEMETRY_RING_NAME_SIZE    16
+/* Value of a column not given in a row */
+#define TELEMETRY_MISSING           INT32_MIN
+
+/* File layout: this header, then the time column of int64_t in ns since the
+epoch, then each value column of int32_t, each column holding one entry per
+row of the ring. */
+struct TelemetryRingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t columns;
+    uint64_t capacity;                  /* Rows held */
+    std::atomic<uint64_t> rows;         /* Rows written since creation */
+    char name[TELEMETRY_RING_COLUMNS_MAX][TELEMETRY_RING_NAME_SIZE];
+};
+
+class TelemetryRing
+{
+public:
+    TelemetryRing();
+    ~TelemetryRing();
+    bool create(const char* path, uint64_t capacity, uint32_t columns,
+                const char* const* names);
+    bool open(const char* path);
+    void close();
+    void append(int64_t time, const int32_t* values);
+    bool read(uint64_t row, int64_t* time, int32_t* values) const;
+    uint64_t rows() const;
+    uint64_t capacity() const { return header->capacity; }
+    uint32_t columns() const { return header->columns; }
+    const char* columnName(uint32_t column) const;
+    const int64_t* timeColumn() const { return time; }
+    const int32_t* column(uint32_t column) const;
+
+private:
+    bool map(int file, bool writable);
+
+    TelemetryRingHeader* header;
+    int64_t* time;
+    int32_t* value;
+    size_t size;
+};
+
+#endif
+
@@ -0,0 +1,123 @@
+/* SMPS Telemetry Ring Reader
+
+Prints the latest rows of a telemetry ring file written by telemetryd, as
+tab separated columns headed by their names, and optionally follows the ring
+as rows are added. Missing values are printed as "-". The file is mapped read
+only, so any number of readers may run alongside the daemon.
+
+Usage: telemetry-tail [-n rows] [-f] ring-file
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "telemetry-ring.h"
+
+/* Interval at which a followed ring is checked */
+#define FOLLOW_TIME         50000           /* us */
+
+static void printRow(const TelemetryRing* ring, uint64_t row);
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    uint64_t count = 10;
+    bool follow = false;
+    int option;
+    while ((option = getopt(argc, argv, "n:f")) != -1)
+    {
+        switch (option)
+        {
+        case 'n':
+            count = strtoull(optarg, NULL, 0);
+            break;
+        case 'f':
+            follow = true;
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "Usage: telemetry-tail [-n rows] [-f] ring-file\n");
+        return 1;
+    }
+    TelemetryRing ring;
+    if (! ring.open(argv[optind]))
+    {
+        fprintf(stderr, "Cannot open ring %s\n", argv[optind]);
+        return 1;
+    }
+
+    printf("time");
+    uint32_t column;
+    for (column = 0; column < ring.columns(); column++)
+        printf("\t%s", ring.columnName(column));
+    printf("\n");
+    uint64_t rows = ring.rows();
+    uint64_t row = 0;
+    if (rows > count) row = rows - count;
+    if (row + ring.capacity() <= rows) row = rows - ring.capacity() + 1;
+    while (true)
+    {
+        for (; row < rows; row++) printRow(&ring, row);
+        fflush(stdout);
+        if (! follow) break;
+        usleep(FOLLOW_TIME);
+        rows = ring.rows();
+        if (row + ring.capacity() <= rows) row = rows - ring.capacity() + 1;
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Print a row
+
+Rows overwritten while being read are skipped.
+
+@param[in] TelemetryRing* ring: ring being read.
+@param[in] uint64_t row: row number from creation.
+*/
+
+static void printRow(const TelemetryRing* ring, uint64_t row)
+{
+    int64_t time;
+    int32_t values[TELEMETRY_RING_COLUMNS_MAX];
+    if (! ring->read(row, &time, values)) return;
+    printf("%ld.%03ld", (long)(time/1000000000),
+           (long)(time/1000000 % 1000));
+    uint32_t column;
+    for (column = 0; column < ring->columns(); column++)
+    {
+        if (values[column] == TELEMETRY_MISSING) printf("\t-");
+        else printf("\t%d", values[column]);
+    }
+    printf("\n");
+}
+
@@ -0,0 +1,400 @@
+/* SMPS Telemetry Aggregation Daemon
+
+Reads the serial streams of many SMPS boards, or emulator instances, from one
+thread with epoll, decodes the telemetry incrementally and appends it to a
+memory mapped columnar ring file per device for other processes to read.
+
+Each telemetry block from the firmware becomes one row. Lines are mapped to
+columns by the table below, and a row is written when a column already given
+in it is repeated, as at the start of the next block, or when the device has
+been quiet for a short time after the block. Columns not given in a row hold
+TELEMETRY_MISSING. Acknowledgements and other responses are not stored.
+
+The path of each ring file is the output directory and the name of the port
+with ".ring" appended. A port that cannot be opened, or that closes, is tried
+again every second.
+
+Usage: telemetryd [-o directory] [-c rows] [-b baud] [-s] port...
+
+-c sets the rows held in each ring, -s sends "ac+" to each port as it is
+opened to start capture. Counts and the processor time used are printed on
+exit.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <string_view>
+#include <vector>
+
+#include "serial-speed.h"
+#include "telemetry-decoder.h"
+#include "telemetry-ring.h"
+
+#define BAUDRATE            230400
+#define RING_ROWS           65536
+/* Quiet time that ends a telemetry block, checked at the sweep interval */
+#define FLUSH_TIME          20000000        /* ns */
+#define SWEEP_TIME          10000000        /* ns */
+#define RETRY_TIME          1000000000      /* ns */
+#define EVENTS_MAX          256
+#define READ_SIZE           65536
+
+/* Telemetry columns. Binary frames give the columns by their two letter
+identifier. */
+struct Column
+{
+    const char* name;
+    const char* ident;          /* Text line identifier */
+    uint8_t index;              /* Value in the line */
+    const char* binary;         /* Binary field identifier */
+};
+
+static const Column columns[] = {
+    {"outputCurrent", "Channel 1", 0, "oi"},
+    {"outputVoltage", "Channel 2", 0, "ov"},
+    {"inputVoltage", "Channel 3", 0, "iv"},
+    {"inputCurrent", "Channel 4", 0, "ii"},
+    {"isValue", "isValue", 0, "is"},
+    {"setValue", "setValue", 0, "sv"},
+    {"modifier", "modifier", 0, "md"},
+    {"dutyCycle", "PWM", 0, "d1"},
+    {"dutyCycle2", "PWM 2", 0, "d2"},
+    {"region", "region", 0, "rg"},
+    {"inputPower", "pw", 0, "wi"},
+    {"outputPower", "pw", 1, "wo"},
+    {"efficiency", "ef", 0, "ef"},
+    {"mpptPower", "mppt", 0, "mw"},
+    {"mpptEfficiency", "mppt", 1, "me"},
+    {"lightFrequency", "ll", 0, "lf"},
+    {"lightSkipped", "ll", 1, "ls"},
+    {"settle", "settle", 0, "st"},
+};
+
+#define NUM_COLUMNS (sizeof(columns)/sizeof(Column))
+
+static_assert(NUM_COLUMNS <= 32, "The row mask holds 32 columns");
+
+/* One serial port and its ring */
+class Device : public TelemetrySink
+{
+public:
+    Device(const char* path);
+    void message(const TelemetryMessage& message) override;
+    void setColumn(uint8_t column, int32_t value);
+    void flush();
+
+    const char* path;
+    int file;
+    TelemetryDecoder decoder;
+    TelemetryRing ring;
+    int32_t row[NUM_COLUMNS];
+    uint32_t given;             /* Mask of the columns given in the row */
+    int64_t rowTime;            /* ns since the epoch */
+    int64_t lastMessage;        /* ns, monotonic */
+    int64_t retry;              /* ns, monotonic */
+    uint64_t rows;
+};
+
+static int64_t now;             /* ns, monotonic, at the last wakeup */
+static volatile sig_atomic_t stopping;
+
+static bool openDevice(int poll, Device* device, uint32_t baud, bool start);
+static void closeDevice(int poll, Device* device);
+static int64_t clockTime(clockid_t clock);
+static void stopHandler(int signal);
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    const char* directory = ".";
+    uint64_t capacity = RING_ROWS;
+    uint32_t baud = BAUDRATE;
+    bool start = false;
+    int option;
+    while ((option = getopt(argc, argv, "o:c:b:s")) != -1)
+    {
+        switch (option)
+        {
+        case 'o':
+            directory = optarg;
+            break;
+        case 'c':
+            capacity = strtoull(optarg, NULL, 0);
+            if (capacity > 0) break;
+            fprintf(stderr, "Invalid ring size\n");
+            return 1;
+        case 'b':
+            baud = atol(optarg);
+            break;
+        case 's':
+            start = true;
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: telemetryd [-o directory] [-c rows] "
+                        "[-b baud] [-s] port...\n");
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopHandler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    const char* names[NUM_COLUMNS];
+    uint8_t column;
+    for (column = 0; column < NUM_COLUMNS; column++)
+        names[column] = columns[column].name;
+    std::vector<Device*> devices;
+    int index;
+    for (index = optind; index < argc; index++)
+    {
+        Device* device = new Device(argv[index]);
+        char name[256];
+        strncpy(name, argv[index], sizeof(name) - 1);
+        name[sizeof(name) - 1] = 0;
+        char ringPath[512];
+        snprintf(ringPath, sizeof(ringPath), "%s/%s.ring", directory,
+                 basename(name));
+        if (! device->ring.create(ringPath, capacity, NUM_COLUMNS, names))
+        {
+            fprintf(stderr, "Cannot create %s\n", ringPath);
+            return 1;
+        }
+        devices.push_back(device);
+    }
+
+    int poll = epoll_create1(0);
+    now = clockTime(CLOCK_MONOTONIC);
+    for (Device* device : devices)
+        if (! openDevice(poll, device, baud, start))
+            fprintf(stderr, "Cannot open %s: %s, retrying\n", device->path,
+                    strerror(errno));
+
+    static uint8_t buffer[READ_SIZE];
+    struct epoll_event events[EVENTS_MAX];
+    uint64_t bytes = 0;
+    int64_t sweep = now + SWEEP_TIME;
+    while (! stopping)
+    {
+        int timeout = (sweep > now) ? (sweep - now)/1000000 + 1 : 0;
+        int count = epoll_wait(poll, events, EVENTS_MAX, timeout);
+        now = clockTime(CLOCK_MONOTONIC);
+        int event;
+        for (event = 0; event < count; event++)
+        {
+            Device* device = (Device*)events[event].data.ptr;
+            ssize_t length;
+            while ((length = read(device->file, buffer, sizeof(buffer))) > 0)
+            {
+                bytes += length;
+                device->decoder.decode(buffer, length);
+            }
+            if ((length == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+                closeDevice(poll, device);
+        }
+/* End quiet blocks and retry closed ports */
+        if (now < sweep) continue;
+        sweep = now + SWEEP_TIME;
+        for (Device* device : devices)
+        {
+            if ((device->given != 0) &&
+                (now - device->lastMessage > FLUSH_TIME)) device->flush();
+            if ((device->file < 0) && (now >= device->retry))
+                openDevice(poll, device, baud, start);
+        }
+    }
+
+    uint64_t lines = 0, frames = 0, errors = 0, rows = 0;
+    for (Device* device : devices)
+    {
+        device->flush();
+        lines += device->decoder.lines();
+        frames += device->decoder.frames();
+        errors += device->decoder.errors();
+        rows += device->rows;
+        if (device->file >= 0) close(device->file);
+        delete device;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%zu devices, %lu bytes, %lu lines, %lu frames, %lu errors, "
+           "%lu rows, %.2fs processor\n", devices.size(), bytes, lines,
+           frames, errors, rows,
+           usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)*1e-6);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Device on a serial port
+
+@param[in] char* path: port.
+*/
+
+Device::Device(const char* path) :
+    path(path), file(-1), decoder(this), given(0), rowTime(0),
+    lastMessage(0), retry(0), rows(0)
+{
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Place a decoded message in the row
+
+*/
+
+void Device::message(const TelemetryMessage& message)
+{
+    uint8_t column;
+    for (column = 0; column < NUM_COLUMNS; column++)
+    {
+        const Column* entry = &columns[column];
+        if (message.kind == TELEMETRY_FIELD)
+        {
+            if (message.ident == entry->binary)
+                setColumn(column, message.value[0]);
+        }
+        else if ((message.kind == TELEMETRY_VALUES) &&
+                 (message.ident == entry->ident) &&
+                 (entry->index < message.count))
+            setColumn(column, message.value[entry->index]);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set a column in the row, starting a new row if already set
+
+*/
+
+void Device::setColumn(uint8_t column, int32_t value)
+{
+    if (given & (1 << column)) flush();
+    if (given == 0)
+    {
+        uint8_t i;
+        for (i = 0; i < NUM_COLUMNS; i++) row[i] = TELEMETRY_MISSING;
+        rowTime = clockTime(CLOCK_REALTIME);
+    }
+    row[column] = value;
+    given |= 1 << column;
+    lastMessage = now;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write the row to the ring
+
+*/
+
+void Device::flush()
+{
+    if (given == 0) return;
+    ring.append(rowTime, row);
+    rows++;
+    given = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Open a device's port and add it to the poll set
+
+The port is set raw at the baud rate and read without blocking.
+
+@param[in] int poll: epoll instance.
+@param[in] Device* device: device to open.
+@param[in] uint32_t baud: serial rate.
+@param[in] bool start: send the command to start capture.
+@returns true if opened.
+*/
+
+static bool openDevice(int poll, Device* device, uint32_t baud, bool start)
+{
+    device->retry = now + RETRY_TIME;
+    int file = open(device->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (file < 0) return false;
+    struct termios settings;
+    if (tcgetattr(file, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        speed_t speed = baudConstant(baud);
+        if (speed != B0) cfsetspeed(&settings, speed);
+        tcsetattr(file, TCSANOW, &settings);
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = device;
+    if (epoll_ctl(poll, EPOLL_CTL_ADD, file, &event) < 0)
+    {
+        close(file);
+        return false;
+    }
+    device->file = file;
+    device->decoder.reset();
+    if (start && (write(file, "ac+\r", 4) < 0))
+        fprintf(stderr, "Cannot start capture on %s\n", device->path);
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static void closeDevice(int poll, Device* device)
+{
+    epoll_ctl(poll, EPOLL_CTL_DEL, device->file, NULL);
+    close(device->file);
+    device->file = -1;
+    device->retry = now + RETRY_TIME;
+    device->flush();
+}
+
+/*--------------------------------------------------------------------------*/
+
+static int64_t clockTime(clockid_t clock)
+{
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
+
+static void stopHandler(int signal)
+{
+    (void)signal;
+    stopping = true;
+}
+
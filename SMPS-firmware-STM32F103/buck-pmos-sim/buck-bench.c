@@ -0,0 +1,334 @@
+/* Regulator Scenario Benchmark on a Simulated Buck Converter
+
+The firmware regulator is run in closed loop against the switching model of
+the buck converter, following the timing of the main loop:
+
+- Timer 2 starts an ADC scan every 65536 clock counts, which reads the
+  sensors as they stand at the end of the PWM period then in progress.
+- The regulator runs on every twelfth scan with the latest readings, and
+  its duty cycle is converted to the timer 1 compare value as in
+  timer1PWMsettings, taking effect from the next PWM period.
+
+Each scenario brings the converter to a steady state, then applies a
+change and records the output current averaged over each PWM period.
+
+- Rise time from 10% to 90% of the change, for setpoint changes.
+- Overshoot beyond the final value as a percentage of the change, or for
+  disturbances the largest deviation from the final value in mA.
+- Settling time to stay within 2% of the final value.
+- Peak to peak ripple of the instantaneous output current once settled.
+- The firmware's own settling measurement, in regulator periods.
+
+The final value is the average over the last fifth of the run.
+
+Usage: buck-bench [-f kHz] [-g gain divisor] [-e feed-forward mode] [-s]
+                  [-r load resistance]
+
+-s selects synchronous rectification, -r a resistive load in place of the
+LED string, in which case the setpoints are scaled to suit.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "buck-model.h"
+#include "control.h"
+#include "fixmath.h"
+#include "buck-pmos-data-capture.h"
+
+/* Firmware timing */
+#define SCAN_PERIOD         (65536/TIMER_CLOCK)
+#define REGULATOR_SCANS     12
+/* Time allowed to reach a steady state before each change */
+#define PRESETTLE_TIME      2.0
+/* Settling band as a fraction of the final value */
+#define SETTLE_BAND         0.02
+/* Fraction of the run at the end taken as settled */
+#define FINAL_FRACTION      0.2
+
+/* Scenario changes */
+#define SCENARIO_STARTUP    0   /* From rest to the setpoint */
+#define SCENARIO_SETPOINT   1   /* Setpoint in mA */
+#define SCENARIO_LOAD       2   /* LED knee voltage or load resistance */
+#define SCENARIO_SOURCE     3   /* Source voltage */
+
+typedef struct {
+    const char* name;
+    uint8_t change;
+    int32_t setpoint;           /* mA, before the change */
+    double value;               /* After the change */
+    double duration;            /* s, after the change */
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"startup", SCENARIO_STARTUP, 700, 0, 3.0},
+    {"setpoint up", SCENARIO_SETPOINT, 350, 700, 3.0},
+    {"setpoint down", SCENARIO_SETPOINT, 700, 350, 3.0},
+    {"load step", SCENARIO_LOAD, 700, 0.9, 3.0},
+    {"load release", SCENARIO_LOAD, 700, 1.1, 3.0},
+    {"input sag", SCENARIO_SOURCE, 700, 0.75, 3.0},
+};
+
+#define NUM_SCENARIOS (sizeof(scenarios)/sizeof(Scenario))
+
+/* Firmware settings for a build */
+typedef struct {
+    uint16_t frequency;         /* kHz */
+    uint16_t gainDivisor;
+    uint8_t feedForward;
+    double setpointScale;       /* Applied to the scenario setpoints */
+} Settings;
+
+/* Closed loop state between the plant and the firmware */
+typedef struct {
+    BuckState plant;
+    int32_t measured[NUM_CHANNEL];
+    int16_t buckDutyCycle;
+    int16_t boostDutyCycle;
+    int32_t setValue;
+    double nextScan;
+    uint8_t scans;
+    int32_t firmwareSettle;
+} Loop;
+
+static void runScenario(const BuckPlant* initial, const Settings* settings,
+                        const Scenario* scenario);
+static void runPeriod(const BuckPlant* plant, const Settings* settings,
+                      Loop* loop);
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    BuckPlant plant;
+    buckDefault(&plant);
+    Settings settings;
+    settings.frequency = FREQUENCY;
+    settings.gainDivisor = GAIN_DIVISOR;
+    settings.feedForward = FEEDFORWARD_OFF;
+    settings.setpointScale = 1;
+    int option;
+    while ((option = getopt(argc, argv, "f:g:e:sr:")) != -1)
+    {
+        switch (option)
+        {
+        case 'f':
+            settings.frequency = clamp(atoi(optarg), 1, 1000);
+            break;
+        case 'g':
+            settings.gainDivisor = clamp(atoi(optarg), 1, 65535);
+            break;
+        case 'e':
+            settings.feedForward = clamp(atoi(optarg), FEEDFORWARD_OFF,
+                                         FEEDFORWARD_LED);
+            break;
+        case 's':
+            plant.synchronous = true;
+            break;
+        case 'r':
+            plant.loadType = BUCK_LOAD_RESISTOR;
+            plant.loadResistance = atof(optarg);
+            if (plant.loadResistance > 0) break;
+            /* fall through */
+        default:
+            fprintf(stderr, "Usage: %s [-f kHz] [-g gain divisor] "
+                    "[-e feed-forward mode] [-s] [-r load resistance]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+/* Resistive loads are run at the same output voltage as the LED string */
+    if (plant.loadType == BUCK_LOAD_RESISTOR)
+        settings.setpointScale = (plant.ledKnee + 0.7*plant.ledResistance)/
+                                 (0.7*plant.loadResistance);
+
+    printf("Source %.1fV, L %.0fuH, C %.0fuF, ", plant.sourceVoltage,
+           plant.inductance*1e6, plant.capacitance*1e6);
+    if (plant.loadType == BUCK_LOAD_LED)
+        printf("LED load %.1fV %.1f ohm\n", plant.ledKnee,
+               plant.ledResistance);
+    else printf("resistive load %.2f ohm\n", plant.loadResistance);
+    printf("PWM %dkHz %s, gain divisor %d, feed-forward %d\n",
+           settings.frequency, plant.synchronous ? "synchronous" : "diode",
+           settings.gainDivisor, settings.feedForward);
+    printf("%-14s %8s %10s %10s %9s %10s %9s\n", "scenario", "rise ms",
+           "overshoot%", "deviation", "settle ms", "ripple mA", "fw settle");
+    unsigned int i;
+    for (i = 0; i < NUM_SCENARIOS; i++)
+        runScenario(&plant, &settings, &scenarios[i]);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run a scenario and report its figures
+
+@param[in] BuckPlant* initial: plant parameters before the change.
+@param[in] Settings* settings: firmware settings.
+@param[in] Scenario* scenario: the change to make.
+*/
+
+static void runScenario(const BuckPlant* initial, const Settings* settings,
+                        const Scenario* scenario)
+{
+    BuckPlant plant = *initial;
+    Loop loop;
+    memset(&loop, 0, sizeof(loop));
+    buckReset(&plant, &loop.plant);
+    loop.firmwareSettle = -1;
+    controlInit();
+    controlSetGain(settings->gainDivisor);
+    controlSetLedKnee((int32_t)(plant.ledKnee*1000));
+    controlSetLedSlope((int32_t)(plant.ledResistance*1000));
+    controlSetFeedForward(settings->feedForward);
+    loop.setValue = (int32_t)(scenario->setpoint*settings->setpointScale);
+
+/* Reach a steady state, then make the change */
+    if (scenario->change != SCENARIO_STARTUP)
+    {
+        while (loop.plant.time < PRESETTLE_TIME)
+            runPeriod(&plant, settings, &loop);
+    }
+    double start = loop.plant.time;
+    double before = loop.plant.outputCurrentMean;
+    bool step = true;
+    switch (scenario->change)
+    {
+    case SCENARIO_SETPOINT:
+        loop.setValue = (int32_t)(scenario->value*settings->setpointScale);
+        break;
+    case SCENARIO_LOAD:
+        if (plant.loadType == BUCK_LOAD_LED) plant.ledKnee *= scenario->value;
+        else plant.loadResistance *= scenario->value;
+        step = false;
+        break;
+    case SCENARIO_SOURCE:
+        plant.sourceVoltage *= scenario->value;
+        step = false;
+        break;
+    }
+    controlSettlingTime(&loop.firmwareSettle);
+    loop.firmwareSettle = -1;
+
+/* Record the output current of each PWM period after the change */
+    long capacity = (long)(scenario->duration*settings->frequency*1000) + 16;
+    double* current = malloc(capacity*sizeof(double));
+    double* time = malloc(capacity*sizeof(double));
+    double* ripple = malloc(capacity*sizeof(double));
+    long periods = 0;
+    while ((loop.plant.time - start < scenario->duration) &&
+           (periods < capacity))
+    {
+        runPeriod(&plant, settings, &loop);
+        current[periods] = loop.plant.outputCurrentMean;
+        ripple[periods] = loop.plant.outputCurrentMax -
+                          loop.plant.outputCurrentMin;
+        time[periods] = loop.plant.time - start;
+        periods++;
+    }
+
+/* Final value and ripple over the end of the run */
+    long tail = periods - (long)(periods*FINAL_FRACTION);
+    double final = 0;
+    double rippleSum = 0;
+    long k;
+    for (k = tail; k < periods; k++)
+    {
+        final += current[k];
+        rippleSum += ripple[k];
+    }
+    final /= (periods - tail);
+    rippleSum /= (periods - tail);
+
+    double change = final - before;
+    double band = fabs(final)*SETTLE_BAND;
+    double rise10 = -1, rise90 = -1;
+    double peak = 0;
+    double settle = 0;
+    for (k = 0; k < periods; k++)
+    {
+        double progress = (change != 0) ? (current[k] - before)/change : 0;
+        if ((rise10 < 0) && (progress >= 0.1)) rise10 = time[k];
+        if ((rise90 < 0) && (progress >= 0.9)) rise90 = time[k];
+        double excess = current[k] - final;
+        if (step && (change < 0)) excess = -excess;
+        if (! step) excess = fabs(excess);
+        if (excess > peak) peak = excess;
+        if (fabs(current[k] - final) > band) settle = time[k];
+    }
+
+    printf("%-14s ", scenario->name);
+    if (step && (rise10 >= 0) && (rise90 >= 0))
+        printf("%8.1f ", (rise90 - rise10)*1000);
+    else printf("%8s ", "-");
+    if (step && (change != 0))
+        printf("%10.1f %10s ", 100*peak/fabs(change), "-");
+    else printf("%10s %10.1f ", "-", peak*1000);
+    if (settle >= time[periods - 1]) printf("%9s ", "no");
+    else printf("%9.1f ", settle*1000);
+    printf("%10.1f ", rippleSum*1000);
+    if (loop.firmwareSettle >= 0) printf("%9d\n", loop.firmwareSettle);
+    else printf("%9s\n", "-");
+    free(current);
+    free(time);
+    free(ripple);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run one PWM period of the closed loop
+
+The ADC scan and regulator are run at the end of the period in which they
+fall due, as the duty cycle can only change from the next period.
+
+@param[in] BuckPlant* plant: plant parameters.
+@param[in] Settings* settings: firmware settings.
+@param[in,out] Loop* loop: loop state.
+*/
+
+static void runPeriod(const BuckPlant* plant, const Settings* settings,
+                      Loop* loop)
+{
+    uint32_t period = clamp(72000/settings->frequency, 1, 0xFFFF);
+    uint32_t buckOff = 1000 - clamp(loop->buckDutyCycle, 0, 1000);
+    buckStepPeriod(plant, &loop->plant, period, (period*buckOff)/1000);
+    if (loop->plant.time < loop->nextScan) return;
+    loop->nextScan += SCAN_PERIOD;
+    uint8_t channel;
+    for (channel = 0; channel < NUM_CHANNEL; channel++)
+        loop->measured[channel] = buckSample(plant, &loop->plant, channel);
+    if (++loop->scans < REGULATOR_SCANS) return;
+    loop->scans = 0;
+    controlUpdate(&loop->buckDutyCycle, &loop->boostDutyCycle,
+                  loop->setValue, loop->measured[OUTPUT_CURRENT],
+                  loop->measured[INPUT_VOLTAGE],
+                  loop->measured[INPUT_CURRENT],
+                  loop->measured[OUTPUT_VOLTAGE]);
+    int32_t settle;
+    if (controlSettlingTime(&settle)) loop->firmwareSettle = settle;
+}
+
@@ -0,0 +1,369 @@
+/* Switching Buck Converter Model for Host Simulation
+
+A PMOS high side buck converter is simulated through each switching period,
+with the switch timing taken from the timer 1 period and compare values as
+the firmware sets them. The timer counts up and down in centre aligned mode
+and the output is in PWM mode 2, so the high side switch is on while the
+count is at or above the compare value, centred on the top of the count.
+
+- Input: a voltage source with series resistance and an input capacitor.
+- Switch node: the high side switch when on, otherwise a freewheel diode, or
+  the low side switch in synchronous mode. Without the low side switch the
+  inductor current stops at zero, giving discontinuous conduction.
+- Output: inductor with winding resistance and a capacitor with ESR feeding
+  a resistor or an LED string modelled by a knee voltage and slope.
+- Sensing: each measured quantity passes through a first order anti-alias
+  filter and is quantised to the ADC step, as the firmware would see it
+  after calibration.
+
+The states are integrated by fourth order Runge-Kutta, with the steps of
+each switch interval ending exactly on the switching instants.
+
+For long runs there is also a state space averaged model, stepped at the
+regulator's time scale with the switch node at its mean over a PWM period.
+The input capacitor is then taken as settled, as it charges far faster than
+the output filter responds.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "buck-model.h"
+
+/* Longest integration step in seconds, switching and averaged */
+#define STEP_MAX            1e-6
+#define AVERAGE_STEP_MAX    25e-6
+
+/* Integrated states */
+typedef struct {
+    double inductorCurrent;
+    double capacitorVoltage;
+    double inputVoltage;
+} Derivative;
+
+static void integrate(const BuckPlant* plant, BuckState* state,
+                      double dutyCycle, bool averaged, double duration,
+                      double* charge);
+static void derivative(const BuckPlant* plant, const BuckState* state,
+                       double dutyCycle, bool averaged, Derivative* rate);
+static void outputPoint(const BuckPlant* plant, const BuckState* state,
+                        double* voltage, double* current);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Default plant parameters
+
+@param[out] BuckPlant* plant: a 12V supply driving a 1A LED string.
+*/
+
+void buckDefault(BuckPlant* plant)
+{
+    plant->sourceVoltage = 12.0;
+    plant->sourceResistance = 0.1;
+    plant->inputCapacitance = 100e-6;
+    plant->inductance = 100e-6;
+    plant->inductorResistance = 0.1;
+    plant->capacitance = 100e-6;
+    plant->esr = 0.05;
+    plant->switchResistance = 0.05;
+    plant->diodeDrop = 0.4;
+    plant->synchronous = false;
+    plant->loadType = BUCK_LOAD_LED;
+    plant->loadResistance = 8.0;
+    plant->ledKnee = 6.0;
+    plant->ledResistance = 1.5;
+    plant->senseTimeConstant = 20e-6;
+    plant->senseStep[SENSE_OUTPUT_VOLTAGE] = 0.01;
+    plant->senseStep[SENSE_OUTPUT_CURRENT] = 0.001;
+    plant->senseStep[SENSE_INPUT_VOLTAGE] = 0.01;
+    plant->senseStep[SENSE_INPUT_CURRENT] = 0.001;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Start from rest
+
+The output is discharged and the input capacitor charged to the source.
+
+@param[in] BuckPlant* plant: parameters.
+@param[out] BuckState* state: initial state.
+*/
+
+void buckReset(const BuckPlant* plant, BuckState* state)
+{
+    uint8_t channel;
+    state->inductorCurrent = 0;
+    state->capacitorVoltage = 0;
+    state->inputVoltage = plant->sourceVoltage;
+    for (channel = 0; channel < SENSE_CHANNELS; channel++)
+        state->sense[channel] = 0;
+    state->sense[SENSE_INPUT_VOLTAGE] = plant->sourceVoltage;
+    state->time = 0;
+    state->outputCurrentMean = 0;
+    state->outputCurrentMin = 0;
+    state->outputCurrentMax = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Simulate one PWM period
+
+The period runs from one underflow of the timer to the next, so the switch
+is off, on for twice (period - compare) counts, then off again.
+
+@param[in] BuckPlant* plant: parameters.
+@param[in,out] BuckState* state: state.
+@param[in] uint32_t period: timer 1 auto-reload value.
+@param[in] uint32_t compare: timer 1 buck channel compare value.
+*/
+
+void buckStepPeriod(const BuckPlant* plant, BuckState* state,
+                    uint32_t period, uint32_t compare)
+{
+    if (compare > period) compare = period;
+    double edge = compare/TIMER_CLOCK;
+    double onTime = 2*(period - compare)/TIMER_CLOCK;
+    double charge = 0;
+    double current = buckOutputCurrent(plant, state);
+    state->outputCurrentMin = current;
+    state->outputCurrentMax = current;
+    integrate(plant, state, 0, false, edge, &charge);
+    integrate(plant, state, 1, false, onTime, &charge);
+    integrate(plant, state, 0, false, edge, &charge);
+    state->outputCurrentMean = charge/(2*period/TIMER_CLOCK);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Simulate an interval with the averaged model
+
+@param[in] BuckPlant* plant: parameters.
+@param[in,out] BuckState* state: state.
+@param[in] double dutyCycle: fraction of each PWM period the switch is on.
+@param[in] double duration: interval in seconds.
+*/
+
+void buckStepAverage(const BuckPlant* plant, BuckState* state,
+                     double dutyCycle, double duration)
+{
+    double charge = 0;
+    double current = buckOutputCurrent(plant, state);
+    state->outputCurrentMin = current;
+    state->outputCurrentMax = current;
+    if (dutyCycle < 0) dutyCycle = 0;
+    if (dutyCycle > 1) dutyCycle = 1;
+    integrate(plant, state, dutyCycle, true, duration, &charge);
+    state->outputCurrentMean = charge/duration;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Output voltage and load current
+
+@param[in] BuckPlant* plant: parameters.
+@param[in] BuckState* state: state.
+@returns double: voltage across the load in V or current through it in A.
+*/
+
+double buckOutputVoltage(const BuckPlant* plant, const BuckState* state)
+{
+    double voltage, current;
+    outputPoint(plant, state, &voltage, &current);
+    return voltage;
+}
+
+double buckOutputCurrent(const BuckPlant* plant, const BuckState* state)
+{
+    double voltage, current;
+    outputPoint(plant, state, &voltage, &current);
+    return current;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief ADC reading of a sensed quantity
+
+The filtered sensor output is quantised to the ADC step. The ADC cannot read
+below zero.
+
+@param[in] BuckPlant* plant: parameters.
+@param[in] BuckState* state: state.
+@param[in] uint8_t channel: sensed quantity.
+@returns int32_t: reading in mV or mA.
+*/
+
+int32_t buckSample(const BuckPlant* plant, const BuckState* state,
+                   uint8_t channel)
+{
+    double step = plant->senseStep[channel];
+    double value = floor(state->sense[channel]/step + 0.5)*step;
+    if (value < 0) value = 0;
+    return (int32_t)floor(value*1000 + 0.5);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Integrate through one switch interval
+
+Without the low side switch the inductor current is held at zero once it
+has fallen there.
+
+@param[in] BuckPlant* plant: parameters.
+@param[in,out] BuckState* state: state.
+@param[in] double dutyCycle: 1 with the high side switch on, 0 off, or the
+           mean in the averaged model.
+@param[in] bool averaged: averaged model.
+@param[in] double duration: interval in seconds.
+@param[in,out] double* charge: output charge, accumulated.
+*/
+
+static void integrate(const BuckPlant* plant, BuckState* state,
+                      double dutyCycle, bool averaged, double duration,
+                      double* charge)
+{
+    if (duration <= 0) return;
+    int steps = (int)ceil(duration/(averaged ? AVERAGE_STEP_MAX : STEP_MAX));
+    double dt = duration/steps;
+    double filter = 1 - exp(-dt/plant->senseTimeConstant);
+    int step;
+    for (step = 0; step < steps; step++)
+    {
+        BuckState stage = *state;
+        Derivative k[4];
+        double weight[4] = {0.5, 0.5, 1, 0};
+        int i;
+        for (i = 0; i < 4; i++)
+        {
+            derivative(plant, &stage, dutyCycle, averaged, &k[i]);
+            stage = *state;
+            stage.inductorCurrent += weight[i]*dt*k[i].inductorCurrent;
+            stage.capacitorVoltage += weight[i]*dt*k[i].capacitorVoltage;
+            stage.inputVoltage += weight[i]*dt*k[i].inputVoltage;
+        }
+        double before = buckOutputCurrent(plant, state);
+        state->inductorCurrent += dt*(k[0].inductorCurrent +
+            2*k[1].inductorCurrent + 2*k[2].inductorCurrent +
+            k[3].inductorCurrent)/6;
+        state->capacitorVoltage += dt*(k[0].capacitorVoltage +
+            2*k[1].capacitorVoltage + 2*k[2].capacitorVoltage +
+            k[3].capacitorVoltage)/6;
+        state->inputVoltage += dt*(k[0].inputVoltage +
+            2*k[1].inputVoltage + 2*k[2].inputVoltage +
+            k[3].inputVoltage)/6;
+        if ((dutyCycle < 1) && ! plant->synchronous &&
+            (state->inductorCurrent < 0))
+            state->inductorCurrent = 0;
+        if (averaged)
+            state->inputVoltage = plant->sourceVoltage -
+                plant->sourceResistance*dutyCycle*state->inductorCurrent;
+        state->time += dt;
+
+/* Sensors and output current statistics */
+        double voltage, current;
+        outputPoint(plant, state, &voltage, &current);
+        double measured[SENSE_CHANNELS];
+        measured[SENSE_OUTPUT_VOLTAGE] = voltage;
+        measured[SENSE_OUTPUT_CURRENT] = current;
+        measured[SENSE_INPUT_VOLTAGE] = state->inputVoltage;
+        measured[SENSE_INPUT_CURRENT] = (plant->sourceVoltage -
+            state->inputVoltage)/plant->sourceResistance;
+        for (i = 0; i < SENSE_CHANNELS; i++)
+            state->sense[i] += (measured[i] - state->sense[i])*filter;
+        *charge += (before + current)*dt/2;
+        if (current < state->outputCurrentMin)
+            state->outputCurrentMin = current;
+        if (current > state->outputCurrentMax)
+            state->outputCurrentMax = current;
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief State derivatives
+
+The switch node is the mean of its on and off values weighted by the duty
+cycle, which for the switching model is 1 or 0.
+
+@param[in] BuckPlant* plant: parameters.
+@param[in] BuckState* state: state.
+@param[in] double dutyCycle: fraction of the time the switch is on.
+@param[in] bool averaged: the input capacitor is not integrated.
+@param[out] Derivative* rate: rate of change of each state.
+*/
+
+static void derivative(const BuckPlant* plant, const BuckState* state,
+                       double dutyCycle, bool averaged, Derivative* rate)
+{
+    double outputVoltage, loadCurrent;
+    outputPoint(plant, state, &outputVoltage, &loadCurrent);
+    double inductorCurrent = state->inductorCurrent;
+    double onNode = state->inputVoltage -
+                    inductorCurrent*plant->switchResistance;
+    double offNode;
+    if (plant->synchronous)
+        offNode = -inductorCurrent*plant->switchResistance;
+    else if (inductorCurrent > 0) offNode = -plant->diodeDrop;
+/* Discontinuous conduction, the switch node follows the output */
+    else offNode = outputVoltage;
+    double switchNode = dutyCycle*onNode + (1 - dutyCycle)*offNode;
+    rate->inductorCurrent = (switchNode - outputVoltage -
+        inductorCurrent*plant->inductorResistance)/plant->inductance;
+    if ((dutyCycle < 1) && ! plant->synchronous && (inductorCurrent <= 0) &&
+        (rate->inductorCurrent < 0))
+        rate->inductorCurrent = 0;
+    rate->capacitorVoltage = (inductorCurrent - loadCurrent)/
+                             plant->capacitance;
+    rate->inputVoltage = 0;
+    if (! averaged)
+        rate->inputVoltage = ((plant->sourceVoltage - state->inputVoltage)/
+            plant->sourceResistance - dutyCycle*inductorCurrent)/
+            plant->inputCapacitance;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Solve the output node
+
+The load and the capacitor ESR share the inductor current, so the output
+voltage is found from the capacitor voltage and the load characteristic.
+
+@param[in] BuckPlant* plant: parameters.
+@param[in] BuckState* state: state.
+@param[out] double* voltage: output voltage.
+@param[out] double* current: load current.
+*/
+
+static void outputPoint(const BuckPlant* plant, const BuckState* state,
+                        double* voltage, double* current)
+{
+    double open = state->capacitorVoltage +
+                  plant->esr*state->inductorCurrent;
+    if (plant->loadType == BUCK_LOAD_RESISTOR)
+    {
+        *voltage = open/(1 + plant->esr/plant->loadResistance);
+        *current = *voltage/plant->loadResistance;
+    }
+    else if (open <= plant->ledKnee)
+    {
+        *voltage = open;
+        *current = 0;
+    }
+    else
+    {
+        *voltage = (open + plant->esr*plant->ledKnee/plant->ledResistance)/
+                   (1 + plant->esr/plant->ledResistance);
+        *current = (*voltage - plant->ledKnee)/plant->ledResistance;
+    }
+}
+
@@ -0,0 +1,90 @@
+/* Switching Buck Converter Model for Host Simulation
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUCK_MODEL_H_
+#define BUCK_MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Timer 1 clock */
+#define TIMER_CLOCK         72.0e6
+
+/* Load types */
+#define BUCK_LOAD_RESISTOR  0
+#define BUCK_LOAD_LED       1
+
+/* Sensed quantities, in the order of the firmware's measurement array */
+#define SENSE_OUTPUT_VOLTAGE 0
+#define SENSE_OUTPUT_CURRENT 1
+#define SENSE_INPUT_VOLTAGE  2
+#define SENSE_INPUT_CURRENT  3
+#define SENSE_CHANNELS       4
+
+typedef struct {
+    double sourceVoltage;           /* V */
+    double sourceResistance;        /* Ohm */
+    double inputCapacitance;        /* F */
+    double inductance;              /* H */
+    double inductorResistance;      /* Ohm */
+    double capacitance;             /* F */
+    double esr;                     /* Ohm, output capacitor */
+    double switchResistance;        /* Ohm, high and low side switches */
+    double diodeDrop;               /* V, freewheel diode */
+    bool synchronous;               /* Low side switch rather than diode */
+    uint8_t loadType;
+    double loadResistance;          /* Ohm, resistive load */
+    double ledKnee;                 /* V, LED string at zero current */
+    double ledResistance;           /* Ohm, LED string dynamic resistance */
+    double senseTimeConstant;       /* s, sensor anti-alias filters */
+    double senseStep[SENSE_CHANNELS]; /* ADC quantisation, in V or A */
+} BuckPlant;
+
+typedef struct {
+    double inductorCurrent;         /* A */
+    double capacitorVoltage;        /* V, output capacitor less ESR */
+    double inputVoltage;            /* V, input capacitor */
+    double sense[SENSE_CHANNELS];   /* Filtered sensor outputs */
+    double time;                    /* s */
+/* Output current over the last PWM period */
+    double outputCurrentMean;
+    double outputCurrentMin;
+    double outputCurrentMax;
+} BuckState;
+
+void buckDefault(BuckPlant* plant);
+void buckReset(const BuckPlant* plant, BuckState* state);
+void buckStepPeriod(const BuckPlant* plant, BuckState* state,
+                    uint32_t period, uint32_t compare);
+void buckStepAverage(const BuckPlant* plant, BuckState* state,
+                     double dutyCycle, double duration);
+double buckOutputVoltage(const BuckPlant* plant, const BuckState* state);
+double buckOutputCurrent(const BuckPlant* plant, const BuckState* state);
+int32_t buckSample(const BuckPlant* plant, const BuckState* state,
+                   uint8_t channel);
+
+#endif
+
@@ -0,0 +1,155 @@
+/* Command Acknowledgement Test
+
+The firmware's command interpreter is run on the host as in the emulator,
+with command lines fed to it and its acknowledgements checked:
+
+- Valid commands are acknowledged with status 0.
+- An unknown command or an argument out of range is acknowledged as
+  invalid, and no command on its line is acted on.
+- A waveform entry beyond the length of the upload table is acknowledged as
+  rejected, and the commands after it on its line are not acted on.
+
+No samples are taken as capture is left off. Each mismatch is printed, and
+the exit status is the number of failures, up to 255.
+
+Usage: command-test
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "firmware.h"
+#include "commslib.h"
+#include "waveform.h"
+
+#define BAUD_RATE           230400
+/* Scans allowed for a line to be acknowledged */
+#define ACK_SCANS           1000
+#define LINE_SIZE           256
+
+static uint32_t failures = 0;
+
+static int sendLine(const char* line);
+static void expect(const char* line, int expected);
+
+/*--------------------------------------------------------------------------*/
+
+int main(void)
+{
+    firmwareInit(BAUD_RATE);
+
+    expect("ai", COMMAND_OK);
+    expect("zz", COMMAND_INVALID);
+    expect("wr0", COMMAND_INVALID);
+
+/* Fill the waveform upload table, then go beyond it */
+    expect("wz", COMMAND_OK);
+    uint16_t i;
+    for (i = 0; i < WAVEFORM_LENGTH; i++) expect("wa500 wb0", COMMAND_OK);
+    expect("wb0", COMMAND_REJECTED);
+
+/* The erase following the rejected entry is not acted on */
+    expect("wb0 wz", COMMAND_REJECTED);
+    expect("wb0", COMMAND_REJECTED);
+
+/* Nor is any command of an invalid line */
+    expect("wz zz", COMMAND_INVALID);
+    expect("wb0", COMMAND_REJECTED);
+
+    expect("wz", COMMAND_OK);
+    expect("wb0", COMMAND_OK);
+
+    printf("command-test: %u failures\n", failures);
+    return (failures > 255) ? 255 : failures;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Send a command line and wait for its acknowledgement
+
+Responses ahead of the acknowledgement are passed over.
+
+@param[in] const char* line: commands without the line ending.
+@returns int: acknowledgement status, or -1 if none came.
+*/
+
+static int sendLine(const char* line)
+{
+    uint8_t received[LINE_SIZE];
+    uint16_t length = snprintf((char*)received, sizeof(received), "%s\r",
+                               line);
+    uint8_t transmitted[LINE_SIZE];
+    char reply[LINE_SIZE];
+    uint16_t replyLength = 0;
+    uint16_t scanIndex;
+    for (scanIndex = 0; scanIndex < ACK_SCANS; scanIndex++)
+    {
+        FirmwareScan scan;
+        scan.received = received;
+        scan.receivedCount = (scanIndex == 0) ? length : 0;
+        memset(scan.samples, 0, sizeof(scan.samples));
+        scan.transmitted = transmitted;
+        scan.transmitSize = sizeof(transmitted);
+        firmwareAdvance(SCAN_PERIOD, NULL);
+        firmwareStep(&scan);
+
+/* Collect the reply lines and look for the acknowledgement */
+        uint16_t index;
+        for (index = 0; index < scan.transmittedCount; index++)
+        {
+            char character = transmitted[index];
+            if (character == '\r') continue;
+            if (character != '\n')
+            {
+                if (replyLength < sizeof(reply) - 1)
+                    reply[replyLength++] = character;
+                continue;
+            }
+            reply[replyLength] = 0;
+            replyLength = 0;
+            unsigned int sequence, status;
+            if (sscanf(reply, "ack, %u, %u", &sequence, &status) == 2)
+                return status;
+        }
+    }
+    return -1;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check the acknowledgement status of a command line
+
+@param[in] const char* line: commands without the line ending.
+@param[in] int expected: status the line should be acknowledged with.
+*/
+
+static void expect(const char* line, int expected)
+{
+    int status = sendLine(line);
+    if (status == expected) return;
+    failures++;
+    printf("\"%s\" acknowledged with %d, not %d\n", line, status, expected);
+}
+
@@ -0,0 +1,366 @@
+/* Firmware Emulator on Pseudo-Terminals
+
+Each instance runs the firmware's command interpreter, communications and
+telemetry against the averaged model of the buck converter, and is presented
+as a Linux pseudo-terminal that host tools open in place of the board's
+serial port. Instances are separate processes, as the firmware keeps its
+state in globals, so dozens may run together to load test host tooling.
+
+The main loop of the firmware (see firmware.c) is followed at the timer 2
+scan rate in real time, and must be kept in step with it. Received
+characters are given to the USART ISR at the character rate of the
+configured baud rate, or of the rate negotiated since. Characters
+transmitted and not read by the host are dropped as on a serial line.
+Before each scan the plant is driven by the emulated timer 1 outputs and its
+sensors sampled.
+
+Usage: emulator [-n instances] [-b baud] [-d directory] [-r directory]
+
+The pseudo-terminal of each instance is printed as "smps-<n> <path>", and
+with -d a symbolic link smps-<n> to it is made in the directory. With -r
+each instance records its inputs and outputs to smps-<n>.rec in the
+directory, for the replay tool. The emulator runs until interrupted.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "buck-model.h"
+#include "firmware.h"
+#include "record.h"
+#include "serial-speed.h"
+
+/* Scans run together at each wakeup, which bounds the scheduling load of
+many instances at the cost of the latency of each */
+#define SCANS_PER_WAKE      8
+/* Scans behind real time after which the emulator gives up catching up */
+#define SCAN_SLIP_MAX       100
+/* Characters held between the pseudo-terminal and the emulated USART */
+#define SERIAL_BUFFER_SIZE  4096
+#define INSTANCES_MAX       256
+
+/* Simulated plant */
+static BuckPlant plant;
+static BuckState state;
+
+static volatile sig_atomic_t stopping;
+
+static void runInstance(int master, const char* slavePath, uint32_t baud,
+                        const char* recordPath);
+static void drivePlant(double dutyCycle, bool synchronous, double duration);
+static void stopHandler(int signal);
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    int instances = 1;
+    uint32_t baud = BAUDRATE;
+    const char* directory = NULL;
+    const char* recordDirectory = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "n:b:d:r:")) != -1)
+    {
+        switch (option)
+        {
+        case 'n':
+            instances = atoi(optarg);
+            if ((instances > 0) && (instances <= INSTANCES_MAX)) break;
+            fprintf(stderr, "Instances must be 1 to %d\n", INSTANCES_MAX);
+            return 1;
+        case 'b':
+            baud = atol(optarg);
+            if (baud >= 300) break;
+            fprintf(stderr, "Invalid baud rate\n");
+            return 1;
+        case 'd':
+            directory = optarg;
+            break;
+        case 'r':
+            recordDirectory = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: emulator [-n instances] [-b baud] "
+                            "[-d directory] [-r directory]\n");
+            return 1;
+        }
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopHandler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    static pid_t child[INSTANCES_MAX];
+    static char links[INSTANCES_MAX][256];
+    int started = 0;
+    while ((started < instances) && ! stopping)
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0))
+        {
+            perror("posix_openpt");
+            break;
+        }
+        char slavePath[256];
+        if (ptsname_r(master, slavePath, sizeof(slavePath)) != 0)
+        {
+            perror("ptsname");
+            close(master);
+            break;
+        }
+        links[started][0] = 0;
+        if (directory != NULL)
+        {
+            snprintf(links[started], sizeof(links[started]), "%s/smps-%d",
+                     directory, started);
+            unlink(links[started]);
+            if (symlink(slavePath, links[started]) < 0)
+            {
+                perror(links[started]);
+                links[started][0] = 0;
+            }
+        }
+        char recordPath[256];
+        recordPath[0] = 0;
+        if (recordDirectory != NULL)
+            snprintf(recordPath, sizeof(recordPath), "%s/smps-%d.rec",
+                     recordDirectory, started);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            signal(SIGINT, SIG_IGN);
+            runInstance(master, slavePath, baud,
+                        (recordPath[0] != 0) ? recordPath : NULL);
+            _exit(0);
+        }
+        close(master);
+        if (pid < 0)
+        {
+            perror("fork");
+            break;
+        }
+        child[started++] = pid;
+        printf("smps-%d %s\n", started - 1, slavePath);
+        fflush(stdout);
+    }
+
+/* Wait for the instances until interrupted, then stop them all */
+    int running = started;
+    while (running > 0)
+    {
+        if (stopping)
+        {
+            int i;
+            for (i = 0; i < started; i++)
+                if (child[i] > 0) kill(child[i], SIGTERM);
+        }
+        pid_t pid = wait(NULL);
+        if (pid < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int i;
+        for (i = 0; i < started; i++)
+        {
+            if (child[i] != pid) continue;
+            child[i] = 0;
+            if (! stopping) fprintf(stderr, "smps-%d stopped\n", i);
+        }
+        running--;
+    }
+    int i;
+    for (i = 0; i < started; i++)
+        if (links[i][0] != 0) unlink(links[i]);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run one instance
+
+The slave side is held open so that host tools may open and close it at
+will, and is set raw at the baud rate. Scans are run in groups at their real
+time, with the characters due in each passed each way, and the characters
+sent over the group written together. The instance runs until terminated.
+
+@param[in] int master: pseudo-terminal master, nonblocking.
+@param[in] char* slavePath: pseudo-terminal slave.
+@param[in] uint32_t baud: serial rate.
+@param[in] char* recordPath: recording to write, or NULL.
+*/
+
+static void runInstance(int master, const char* slavePath, uint32_t baud,
+                        const char* recordPath)
+{
+    int slave = open(slavePath, O_RDWR | O_NOCTTY);
+    if (slave < 0)
+    {
+        perror(slavePath);
+        return;
+    }
+    struct termios settings;
+    if (tcgetattr(slave, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        speed_t speed = baudConstant(baud);
+        if (speed != B0) cfsetspeed(&settings, speed);
+        tcsetattr(slave, TCSANOW, &settings);
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    static Recording recording;
+    static RecordScan record;
+    if ((recordPath != NULL) && ! recordCreate(&recording, recordPath, baud))
+    {
+        perror(recordPath);
+        recordPath = NULL;
+    }
+
+    buckDefault(&plant);
+    buckReset(&plant, &state);
+    firmwareInit(baud);
+
+    static uint8_t receive[SERIAL_BUFFER_SIZE];
+    static uint8_t transmit[SERIAL_BUFFER_SIZE];
+    uint16_t received = 0;
+    uint16_t receiveNext = 0;
+    double characters;
+    double receiveCredit = 0;
+    struct timespec due;
+    clock_gettime(CLOCK_MONOTONIC, &due);
+    bool open = true;
+    while (open && ! stopping)
+    {
+        due.tv_nsec += (long)(SCANS_PER_WAKE*SCAN_PERIOD*1e9);
+        if (due.tv_nsec >= 1000000000)
+        {
+            due.tv_nsec -= 1000000000;
+            due.tv_sec++;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double late = (now.tv_sec - due.tv_sec) +
+                      (now.tv_nsec - due.tv_nsec)*1e-9;
+        if (late > SCAN_SLIP_MAX*SCAN_PERIOD) due = now;
+        else if (late < 0)
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+
+        uint16_t sent = 0;
+        uint8_t scanIndex;
+        for (scanIndex = 0; scanIndex < SCANS_PER_WAKE; scanIndex++)
+        {
+            firmwareAdvance(SCAN_PERIOD, drivePlant);
+
+/* Receive the characters that have arrived over the scan */
+            if (receiveNext == received)
+            {
+                receiveNext = 0;
+                ssize_t count = read(master, receive, sizeof(receive));
+                received = (count > 0) ? count : 0;
+            }
+            characters = firmwareBaud()/10.0*SCAN_PERIOD;
+            receiveCredit += characters;
+            FirmwareScan scan;
+            scan.received = receive + receiveNext;
+            scan.receivedCount = 0;
+            while ((receiveCredit >= 1) && (receiveNext < received))
+            {
+                scan.receivedCount++;
+                receiveNext++;
+                receiveCredit--;
+            }
+            if (receiveCredit > characters + 1)
+                receiveCredit = characters + 1;
+
+            uint8_t channel;
+            for (channel = 0; channel < NUM_CHANNEL; channel++)
+                scan.samples[channel] = buckSample(&plant, &state, channel);
+            scan.transmitted = transmit + sent;
+            scan.transmitSize = sizeof(transmit) - sent;
+            firmwareStep(&scan);
+            sent += scan.transmittedCount;
+
+            if (recordPath == NULL) continue;
+            record.sampled = scan.sampled;
+            memcpy(record.samples, scan.samples, sizeof(record.samples));
+            record.receivedCount = scan.receivedCount;
+            memcpy(record.received, scan.received, scan.receivedCount);
+            record.transmittedCount = scan.transmittedCount;
+            memcpy(record.transmitted, scan.transmitted,
+                   scan.transmittedCount);
+            firmwarePwm(&record.pwm);
+            if (! recordWrite(&recording, &record))
+            {
+                perror(recordPath);
+                recordClose(&recording);
+                recordPath = NULL;
+            }
+        }
+        if (sent > 0)
+        {
+            ssize_t count = write(master, transmit, sent);
+            if ((count < 0) && (errno != EAGAIN) && (errno != EIO))
+                open = false;
+        }
+    }
+    if (recordPath != NULL) recordClose(&recording);
+    close(slave);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Drive the plant over part of a scan
+
+@param[in] double dutyCycle: buck duty cycle from 0 to 1.
+@param[in] bool synchronous: low side switch used.
+@param[in] double duration: interval in s.
+*/
+
+static void drivePlant(double dutyCycle, bool synchronous, double duration)
+{
+    plant.synchronous = synchronous;
+    buckStepAverage(&plant, &state, dutyCycle, duration);
+}
+
+/*--------------------------------------------------------------------------*/
+
+static void stopHandler(int signal)
+{
+    (void)signal;
+    stopping = true;
+}
+
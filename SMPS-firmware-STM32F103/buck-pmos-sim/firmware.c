@@ -0,0 +1,397 @@
+/* Firmware Main Loop on the Host
+
+The firmware's main loop in mainloop.c is run here one timer 2 scan at a
+time, against emulated timer 1 outputs. The emulator drives a plant model
+with the outputs and samples it, and the replay tool feeds recorded samples
+instead, so the two run exactly the same firmware code in the same order as
+the device.
+
+Each scan:
+
+- Receives the characters given to it in the USART ISR.
+- Runs one pass of the main loop.
+- While capture is on runs the timer 2 compare of the main loop, then has
+  the ADC ISR calibrate the samples, account the energy and check for a
+  capture trigger.
+- Takes the characters transmitted over the scan at the baud rate, which
+  follows the link rate negotiated.
+
+The simulated time, and so the DWT cycle counter, is the number of scans run.
+The state of the firmware depends only on the characters received and the
+samples, which makes a run repeatable.
+
+The timer 1 functions act on emulated compare registers. The buck duty cycle
+drives the plant, reduced in proportion to the periods skipped in burst
+operation, and waveform tables are stepped through at the PWM rate. There is
+no boost stage or dead time, so those settings have no effect, and no
+switching ripple for spectrum analysis. A triggered burst capture completes
+within the scan that triggered it, and as the plant changes no faster than
+the scans it holds that scan repeated. Each scan is handled as its compare
+occurs, so its lateness is none and the regulator deadline is never missed.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "firmware.h"
+#include "hal.h"
+#include "buffer.h"
+#include "commslib.h"
+#include "commands.h"
+#include "control.h"
+#include "calibration.h"
+#include "fixmath.h"
+#include "deadtime.h"
+#include "mppt.h"
+#include "lightload.h"
+#include "energy.h"
+#include "autotune.h"
+#include "profile.h"
+#include "waveform.h"
+#include "brightness.h"
+#include "latency.h"
+#include "acquisition.h"
+#include "deadline.h"
+#include "link.h"
+#include "store.h"
+#include "mainloop.h"
+
+/*--------------------------------------------------------------------------*/
+/* Firmware globals, defined in the main file on the device */
+
+uint32_t v[NUM_CHANNEL];
+volatile int32_t measured[NUM_CHANNEL];
+uint8_t adceoc;
+uint16_t dataBlockSize;
+uint8_t capture;
+uint16_t frequency;
+int16_t ch1DutyCycle;
+int16_t ch2DutyCycle;
+int32_t isValue = 0, setValue = 0;
+bool synchronous;
+uint8_t deadtime;
+
+/*--------------------------------------------------------------------------*/
+/* Emulated timer 1 */
+
+static FirmwarePwm pwm;
+/* Waveform playback position */
+static uint16_t waveformEntry;
+static double waveformHeld;         /* s, of the current entry */
+
+/* Scans run, and the characters that may be transmitted */
+static uint64_t scans;
+static uint32_t baudRate;
+static double characters;
+static double transmitCredit;
+
+static void firmwareAdc(const uint32_t* samples);
+static double compareDutyCycle(uint32_t compare);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Firmware initialisation
+
+As in main() following the peripheral setup.
+
+@param[in] uint32_t baud: serial rate, which paces transmission.
+*/
+
+void firmwareInit(uint32_t baud)
+{
+    scans = 0;
+    baudRate = baud;
+    characters = baud/10.0*SCAN_PERIOD;
+    transmitCredit = 0;
+    mainLoopInit(baud);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Advance the emulated timer 1 to the next scan
+
+The buck compare value is held over the interval except during waveform
+playback, where each table entry is held for its number of PWM periods and
+the end of table action taken as by the DMA ISR.
+
+@param[in] double duration: interval in s.
+@param[in] FirmwareDrive drive: given each duty cycle in turn, or NULL.
+*/
+
+void firmwareAdvance(double duration, FirmwareDrive drive)
+{
+    while (waveformRunning() && (duration > 0))
+    {
+        volatile uint16_t* table = waveformTable();
+        double hold = waveformRepeat()*pwm.period/TIMER_CLOCK;
+        pwm.buckCompare = table[waveformEntry*WAVEFORM_CHANNELS];
+        double step = hold - waveformHeld;
+        if (step > duration) step = duration;
+        if (drive != NULL)
+            drive(compareDutyCycle(pwm.buckCompare), pwm.synchronous, step);
+        duration -= step;
+        waveformHeld += step;
+        if (waveformHeld < hold) break;
+        waveformHeld = 0;
+        if (++waveformEntry < waveformTransfers()/WAVEFORM_CHANNELS) continue;
+        waveformEntry = 0;
+        if (waveformTableEnd() == WAVEFORM_STOP) timer1WaveformStop();
+    }
+    if ((duration <= 0) || (drive == NULL)) return;
+    double dutyCycle = compareDutyCycle(pwm.buckCompare);
+    if (pwm.burstOffPeriods > 0)
+        dutyCycle = dutyCycle*BURST_ON_PERIODS/
+                    (BURST_ON_PERIODS + pwm.burstOffPeriods);
+    drive(dutyCycle, pwm.synchronous, duration);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Run one timer 2 scan
+
+The transmitted characters are limited to the buffer given, which should
+hold those of a scan at the baud rate so that the pacing is not changed.
+
+@param[in,out] FirmwareScan* scan: inputs of the scan, and its outputs.
+*/
+
+void firmwareStep(FirmwareScan* scan)
+{
+    halSetTime(scans*SCAN_PERIOD);
+    scans++;
+    uint16_t index;
+    for (index = 0; index < scan->receivedCount; index++)
+        halUsartReceive(scan->received[index]);
+    mainLoopPass();
+    scan->sampled = capture && mainLoopScan(0);
+    if (scan->sampled) firmwareAdc(scan->samples);
+
+/* Take what the firmware has queued, up to the characters due */
+    scan->transmittedCount = 0;
+    transmitCredit += characters;
+    while ((transmitCredit >= 1) &&
+           (scan->transmittedCount < scan->transmitSize))
+    {
+        int character = halUsartTransmit();
+        if (character < 0) break;
+        scan->transmitted[scan->transmittedCount++] = character;
+        transmitCredit--;
+    }
+    if (transmitCredit > characters + 1) transmitCredit = characters + 1;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Emulated timer 1 outputs
+
+@param[out] FirmwarePwm* outputs: period, compare and burst settings.
+*/
+
+void firmwarePwm(FirmwarePwm* outputs)
+{
+    *outputs = pwm;
+}
+
+/*--------------------------------------------------------------------------*/
+
+uint64_t firmwareScans(void)
+{
+    return scans;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Serial link rate
+
+Changed by negotiation, so the receiving side is to follow it.
+
+@returns uint32_t: baud rate in use.
+*/
+
+uint32_t firmwareBaud(void)
+{
+    return baudRate;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief ADC scan and ISR
+
+@param[in] uint32_t* samples: ADC results, in mV and mA as the calibration
+defaults to unity.
+*/
+
+static void firmwareAdc(const uint32_t* samples)
+{
+    latencyMark(LATENCY_ADC);
+    memcpy(v, samples, sizeof(v));
+    uint32_t entry = latencyEnter(LATENCY_ADC);
+    adceoc = 1;
+    calibrateScan(v, measured);
+    energyAccumulate(measured[INPUT_VOLTAGE], measured[INPUT_CURRENT],
+                     measured[OUTPUT_VOLTAGE], measured[OUTPUT_CURRENT]);
+    int32_t setpoint = (controlGetMode() == CONTROL_MPPT) ? 0 : setValue;
+    if (acquisitionScan(v, measured, setpoint))
+    {
+        uint16_t* burst = acquisitionBurstBuffer();
+        uint16_t index;
+        for (index = 0; index < acquisitionBurstScans()*NUM_CHANNEL; index++)
+            burst[index] = v[index % NUM_CHANNEL];
+        acquisitionBurstEnd();
+    }
+    latencyExit(LATENCY_ADC, entry);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Duty cycle of a compare value
+
+In PWM mode 2 the compare value sets the off time.
+
+@param[in] uint32_t compare: CCR value.
+@returns double: duty cycle from 0 to 1.
+*/
+
+static double compareDutyCycle(uint32_t compare)
+{
+    if (compare >= pwm.period) return 0;
+    return (double)(pwm.period - compare)/pwm.period;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Emulated main file functions, called from the command interpreter */
+/*--------------------------------------------------------------------------*/
+/** @brief Timer 1 Set PWM Parameters
+
+@param[in] uint16_t pwmFrequency: frequency in kHz.
+@param[in] int16_t buckDutyCycle: promille duty cycle
+@param[in] int16_t boostDutyCycle: promille duty cycle
+*/
+
+void timer1PWMsettings(uint16_t pwmFrequency, int16_t buckDutyCycle,
+                       int16_t boostDutyCycle)
+{
+    static uint16_t lastFrequency = 0;
+    (void)boostDutyCycle;
+    if (pwmFrequency != lastFrequency)
+    {
+        pwm.period = pwmPeriodTable[clamp(pwmFrequency, 1,
+                                            PWM_FREQUENCY_MAX)];
+        lastFrequency = pwmFrequency;
+        waveformConvert(pwm.period);
+    }
+    if (waveformRunning()) return;
+    uint32_t buckOff = 1000 - clamp(buckDutyCycle, 0, 1000);
+    pwm.buckCompare = (pwm.period*buckOff)/1000;
+}
+
+void timer1SetSynchronous(bool enable)
+{
+    pwm.synchronous = enable;
+}
+
+void timer1SetDeadtime(uint8_t deadtimeSetting)
+{
+    (void)deadtimeSetting;
+}
+
+void timer1SetBurst(uint8_t offPeriods)
+{
+    pwm.burstOffPeriods = offPeriods;
+}
+
+bool timer1WaveformPlay(void)
+{
+    bool playing = waveformRunning();
+    if (! waveformPlay(pwm.period)) return false;
+    if (playing) return true;
+    timer1SetBurst(0);
+    waveformEntry = 0;
+    waveformHeld = 0;
+    return true;
+}
+
+void timer1WaveformStop(void)
+{
+    waveformStop();
+}
+
+uint32_t timer1Period(void)
+{
+    return pwm.period;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief ADC block capture
+
+The plant is averaged over each PWM period, so there is no switching ripple
+to sample. The block holds the input as last scanned, which analyses to no
+ripple at all.
+*/
+
+bool adcCaptureBlock(uint8_t channel, uint16_t* block, uint16_t count,
+                     uint16_t samplePeriod, uint32_t* start)
+{
+    (void)samplePeriod;
+    uint16_t i;
+    for (i = 0; i < count; i++) block[i] = v[channel - 4];
+    *start = 0;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief USART rate change
+
+The transmitter is always idle when the transmit buffer is, so the rate
+changes at once, pacing the characters taken from the next scan.
+
+@param[in] uint32_t baud: new rate.
+*/
+
+void usartSetRate(uint32_t baud)
+{
+    baudRate = baud;
+    characters = baud/10.0*SCAN_PERIOD;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief ADC burst restore
+
+The emulated burst leaves nothing to restore.
+*/
+
+void adcBurstRestore(void)
+{
+}
+
+int32_t power(int32_t voltage, int32_t current)
+{
+    return mulSaturate(voltage, current, 0)/1000;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Fixed point arithmetic cycle benchmark
+
+Processor cycles are not emulated, so none are reported.
+*/
+
+void cycleBenchmark(void)
+{
+    dataMessageSend("db", 0, 0);
+}
+
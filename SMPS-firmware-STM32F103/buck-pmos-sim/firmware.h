@@ -0,0 +1,72 @@
+/* Firmware Main Loop on the Host
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRMWARE_H_
+#define FIRMWARE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buck-model.h"
+#include "buck-pmos-data-capture.h"
+
+/* Timer 2 scan period */
+#define SCAN_PERIOD         (65536/TIMER_CLOCK)
+
+/* Emulated timer 1 outputs */
+typedef struct {
+    uint32_t period;                /* Timer counts */
+    uint32_t buckCompare;           /* PWM mode 2, sets the off time */
+    uint8_t burstOffPeriods;
+    bool synchronous;
+} FirmwarePwm;
+
+/* One timer 2 scan. The received characters are given to the USART before
+the commands are actioned, and the samples are taken by the ADC if capture
+is on. */
+typedef struct {
+    const uint8_t* received;
+    uint16_t receivedCount;
+    uint32_t samples[NUM_CHANNEL];
+    bool sampled;                   /* The samples were taken */
+    uint8_t* transmitted;           /* Characters sent over the scan */
+    uint16_t transmitSize;
+    uint16_t transmittedCount;
+} FirmwareScan;
+
+/* Drives the plant with the duty cycle over part of a scan */
+typedef void (*FirmwareDrive)(double dutyCycle, bool synchronous,
+                              double duration);
+
+void firmwareInit(uint32_t baud);
+void firmwareAdvance(double duration, FirmwareDrive drive);
+void firmwareStep(FirmwareScan* scan);
+void firmwarePwm(FirmwarePwm* pwm);
+uint64_t firmwareScans(void);
+uint32_t firmwareBaud(void);
+
+#endif
+
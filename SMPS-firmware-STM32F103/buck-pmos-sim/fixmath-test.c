@@ -0,0 +1,258 @@
+/* Fixed Point Arithmetic Test
+
+The firmware's fixed point helpers are checked against plain C arithmetic
+on the host, which must give the same results bit for bit:
+
+- reciprocalDivide() against n/d, and reciprocalDivideSigned() against C
+  division of the clamped numerator, over divisors from 1 to the largest,
+  with numerators at the edges of the range and at random.
+- saturate32(), addSaturate(), subSaturate() and mulSaturate() against the
+  64 bit result clamped to 32 bits, and clamp() against its definition, at
+  the edges of the 32 bit range and at random.
+
+The random values come from a fixed seed, so a failure repeats. Each
+mismatch is printed, and the exit status is the number of failures, up to
+255.
+
+Usage: fixmath-test [random cases]
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "fixmath.h"
+
+#define RANDOM_CASES        1000000
+#define FAILURES_SHOWN      20
+
+/* Divisors at the edges: small, powers of two and either side of them, the
+gain divisors in use, and the largest */
+static const uint32_t edgeDivisors[] = {
+    1, 2, 3, 5, 7, 10, 50, 100, 127, 128, 129, 1000, 1023, 1024, 1025,
+    65535, 65536, 65537, 1000000, (1UL << 27) - 1, 1UL << 27,
+    (1UL << 28) - 1, 1UL << 28, (1UL << 28) + 1, 0x7FFFFFFF, 0x80000000,
+    0xFFFFFFFE, 0xFFFFFFFF,
+};
+
+#define NUM_EDGE_DIVISORS (sizeof(edgeDivisors)/sizeof(uint32_t))
+
+static const int32_t edgeValues[] = {
+    0, 1, -1, 2, -2, 0x7FFF, -0x8000, 0xFFFF, 0x10000, -0x10000,
+    RECIPROCAL_LIMIT - 1, RECIPROCAL_LIMIT, 1 - RECIPROCAL_LIMIT,
+    -RECIPROCAL_LIMIT, 0x3FFFFFFF, -0x40000000, INT32_MAX - 1, INT32_MAX,
+    INT32_MIN + 1, INT32_MIN,
+};
+
+#define NUM_EDGE_VALUES (sizeof(edgeValues)/sizeof(int32_t))
+
+static uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+static uint32_t failures = 0;
+
+static uint32_t random32(void);
+static uint32_t randomDivisor(void);
+static int32_t randomValue(void);
+static void checkDivision(uint32_t divisor, uint32_t numerator);
+static void checkSignedDivision(uint32_t divisor, int32_t numerator);
+static void checkSaturation(int32_t a, int32_t b);
+static int64_t reference32(int64_t value);
+static void fail(const char* test, int64_t a, int64_t b, int64_t result,
+                 int64_t expected);
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    uint32_t cases = RANDOM_CASES;
+    if (argc > 1) cases = strtoul(argv[1], NULL, 0);
+
+/* Divisions at the edges */
+    uint32_t i, j;
+    for (i = 0; i < NUM_EDGE_DIVISORS; i++)
+    {
+        uint32_t divisor = edgeDivisors[i];
+        for (j = 0; j < NUM_EDGE_VALUES; j++)
+        {
+            checkSignedDivision(divisor, edgeValues[j]);
+            if ((edgeValues[j] >= 0) && (edgeValues[j] < RECIPROCAL_LIMIT))
+                checkDivision(divisor, edgeValues[j]);
+        }
+/* Either side of each multiple of the divisor near the numerator limit */
+        uint32_t multiple = (RECIPROCAL_LIMIT - 1)/divisor*divisor;
+        checkDivision(divisor, multiple);
+        if (multiple > 0) checkDivision(divisor, multiple - 1);
+        if (divisor < RECIPROCAL_LIMIT)
+        {
+            checkDivision(divisor, divisor - 1);
+            checkDivision(divisor, divisor);
+            if (divisor + 1 < RECIPROCAL_LIMIT)
+                checkDivision(divisor, divisor + 1);
+        }
+    }
+/* Small divisors, as for the gain divisor, with every small numerator */
+    for (i = 1; i <= 1000; i++)
+        for (j = 0; j < 4096; j++) checkDivision(i, j);
+
+/* Saturating arithmetic at the edges */
+    for (i = 0; i < NUM_EDGE_VALUES; i++)
+        for (j = 0; j < NUM_EDGE_VALUES; j++)
+            checkSaturation(edgeValues[i], edgeValues[j]);
+
+/* Random cases */
+    for (i = 0; i < cases; i++)
+    {
+        uint32_t divisor = randomDivisor();
+        checkDivision(divisor, random32() % RECIPROCAL_LIMIT);
+        checkSignedDivision(divisor, randomValue());
+        checkSaturation(randomValue(), randomValue());
+    }
+
+    printf("fixmath-test: %u failures\n", failures);
+    return (failures > 255) ? 255 : failures;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check unsigned division by a runtime constant
+
+@param[in] uint32_t divisor: non zero divisor.
+@param[in] uint32_t numerator: less than RECIPROCAL_LIMIT.
+*/
+
+static void checkDivision(uint32_t divisor, uint32_t numerator)
+{
+    Reciprocal reciprocal;
+    reciprocalInit(&reciprocal, divisor);
+    uint32_t result = reciprocalDivide(&reciprocal, numerator);
+    if (result != numerator/divisor)
+        fail("reciprocalDivide", numerator, divisor, result,
+             numerator/divisor);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check signed division by a runtime constant
+
+The numerator is clamped as documented, then divided as in C.
+
+@param[in] uint32_t divisor: non zero divisor.
+@param[in] int32_t numerator: any value.
+*/
+
+static void checkSignedDivision(uint32_t divisor, int32_t numerator)
+{
+    Reciprocal reciprocal;
+    reciprocalInit(&reciprocal, divisor);
+    int32_t result = reciprocalDivideSigned(&reciprocal, numerator);
+    int64_t limited = numerator;
+    if (limited > RECIPROCAL_LIMIT - 1) limited = RECIPROCAL_LIMIT - 1;
+    if (limited < 1 - RECIPROCAL_LIMIT) limited = 1 - RECIPROCAL_LIMIT;
+    int64_t expected = limited/(int64_t)divisor;
+    if (result != expected)
+        fail("reciprocalDivideSigned", numerator, divisor, result, expected);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Check the saturating helpers on a pair of values
+
+mulSaturate() is checked with the shifts the firmware uses.
+
+@param[in] int32_t a: first operand.
+@param[in] int32_t b: second operand.
+*/
+
+static void checkSaturation(int32_t a, int32_t b)
+{
+    static const uint8_t shifts[] = {0, 1, 8, 15, 16, 31};
+    int64_t expected = reference32(a + (int64_t)b);
+    if (addSaturate(a, b) != expected)
+        fail("addSaturate", a, b, addSaturate(a, b), expected);
+    expected = reference32(a - (int64_t)b);
+    if (subSaturate(a, b) != expected)
+        fail("subSaturate", a, b, subSaturate(a, b), expected);
+    uint8_t i;
+    for (i = 0; i < sizeof(shifts); i++)
+    {
+        int64_t product = (int64_t)a*b;
+/* Arithmetic shift written as a floor division */
+        int64_t quotient = product/((int64_t)1 << shifts[i]);
+        if ((quotient*((int64_t)1 << shifts[i]) != product) && (product < 0))
+            quotient--;
+        expected = reference32(quotient);
+        if (mulSaturate(a, b, shifts[i]) != expected)
+            fail("mulSaturate", a, b, mulSaturate(a, b, shifts[i]), expected);
+    }
+    int64_t wide = (int64_t)a*0x10000 + b;
+    if (saturate32(wide) != reference32(wide))
+        fail("saturate32", a, b, saturate32(wide), reference32(wide));
+    int32_t low = (a < b) ? a : b;
+    int32_t high = (a < b) ? b : a;
+    int32_t value = randomValue();
+    expected = (value < low) ? low : (value > high) ? high : value;
+    if (clamp(value, low, high) != expected)
+        fail("clamp", value, low, clamp(value, low, high), expected);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Limit a 64 bit value to 32 bits by comparison */
+
+static int64_t reference32(int64_t value)
+{
+    if (value > INT32_MAX) return INT32_MAX;
+    if (value < INT32_MIN) return INT32_MIN;
+    return value;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static void fail(const char* test, int64_t a, int64_t b, int64_t result,
+                 int64_t expected)
+{
+    if (failures++ < FAILURES_SHOWN)
+        printf("%s(%" PRId64 ", %" PRId64 ") gave %" PRId64 ", not %" PRId64
+               "\n", test, a, b, result, expected);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Random values, xorshift64* */
+
+static uint32_t random32(void)
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (uint32_t)((randomState*0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/* Divisors spread over all magnitudes */
+static uint32_t randomDivisor(void)
+{
+    uint32_t divisor = random32() >> (random32() % 32);
+    return (divisor == 0) ? 1 : divisor;
+}
+
+/* Values spread over all magnitudes and both signs */
+static int32_t randomValue(void)
+{
+    return (int32_t)random32() >> (random32() % 32);
+}
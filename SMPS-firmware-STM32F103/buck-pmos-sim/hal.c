@@ -0,0 +1,201 @@
+/* Host Hardware Layer for the Firmware Emulator
+
+The few libopencm3 functions called by the firmware modules built into the
+emulator are implemented here over simulated hardware.
+
+- USART2 is its status, data and control registers, which the ISR uses
+  directly. The emulator presents characters and takes transmitted ones at
+  the baud rate, calling the firmware's USART ISR for each with RXNE or TXE
+  set. A character transmitted is one written to the data register.
+- The DWT cycle counter follows simulated time.
+- FLASH is the firmware's configuration block and parameter store in the
+  host image, which the host linker places with the writable data. The
+  firmware's RAM resident programming functions of flashprog.c are replaced
+  here. Erasing fills a page of the store with ones, and is not needed for
+  the configuration block as every word of it is programmed.
+- Interrupts are direct calls from the emulator's single thread, so masking
+  and the interrupt controller have nothing to do.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/usart.h>
+
+#include "hal.h"
+#include "commslib.h"
+#include "store.h"
+#include "flashprog.h"
+
+extern const volatile uint32_t storePages[STORE_BANKS][STORE_BANK_WORDS];
+
+/*--------------------------------------------------------------------------*/
+/* Simulated peripheral state */
+
+static double time;
+volatile uint32_t halUsartRegisters[3];
+
+/* Data register content while no character has been written */
+#define USART_DR_UNWRITTEN  0xFFFFFFFF
+
+/*--------------------------------------------------------------------------*/
+/** @brief Set the simulated time
+
+@param[in] double seconds: time from reset.
+*/
+
+void halSetTime(double seconds)
+{
+    time = seconds;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Present a received character to the firmware
+
+*/
+
+void halUsartReceive(uint8_t character)
+{
+    USART_DR(USART2) = character;
+    USART_SR(USART2) = USART_SR_RXNE;
+    usart2_isr();
+    USART_SR(USART2) = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Take a character from the firmware
+
+The transmit interrupt is serviced if enabled.
+
+@returns int: the character sent, or -1 if there was nothing to send.
+*/
+
+int halUsartTransmit(void)
+{
+    if (! (USART_CR1(USART2) & USART_CR1_TXEIE)) return -1;
+    USART_DR(USART2) = USART_DR_UNWRITTEN;
+    USART_SR(USART2) = USART_SR_TXE;
+    usart2_isr();
+    USART_SR(USART2) = 0;
+    if (USART_DR(USART2) == USART_DR_UNWRITTEN) return -1;
+    return USART_DR(USART2) & 0xFF;
+}
+
+/*--------------------------------------------------------------------------*/
+/* USART2 */
+
+void usart_send(uint32_t usart, uint16_t data)
+{
+    (void)usart;
+    USART_DR(usart) = data & 0xFF;
+}
+
+uint16_t usart_recv(uint32_t usart)
+{
+    (void)usart;
+    return USART_DR(usart) & 0xFF;
+}
+
+bool usart_get_flag(uint32_t usart, uint32_t flag)
+{
+    (void)usart;
+    return (USART_SR(usart) & flag) != 0;
+}
+
+void usart_enable_rx_interrupt(uint32_t usart)
+{
+    (void)usart;
+}
+
+void usart_disable_rx_interrupt(uint32_t usart)
+{
+    (void)usart;
+}
+
+void usart_enable_tx_interrupt(uint32_t usart)
+{
+    (void)usart;
+    USART_CR1(usart) |= USART_CR1_TXEIE;
+}
+
+void usart_disable_tx_interrupt(uint32_t usart)
+{
+    (void)usart;
+    USART_CR1(usart) &= ~USART_CR1_TXEIE;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Core */
+
+void cm_disable_interrupts(void)
+{
+}
+
+void cm_enable_interrupts(void)
+{
+}
+
+void nvic_enable_irq(uint8_t irqn)
+{
+    (void)irqn;
+}
+
+uint32_t halCycleCounter(void)
+{
+    return (uint32_t)(uint64_t)(time*72e6);
+}
+
+bool dwt_enable_cycle_counter(void)
+{
+    return true;
+}
+
+uint32_t dwt_read_cycle_counter(void)
+{
+    return halCycleCounter();
+}
+
+/*--------------------------------------------------------------------------*/
+/* FLASH, the firmware's RAM resident programming of flashprog.c */
+
+void flashProgramWord(const volatile uint32_t* address, uint32_t data)
+{
+    *(volatile uint32_t*)address = data;
+}
+
+void flashErasePage(const volatile uint32_t* page)
+{
+    uint8_t bank;
+    uint16_t word;
+    for (bank = 0; bank < STORE_BANKS; bank++)
+    {
+        if (page != storePages[bank]) continue;
+        for (word = 0; word < STORE_BANK_WORDS; word++)
+            ((volatile uint32_t*)page)[word] = STORE_ERASED;
+    }
+}
+
@@ -0,0 +1,38 @@
+/* Host libopencm3 Cortex Core Control
+
+Host stand-in for the libopencm3 header of the same name, covering only
+what the firmware modules built into the emulator use. Implemented in hal.c.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_CM3_CORTEX_H
+#define LIBOPENCM3_CM3_CORTEX_H
+
+#include <libopencm3/cm3/common.h>
+
+/* Interrupts are simulated by direct calls, so masking has no effect */
+void cm_disable_interrupts(void);
+void cm_enable_interrupts(void);
+
+#endif
+
@@ -0,0 +1,57 @@
+/* Host libopencm3 USART
+
+Host stand-in for the libopencm3 header of the same name, covering only
+what the firmware modules built into the emulator use. Implemented in hal.c.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_USART_H
+#define LIBOPENCM3_USART_H
+
+#include <libopencm3/cm3/common.h>
+
+#define USART2              0x40004400
+#define USART_SR_FE         (1 << 1)
+#define USART_SR_NE         (1 << 2)
+#define USART_SR_ORE        (1 << 3)
+#define USART_SR_RXNE       (1 << 5)
+#define USART_SR_TXE        (1 << 7)
+#define USART_CR1_TXEIE     (1 << 7)
+
+/* The status, data and control 1 registers, as read and written directly by
+the ISR. The hal keeps them in step with the simulated USART. */
+extern volatile uint32_t halUsartRegisters[3];
+#define USART_SR(usart)     (halUsartRegisters[0])
+#define USART_DR(usart)     (halUsartRegisters[1])
+#define USART_CR1(usart)    (halUsartRegisters[2])
+
+void usart_send(uint32_t usart, uint16_t data);
+uint16_t usart_recv(uint32_t usart);
+bool usart_get_flag(uint32_t usart, uint32_t flag);
+void usart_enable_rx_interrupt(uint32_t usart);
+void usart_disable_rx_interrupt(uint32_t usart);
+void usart_enable_tx_interrupt(uint32_t usart);
+void usart_disable_tx_interrupt(uint32_t usart);
+
+#endif
+
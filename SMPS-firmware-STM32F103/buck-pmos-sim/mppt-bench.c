@@ -0,0 +1,155 @@
+/* MPPT Benchmark on a Simulated Solar Panel
+
+The firmware regulator is run in MPPT mode against a solar panel model
+feeding an ideal buck converter with a resistive load. The converter is
+treated as quasi-static: at duty cycle D the panel sees the load resistance
+scaled by 1/D^2, which holds as the tracking interval is much longer than the
+converter time constants.
+
+An irradiance profile with slow and fast ramps is played through for each
+algorithm and step size, and the energy harvested is compared with the
+energy available at the true maximum power point. The firmware's own
+tracking efficiency estimate is shown alongside.
+
+Usage: mppt-bench [load resistance in ohms]
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "pv-model.h"
+#include "control.h"
+#include "mppt.h"
+
+/* Regulator period of the firmware in seconds */
+#define REGULATOR_PERIOD    0.01
+#define LOAD_RESISTANCE     2.0
+
+/* Irradiance profile segments: duration in seconds and irradiance at the end,
+relative to 1000W/m2. Irradiance ramps linearly through each segment. */
+typedef struct {
+    double duration;
+    double irradiance;
+} Segment;
+
+static const Segment profile[] = {
+    {10, 0.3}, {20, 0.3}, {20, 1.0}, {20, 1.0}, {5, 0.5}, {20, 0.5},
+    {10, 0.1}, {20, 0.1}, {30, 0.8}, {20, 0.8},
+};
+
+#define NUM_SEGMENTS (sizeof(profile)/sizeof(Segment))
+
+static void runProfile(const PvPanel* panel, double load, uint8_t algorithm,
+                       int32_t step, uint8_t rate);
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    PvPanel panel;
+    pvDefault(&panel);
+    double load = LOAD_RESISTANCE;
+    if (argc > 1) load = atof(argv[1]);
+    if (load <= 0)
+    {
+        fprintf(stderr, "Usage: %s [load resistance]\n", argv[0]);
+        return 1;
+    }
+    printf("Panel %.1fV %.1fA, %.0fW at full sun, load %.2f ohm\n",
+           panel.openCircuitVoltage, panel.shortCircuitCurrent,
+           pvMaximumPower(&panel, 1.0), load);
+    printf("%-8s %5s %5s %12s %12s\n", "method", "step", "rate",
+           "efficiency%", "estimate%");
+    static const int32_t steps[] = {2, 5, 10, 20};
+    uint8_t algorithm;
+    unsigned int i;
+    for (algorithm = MPPT_PERTURB_OBSERVE;
+         algorithm <= MPPT_INCREMENTAL_CONDUCTANCE; algorithm++)
+        for (i = 0; i < sizeof(steps)/sizeof(int32_t); i++)
+            runProfile(&panel, load, algorithm, steps[i], MPPT_RATE);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Play the irradiance profile through the firmware tracker
+
+@param[in] PvPanel* panel: panel parameters.
+@param[in] double load: load resistance on the converter output.
+@param[in] uint8_t algorithm: MPPT algorithm.
+@param[in] int32_t step: duty cycle step.
+@param[in] uint8_t rate: regulator periods per tracking step.
+*/
+
+static void runProfile(const PvPanel* panel, double load, uint8_t algorithm,
+                       int32_t step, uint8_t rate)
+{
+    controlInit();
+    controlSetMode(CONTROL_MPPT);
+    mpptSetAlgorithm(algorithm);
+    mpptSetStep(step);
+    mpptSetRate(rate);
+    int16_t buckDutyCycle = 0;
+    int16_t boostDutyCycle = 0;
+    double harvested = 0;
+    double available = 0;
+    double estimateSum = 0;
+    int estimates = 0;
+    double irradiance = profile[0].irradiance;
+    long period = 0;
+    unsigned int segment;
+    for (segment = 0; segment < NUM_SEGMENTS; segment++)
+    {
+        double start = irradiance;
+        long periods = (long)(profile[segment].duration/REGULATOR_PERIOD);
+        long k;
+        for (k = 0; k < periods; k++, period++)
+        {
+            irradiance = start + (profile[segment].irradiance - start)*
+                                 (k + 1)/periods;
+            double duty = buckDutyCycle/1000.0;
+            double voltage = pvOpenCircuitVoltage(panel, irradiance);
+            if (duty > 0)
+                voltage = pvResistiveLoad(panel, irradiance, load/(duty*duty));
+            double current = pvCurrent(panel, irradiance, voltage);
+            double outputCurrent = (duty > 0) ? current/duty : 0;
+            harvested += voltage*current*REGULATOR_PERIOD;
+            available += pvMaximumPower(panel, irradiance)*REGULATOR_PERIOD;
+            controlUpdate(&buckDutyCycle, &boostDutyCycle, 65535,
+                          (int32_t)(outputCurrent*1000),
+                          (int32_t)(voltage*1000), (int32_t)(current*1000),
+                          (int32_t)(voltage*duty*1000));
+/* The firmware reports its estimate once a second */
+            if ((period % 100) == 99)
+            {
+                estimateSum += mpptEfficiency();
+                estimates++;
+            }
+        }
+    }
+    printf("%-8s %5d %5d %12.2f %12.2f\n",
+           algorithm == MPPT_PERTURB_OBSERVE ? "P&O" : "IncCond", step, rate,
+           100*harvested/available, estimateSum/estimates/10);
+}
+
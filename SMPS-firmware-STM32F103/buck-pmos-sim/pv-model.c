@@ -0,0 +1,182 @@
+/* Solar Panel Model for Host Simulation
+
+Single diode model of a panel of series connected cells:
+
+I = Iph - I0.(exp((V + I.Rs)/(N.n.Vt)) - 1)
+
+where the photocurrent Iph is proportional to irradiance and the saturation
+current I0 is chosen to give the rated open circuit voltage at standard
+irradiance. The implicit equation in I is solved by Newton iteration.
+
+The defaults are those of a nominal 12V, 36 cell, 80W panel.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "pv-model.h"
+
+/* Thermal voltage at 25C */
+#define THERMAL_VOLTAGE     0.025693
+
+static double thermalVoltage(const PvPanel* panel);
+static double saturationCurrent(const PvPanel* panel);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Default panel parameters
+
+@param[out] PvPanel* panel: parameters for a 36 cell 80W panel.
+*/
+
+void pvDefault(PvPanel* panel)
+{
+    panel->shortCircuitCurrent = 5.0;
+    panel->openCircuitVoltage = 21.6;
+    panel->idealityFactor = 1.3;
+    panel->cells = 36;
+    panel->seriesResistance = 0.25;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Panel current at a given voltage
+
+@param[in] PvPanel* panel: panel parameters.
+@param[in] double irradiance: relative to 1000W/m2.
+@param[in] double voltage: terminal voltage.
+@returns double: terminal current, zero above open circuit.
+*/
+
+double pvCurrent(const PvPanel* panel, double irradiance, double voltage)
+{
+    double photoCurrent = panel->shortCircuitCurrent*irradiance;
+    double saturation = saturationCurrent(panel);
+    double vt = thermalVoltage(panel);
+    double current = photoCurrent;
+    int i;
+    for (i = 0; i < 50; i++)
+    {
+        double e = exp((voltage + current*panel->seriesResistance)/vt);
+        double f = photoCurrent - saturation*(e - 1) - current;
+        double df = -saturation*e*panel->seriesResistance/vt - 1;
+        double next = current - f/df;
+        if (fabs(next - current) < 1e-9)
+        {
+            current = next;
+            break;
+        }
+        current = next;
+    }
+    return current > 0 ? current : 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Open circuit voltage
+
+@param[in] PvPanel* panel: panel parameters.
+@param[in] double irradiance: relative to 1000W/m2.
+@returns double: voltage at zero current.
+*/
+
+double pvOpenCircuitVoltage(const PvPanel* panel, double irradiance)
+{
+    if (irradiance <= 0) return 0;
+    return thermalVoltage(panel)*
+           log(panel->shortCircuitCurrent*irradiance/saturationCurrent(panel)
+               + 1);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Maximum available power
+
+Found by golden section search on the voltage.
+
+@param[in] PvPanel* panel: panel parameters.
+@param[in] double irradiance: relative to 1000W/m2.
+@returns double: power at the maximum power point.
+*/
+
+double pvMaximumPower(const PvPanel* panel, double irradiance)
+{
+    const double ratio = 0.6180339887;
+    double low = 0;
+    double high = pvOpenCircuitVoltage(panel, irradiance);
+    int i;
+    for (i = 0; i < 80; i++)
+    {
+        double v1 = high - ratio*(high - low);
+        double v2 = low + ratio*(high - low);
+        if (v1*pvCurrent(panel, irradiance, v1) <
+            v2*pvCurrent(panel, irradiance, v2)) low = v1;
+        else high = v2;
+    }
+    double v = (low + high)/2;
+    return v*pvCurrent(panel, irradiance, v);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Operating voltage with a resistive load
+
+Found by bisection, as the panel current falls monotonically with voltage.
+
+@param[in] PvPanel* panel: panel parameters.
+@param[in] double irradiance: relative to 1000W/m2.
+@param[in] double resistance: load resistance seen by the panel.
+@returns double: panel voltage.
+*/
+
+double pvResistiveLoad(const PvPanel* panel, double irradiance,
+                       double resistance)
+{
+    double low = 0;
+    double high = pvOpenCircuitVoltage(panel, irradiance);
+    int i;
+    for (i = 0; i < 60; i++)
+    {
+        double v = (low + high)/2;
+        if (pvCurrent(panel, irradiance, v)*resistance > v) low = v;
+        else high = v;
+    }
+    return (low + high)/2;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Thermal voltage of the series string
+
+*/
+
+static double thermalVoltage(const PvPanel* panel)
+{
+    return panel->cells*panel->idealityFactor*THERMAL_VOLTAGE;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Saturation current giving the rated open circuit voltage
+
+*/
+
+static double saturationCurrent(const PvPanel* panel)
+{
+    return panel->shortCircuitCurrent/
+           (exp(panel->openCircuitVoltage/thermalVoltage(panel)) - 1);
+}
+
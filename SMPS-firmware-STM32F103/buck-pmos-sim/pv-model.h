@@ -0,0 +1,47 @@
+/* Solar Panel Model for Host Simulation
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PV_MODEL_H_
+#define PV_MODEL_H_
+
+/* Single diode panel model parameters at standard irradiance 1000W/m2 */
+typedef struct {
+    double shortCircuitCurrent;     /* A */
+    double openCircuitVoltage;      /* V */
+    double idealityFactor;
+    int cells;                      /* Cells in series */
+    double seriesResistance;        /* Ohm */
+} PvPanel;
+
+void pvDefault(PvPanel* panel);
+double pvCurrent(const PvPanel* panel, double irradiance, double voltage);
+double pvOpenCircuitVoltage(const PvPanel* panel, double irradiance);
+double pvMaximumPower(const PvPanel* panel, double irradiance);
+double pvResistiveLoad(const PvPanel* panel, double irradiance,
+                       double resistance);
+
+#endif
+
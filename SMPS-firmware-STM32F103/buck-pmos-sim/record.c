@@ -0,0 +1,384 @@
+/* Recording of Firmware Inputs and Outputs
+
+A recording holds everything that reaches the firmware, scan by scan, so
+that its run can be repeated exactly by the replay tool, along with what it
+produced so that the repeat can be checked.
+
+The file starts with a header of the magic "SMPSREC" and a zero, then the
+version, baud rate, number of ADC channels and scan period in ns, each 32
+bit LSB first. Records of each scan follow, each a type letter and its
+fields, with numbers as unsigned LEB128 variable length integers and signed
+numbers zigzag encoded:
+
+- 'C' ns since the epoch, 64 bit LSB first, every RECORD_CLOCK_SCANS scans,
+  to place the scans in time.
+- 'R' count and characters given to the USART at the start of the scan.
+- 'T' count and characters transmitted over the scan.
+- 'P' period, buck compare, burst off periods and synchronous setting of
+  timer 1 after the scan, when they have changed.
+- 'A' ends a scan in which the ADC took samples, with the signed change of
+  each sample from the last taken.
+- 'S' ends a scan without samples.
+- 'I' count of scans in a row with nothing else to record.
+
+Scans are numbered from the first, which with the scan period gives the
+time from reset. As the samples change slowly, a scan with samples and no
+serial traffic takes about five bytes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "record.h"
+
+static bool pwmEqual(const FirmwarePwm* a, const FirmwarePwm* b);
+static void writeNumber(FILE* file, uint64_t value);
+static void writeSigned(FILE* file, int64_t value);
+static void writeWord(FILE* file, uint64_t value, uint8_t bytes);
+static bool readNumber(FILE* file, uint64_t* value);
+static bool readSigned(FILE* file, int64_t* value);
+static bool readWord(FILE* file, uint64_t* value, uint8_t bytes);
+static bool readCharacters(FILE* file, uint16_t* count, uint8_t* characters);
+
+/*--------------------------------------------------------------------------*/
+/** @brief Create a recording
+
+Any existing file is replaced.
+
+@param[out] Recording* recording: recording to write.
+@param[in] char* path: file.
+@param[in] uint32_t baud: serial rate, which paces the transmission.
+@returns true if created.
+*/
+
+bool recordCreate(Recording* recording, const char* path, uint32_t baud)
+{
+    memset(recording, 0, sizeof(Recording));
+    recording->file = fopen(path, "wb");
+    if (recording->file == NULL) return false;
+    recording->writing = true;
+    recording->baud = baud;
+    fwrite(RECORD_MAGIC, 1, sizeof(RECORD_MAGIC), recording->file);
+    writeWord(recording->file, RECORD_VERSION, 4);
+    writeWord(recording->file, baud, 4);
+    writeWord(recording->file, NUM_CHANNEL, 4);
+    writeWord(recording->file, (uint32_t)(SCAN_PERIOD*1e9 + 0.5), 4);
+    return ! ferror(recording->file);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Record a scan
+
+@param[in] Recording* recording: recording being written.
+@param[in] RecordScan* scan: inputs and outputs of the scan. The PWM is
+recorded if it differs from the last recorded.
+@returns true if written without error.
+*/
+
+bool recordWrite(Recording* recording, const RecordScan* scan)
+{
+    FILE* file = recording->file;
+    bool clock = (recording->scans % RECORD_CLOCK_SCANS) == 0;
+    bool pwmChanged = ! pwmEqual(&scan->pwm, &recording->pwm);
+    recording->scans++;
+    if (! clock && ! scan->sampled && ! pwmChanged &&
+        (scan->receivedCount == 0) && (scan->transmittedCount == 0))
+    {
+        recording->idle++;
+        return true;
+    }
+    if (recording->idle > 0)
+    {
+        fputc(RECORD_IDLE, file);
+        writeNumber(file, recording->idle);
+        recording->idle = 0;
+    }
+    if (clock)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        recording->clock = (int64_t)now.tv_sec*1000000000 + now.tv_nsec;
+        fputc(RECORD_CLOCK, file);
+        writeWord(file, recording->clock, 8);
+    }
+    if (scan->receivedCount > 0)
+    {
+        fputc(RECORD_RECEIVED, file);
+        writeNumber(file, scan->receivedCount);
+        fwrite(scan->received, 1, scan->receivedCount, file);
+    }
+    if (scan->transmittedCount > 0)
+    {
+        fputc(RECORD_TRANSMITTED, file);
+        writeNumber(file, scan->transmittedCount);
+        fwrite(scan->transmitted, 1, scan->transmittedCount, file);
+    }
+    if (pwmChanged)
+    {
+        fputc(RECORD_PWM, file);
+        writeNumber(file, scan->pwm.period);
+        writeNumber(file, scan->pwm.buckCompare);
+        writeNumber(file, scan->pwm.burstOffPeriods);
+        writeNumber(file, scan->pwm.synchronous);
+        recording->pwm = scan->pwm;
+    }
+    if (scan->sampled)
+    {
+        fputc(RECORD_SAMPLES, file);
+        uint8_t channel;
+        for (channel = 0; channel < NUM_CHANNEL; channel++)
+        {
+            writeSigned(file, (int64_t)scan->samples[channel] -
+                              recording->samples[channel]);
+            recording->samples[channel] = scan->samples[channel];
+        }
+    }
+    else fputc(RECORD_SCAN, file);
+    return ! ferror(file);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Open a recording for reading
+
+@param[out] Recording* recording: recording to read, with the baud rate.
+@param[in] char* path: file.
+@returns true if the file is a recording of this firmware build.
+*/
+
+bool recordOpen(Recording* recording, const char* path)
+{
+    memset(recording, 0, sizeof(Recording));
+    recording->file = fopen(path, "rb");
+    if (recording->file == NULL) return false;
+    char magic[sizeof(RECORD_MAGIC)];
+    uint64_t version, baud, channels, period;
+    if ((fread(magic, 1, sizeof(magic), recording->file) != sizeof(magic)) ||
+        (memcmp(magic, RECORD_MAGIC, sizeof(magic)) != 0) ||
+        ! readWord(recording->file, &version, 4) ||
+        ! readWord(recording->file, &baud, 4) ||
+        ! readWord(recording->file, &channels, 4) ||
+        ! readWord(recording->file, &period, 4) ||
+        (version != RECORD_VERSION) || (channels != NUM_CHANNEL) ||
+        (period != (uint32_t)(SCAN_PERIOD*1e9 + 0.5)))
+    {
+        fclose(recording->file);
+        recording->file = NULL;
+        return false;
+    }
+    recording->baud = baud;
+    return true;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Read the next scan
+
+@param[in] Recording* recording: recording being read.
+@param[out] RecordScan* scan: inputs and outputs of the scan. The PWM is the
+last recorded.
+@returns int: RECORD_OK, RECORD_END at the end of the recording, or
+RECORD_CORRUPT if a record is invalid or cut short.
+*/
+
+int recordRead(Recording* recording, RecordScan* scan)
+{
+    FILE* file = recording->file;
+    scan->sampled = false;
+    scan->receivedCount = 0;
+    scan->transmittedCount = 0;
+    scan->pwmChanged = false;
+    bool started = false;
+    while (recording->idle == 0)
+    {
+        int type = fgetc(file);
+        uint64_t value[4];
+        int64_t change;
+        uint8_t index;
+        if (type == EOF) return started ? RECORD_CORRUPT : RECORD_END;
+        switch (type)
+        {
+        case RECORD_IDLE:
+            if (started || ! readNumber(file, &value[0]) || (value[0] == 0))
+                return RECORD_CORRUPT;
+            recording->idle = value[0];
+            break;
+        case RECORD_CLOCK:
+            if (! readWord(file, &value[0], 8)) return RECORD_CORRUPT;
+            recording->clock = value[0];
+            break;
+        case RECORD_RECEIVED:
+            if (! readCharacters(file, &scan->receivedCount, scan->received))
+                return RECORD_CORRUPT;
+            break;
+        case RECORD_TRANSMITTED:
+            if (! readCharacters(file, &scan->transmittedCount,
+                                 scan->transmitted)) return RECORD_CORRUPT;
+            break;
+        case RECORD_PWM:
+            for (index = 0; index < 4; index++)
+                if (! readNumber(file, &value[index])) return RECORD_CORRUPT;
+            recording->pwm.period = value[0];
+            recording->pwm.buckCompare = value[1];
+            recording->pwm.burstOffPeriods = value[2];
+            recording->pwm.synchronous = (value[3] != 0);
+            scan->pwmChanged = true;
+            break;
+        case RECORD_SAMPLES:
+            for (index = 0; index < NUM_CHANNEL; index++)
+            {
+                if (! readSigned(file, &change)) return RECORD_CORRUPT;
+                recording->samples[index] += change;
+            }
+            memcpy(scan->samples, recording->samples, sizeof(scan->samples));
+            scan->sampled = true;
+            scan->pwm = recording->pwm;
+            recording->scans++;
+            return RECORD_OK;
+        case RECORD_SCAN:
+            scan->pwm = recording->pwm;
+            recording->scans++;
+            return RECORD_OK;
+        default:
+            return RECORD_CORRUPT;
+        }
+        started = (type != RECORD_IDLE);
+    }
+    recording->idle--;
+    scan->pwm = recording->pwm;
+    recording->scans++;
+    return RECORD_OK;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Close a recording
+
+Idle scans not yet written are written first.
+
+@param[in] Recording* recording: recording to close.
+*/
+
+void recordClose(Recording* recording)
+{
+    if (recording->file == NULL) return;
+    if (recording->writing && (recording->idle > 0))
+    {
+        fputc(RECORD_IDLE, recording->file);
+        writeNumber(recording->file, recording->idle);
+    }
+    fclose(recording->file);
+    recording->file = NULL;
+}
+
+/*--------------------------------------------------------------------------*/
+
+static bool pwmEqual(const FirmwarePwm* a, const FirmwarePwm* b)
+{
+    return (a->period == b->period) && (a->buckCompare == b->buckCompare) &&
+           (a->burstOffPeriods == b->burstOffPeriods) &&
+           (a->synchronous == b->synchronous);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write an unsigned LEB128 number
+
+*/
+
+static void writeNumber(FILE* file, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Write a zigzag encoded signed number
+
+Small numbers of either sign take one byte.
+*/
+
+static void writeSigned(FILE* file, int64_t value)
+{
+    writeNumber(file, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/*--------------------------------------------------------------------------*/
+
+static void writeWord(FILE* file, uint64_t value, uint8_t bytes)
+{
+    uint8_t byte;
+    for (byte = 0; byte < bytes; byte++)
+        fputc((value >> (8*byte)) & 0xFF, file);
+}
+
+/*--------------------------------------------------------------------------*/
+
+static bool readNumber(FILE* file, uint64_t* value)
+{
+    *value = 0;
+    uint8_t shift;
+    for (shift = 0; shift < 64; shift += 7)
+    {
+        int byte = fgetc(file);
+        if (byte == EOF) return false;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+static bool readSigned(FILE* file, int64_t* value)
+{
+    uint64_t number;
+    if (! readNumber(file, &number)) return false;
+    *value = (int64_t)(number >> 1) ^ -(int64_t)(number & 1);
+    return true;
+}
+
+static bool readWord(FILE* file, uint64_t* value, uint8_t bytes)
+{
+    *value = 0;
+    uint8_t byte;
+    for (byte = 0; byte < bytes; byte++)
+    {
+        int character = fgetc(file);
+        if (character == EOF) return false;
+        *value |= (uint64_t)character << (8*byte);
+    }
+    return true;
+}
+
+static bool readCharacters(FILE* file, uint16_t* count, uint8_t* characters)
+{
+    uint64_t number;
+    if (! readNumber(file, &number) || (number == 0) ||
+        (number > RECORD_CHARACTERS_MAX)) return false;
+    *count = number;
+    return fread(characters, 1, number, file) == number;
+}
+
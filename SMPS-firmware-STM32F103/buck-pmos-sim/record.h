@@ -0,0 +1,87 @@
+/* Recording of Firmware Inputs and Outputs
+
+This header file contains defines and prototypes.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "firmware.h"
+
+#define RECORD_MAGIC            "SMPSREC"
+#define RECORD_VERSION          1
+/* Characters received or transmitted in one scan */
+#define RECORD_CHARACTERS_MAX   1024
+/* Scans between clock records, about a second */
+#define RECORD_CLOCK_SCANS      1024
+
+/* Record types */
+#define RECORD_IDLE             'I'     /* Scans with nothing recorded */
+#define RECORD_SCAN             'S'     /* End of a scan without samples */
+#define RECORD_SAMPLES          'A'     /* End of a scan with samples */
+#define RECORD_RECEIVED         'R'
+#define RECORD_TRANSMITTED      'T'
+#define RECORD_PWM              'P'
+#define RECORD_CLOCK            'C'
+
+/* Read results */
+#define RECORD_END              0
+#define RECORD_OK               1
+#define RECORD_CORRUPT          -1
+
+/* Inputs and outputs of one scan */
+typedef struct {
+    bool sampled;
+    uint32_t samples[NUM_CHANNEL];
+    uint16_t receivedCount;
+    uint8_t received[RECORD_CHARACTERS_MAX];
+    uint16_t transmittedCount;
+    uint8_t transmitted[RECORD_CHARACTERS_MAX];
+    bool pwmChanged;
+    FirmwarePwm pwm;
+} RecordScan;
+
+typedef struct {
+    FILE* file;
+    bool writing;
+    uint32_t baud;
+    uint64_t scans;
+    uint64_t idle;                  /* Scans not yet written, or to read */
+    uint32_t samples[NUM_CHANNEL];  /* Previous samples */
+    FirmwarePwm pwm;                /* Last PWM recorded */
+    int64_t clock;                  /* ns since the epoch, last recorded */
+} Recording;
+
+bool recordCreate(Recording* recording, const char* path, uint32_t baud);
+bool recordWrite(Recording* recording, const RecordScan* scan);
+bool recordOpen(Recording* recording, const char* path);
+int recordRead(Recording* recording, RecordScan* scan);
+void recordClose(Recording* recording);
+
+#endif
+
@@ -0,0 +1,216 @@
+/* Replay of Recorded Firmware Runs
+
+Each recording made with the emulator's -r option is run again through the
+same firmware code (see firmware.c), with the recorded characters received
+and samples taken in each scan in place of the serial line and the plant.
+The characters transmitted and the timer 1 outputs of every scan are
+compared with those recorded, and the first difference is reported with the
+scan at which it happened. With no plant to integrate and no real time to
+keep, a replay runs much faster than the recording.
+
+Each recording is replayed in a child process so that it starts from the
+firmware's reset state.
+
+Usage: replay [-v] recording...
+
+-v prints the characters transmitted in the replay, which for a matching
+replay are the telemetry and responses of the recorded run.
+
+The exit status is 0 if every recording was reproduced exactly.
+
+Initial 19 October 2026
+*/
+
+/*
+ * This file is part of the SMPS project.
+ *
+ * Copyright K. Sarkies <ksarkies@internode.on.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "firmware.h"
+#include "record.h"
+
+/* Replay results, as the child's exit status */
+#define REPLAY_MATCH        0
+#define REPLAY_DIFFER       1
+#define REPLAY_FAILED       2
+
+static int replay(const char* path, bool verbose);
+static void printCharacters(FILE* file, const uint8_t* characters,
+                            uint16_t count);
+static double processorTime(void);
+
+/*--------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    bool verbose = false;
+    int option;
+    while ((option = getopt(argc, argv, "v")) != -1)
+    {
+        switch (option)
+        {
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: replay [-v] recording...\n");
+        return REPLAY_FAILED;
+    }
+
+    int result = REPLAY_MATCH;
+    int index;
+    for (index = optind; index < argc; index++)
+    {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int status = replay(argv[index], verbose);
+            fflush(stdout);
+            _exit(status);
+        }
+        int status = REPLAY_FAILED << 8;
+        if ((pid < 0) || (waitpid(pid, &status, 0) < 0))
+            perror("replay");
+        if (! WIFEXITED(status) || (WEXITSTATUS(status) != REPLAY_MATCH))
+            result = REPLAY_DIFFER;
+    }
+    return result;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Replay one recording from reset
+
+@param[in] char* path: recording.
+@param[in] bool verbose: print the transmitted characters.
+@returns int: REPLAY_MATCH if the outputs of all scans are those recorded.
+*/
+
+static int replay(const char* path, bool verbose)
+{
+    static Recording recording;
+    static RecordScan record;
+    static uint8_t transmitted[RECORD_CHARACTERS_MAX];
+    if (! recordOpen(&recording, path))
+    {
+        fprintf(stderr, "%s: not a recording of this build\n", path);
+        return REPLAY_FAILED;
+    }
+    double start = processorTime();
+    firmwareInit(recording.baud);
+    int result;
+    const char* difference = NULL;
+    while ((result = recordRead(&recording, &record)) == RECORD_OK)
+    {
+        firmwareAdvance(SCAN_PERIOD, NULL);
+        FirmwareScan scan;
+        scan.received = record.received;
+        scan.receivedCount = record.receivedCount;
+        memcpy(scan.samples, record.samples, sizeof(scan.samples));
+        scan.transmitted = transmitted;
+        scan.transmitSize = sizeof(transmitted);
+        firmwareStep(&scan);
+        if (verbose) fwrite(transmitted, 1, scan.transmittedCount, stdout);
+
+        FirmwarePwm pwm;
+        firmwarePwm(&pwm);
+        if (scan.sampled != record.sampled) difference = "ADC scan";
+        else if ((scan.transmittedCount != record.transmittedCount) ||
+                 (memcmp(transmitted, record.transmitted,
+                         scan.transmittedCount) != 0))
+            difference = "transmitted characters";
+        else if ((pwm.period != record.pwm.period) ||
+                 (pwm.buckCompare != record.pwm.buckCompare) ||
+                 (pwm.burstOffPeriods != record.pwm.burstOffPeriods) ||
+                 (pwm.synchronous != record.pwm.synchronous))
+            difference = "timer 1 outputs";
+        if (difference == NULL) continue;
+
+        uint64_t scanNumber = recording.scans - 1;
+        printf("%s: %s differ at scan %lu, %.3f s\n", path, difference,
+               scanNumber, scanNumber*SCAN_PERIOD);
+        printf("  recorded: PWM %u/%u burst %u ", record.pwm.buckCompare,
+               record.pwm.period, record.pwm.burstOffPeriods);
+        printCharacters(stdout, record.transmitted, record.transmittedCount);
+        printf("\n  replayed: PWM %u/%u burst %u ", pwm.buckCompare,
+               pwm.period, pwm.burstOffPeriods);
+        printCharacters(stdout, transmitted, scan.transmittedCount);
+        printf("\n");
+        recordClose(&recording);
+        return REPLAY_DIFFER;
+    }
+    double elapsed = processorTime() - start;
+    uint64_t scans = recording.scans;
+    recordClose(&recording);
+    if (result == RECORD_CORRUPT)
+    {
+        printf("%s: corrupt after scan %lu\n", path, scans);
+        return REPLAY_FAILED;
+    }
+    double duration = scans*SCAN_PERIOD;
+    printf("%s: %lu scans, %.1f s reproduced exactly in %.2f s, %.0f times "
+           "real time\n", path, scans, duration, elapsed,
+           (elapsed > 0) ? duration/elapsed : 0);
+    return REPLAY_MATCH;
+}
+
+/*--------------------------------------------------------------------------*/
+/** @brief Print characters with control characters escaped
+
+*/
+
+static void printCharacters(FILE* file, const uint8_t* characters,
+                            uint16_t count)
+{
+    fputc('"', file);
+    uint16_t index;
+    for (index = 0; index < count; index++)
+    {
+        uint8_t character = characters[index];
+        if (character == '\r') fputs("\\r", file);
+        else if (character == '\n') fputs("\\n", file);
+        else if ((character < ' ') || (character > '~'))
+            fprintf(file, "\\x%02x", character);
+        else fputc(character, file);
+    }
+    fputc('"', file);
+}
+
+/*--------------------------------------------------------------------------*/
+
+static double processorTime(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec*1e-9;
+}
+